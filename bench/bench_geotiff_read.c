@@ -0,0 +1,802 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/*
+ * Purpose:     Read benchmark of the GeoTIFF VOL connector. Synthesizes
+ *              GeoTIFF files of a range of layouts, codecs, band counts and
+ *              sizes, then times opening them (eagerly, lazily and from a
+ *              sidecar index), reading
+ *              them whole with one to many decoder threads, and reading
+ *              random windows of them, all through H5Fopen()/H5Dopen2()/
+ *              H5Dread(). Prints one JSON object per measurement per line.
+ */
+
+// cppcheck-suppress missingInclude
+#include "template_vol_connector.h"
+
+#include <errno.h>
+#include <hdf5.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Edge of the tiles of tiled files, in pixels */
+#define BENCH_TILE_SIZE 256
+
+/* Edge of the windows read at random, in pixels */
+#define BENCH_WINDOW_SIZE 256
+
+/* Most bytes a full read decodes into at once; larger images are read in
+ * bands of rows */
+#define BENCH_MAX_READ_BYTES ((size_t) 256 * 1024 * 1024)
+
+/* GeoTIFF tags, which libtiff does not know by itself */
+#define BENCH_TAG_MODEL_PIXEL_SCALE 33550
+#define BENCH_TAG_MODEL_TIEPOINT 33922
+#define BENCH_TAG_GEO_KEY_DIRECTORY 34735
+
+/* One synthesized file */
+typedef struct bench_case_t {
+    uint32_t size;        /* Pixels on a side */
+    uint16_t bands;       /* Samples per pixel */
+    int tiled;            /* Tiles (1) or strips (0) */
+    uint16_t compression; /* TIFF compression scheme */
+    int bigtiff;          /* BigTIFF (1) or classic TIFF (0) */
+} bench_case_t;
+
+/* Command line options */
+typedef struct bench_options_t {
+    const char *dir;      /* Directory files are synthesized in */
+    uint32_t max_size;    /* Largest image edge benchmarked */
+    unsigned repeat;      /* Timed repetitions of each open and full read */
+    unsigned windows;     /* Random windows read per file */
+    unsigned max_threads; /* Largest decoder thread count of the scaling runs */
+    int keep;             /* Keep the synthesized files */
+} bench_options_t;
+
+static const struct {
+    uint16_t compression;
+    const char *name;
+} bench_codecs_g[] = {
+    {COMPRESSION_NONE, "none"}, {COMPRESSION_PACKBITS, "packbits"},
+    {COMPRESSION_LZW, "lzw"},   {COMPRESSION_ADOBE_DEFLATE, "deflate"},
+    {50000, "zstd"},            {34925, "lzma"},
+};
+
+#define BENCH_NCODECS (sizeof(bench_codecs_g) / sizeof(bench_codecs_g[0]))
+
+static FILE *bench_out_g;
+
+/* Helper function to get a monotonic time stamp in seconds */
+static double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* Helper function to get the name of a compression scheme */
+static const char *bench_codec_name(uint16_t compression)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_NCODECS; i++)
+        if (bench_codecs_g[i].compression == compression)
+            return bench_codecs_g[i].name;
+
+    return "other";
+}
+
+static int bench_cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Helper function to get the q quantile of n sorted samples */
+static double bench_quantile(const double *sorted, size_t n, double q)
+{
+    size_t i = (size_t) (q * (double) (n - 1) + 0.5);
+
+    return sorted[i < n ? i : n - 1];
+}
+
+/* Helper function to get the sample at pixel (y, x) of band b: a smooth
+ * ramp with some noise, so that the codecs have something to do */
+static uint16_t bench_sample(uint32_t y, uint32_t x, uint16_t b)
+{
+    uint32_t h = (y * 0x9E3779B1u) ^ (x * 0x85EBCA77u) ^ ((uint32_t) b * 0xC2B2AE3Du);
+
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 12;
+
+    return (uint16_t) ((y * 3 + x * 5 + b * 1000) + (h & 0x3F));
+}
+
+/* Helper function to teach libtiff the GeoTIFF tags written below */
+static void bench_register_geo_tags(TIFF *tiff)
+{
+    static const TIFFFieldInfo fields[] = {
+        {BENCH_TAG_MODEL_PIXEL_SCALE, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1,
+         "ModelPixelScaleTag"},
+        {BENCH_TAG_MODEL_TIEPOINT, -1, -1, TIFF_DOUBLE, FIELD_CUSTOM, 1, 1, "ModelTiepointTag"},
+        {BENCH_TAG_GEO_KEY_DIRECTORY, -1, -1, TIFF_SHORT, FIELD_CUSTOM, 1, 1,
+         "GeoKeyDirectoryTag"},
+    };
+
+    TIFFMergeFieldInfo(tiff, fields, sizeof(fields) / sizeof(fields[0]));
+}
+
+/* Helper function to write a file of the case: 16-bit samples, georeferenced
+ * as a WGS 84 grid of 0.001 degree pixels */
+static int bench_write_file(const char *path, const bench_case_t *bc)
+{
+    /* GTModelTypeGeoKey = geographic, GTRasterTypeGeoKey = pixel is area,
+     * GeographicTypeGeoKey = WGS 84 */
+    static const uint16_t keys[] = {1, 1, 0, 3, 1024, 0, 1, 2, 1025, 0, 1, 1, 2048, 0, 1, 4326};
+    double scale[3] = {0.001, 0.001, 0.0};
+    double tiepoint[6] = {0.0, 0.0, 0.0, 10.0, 50.0, 0.0};
+    uint32_t chunk_width, chunk_height, cy, cx, y, x;
+    uint16_t *buf = NULL, b;
+    TIFF *tiff;
+    int ret = -1;
+
+    if (!(tiff = TIFFOpen(path, bc->bigtiff ? "w8" : "w")))
+        return -1;
+    bench_register_geo_tags(tiff);
+
+    TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, bc->size);
+    TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, bc->size);
+    TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, bc->bands);
+    TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, 16);
+    TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+    TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    if (bc->bands > 1) {
+        uint16_t extra[16];
+
+        for (b = 0; b + 1 < bc->bands; b++)
+            extra[b] = EXTRASAMPLE_UNSPECIFIED;
+        TIFFSetField(tiff, TIFFTAG_EXTRASAMPLES, bc->bands - 1, extra);
+    }
+    TIFFSetField(tiff, TIFFTAG_COMPRESSION, bc->compression);
+    if (bc->compression != COMPRESSION_NONE && bc->compression != COMPRESSION_PACKBITS)
+        TIFFSetField(tiff, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    TIFFSetField(tiff, BENCH_TAG_MODEL_PIXEL_SCALE, 3, scale);
+    TIFFSetField(tiff, BENCH_TAG_MODEL_TIEPOINT, 6, tiepoint);
+    TIFFSetField(tiff, BENCH_TAG_GEO_KEY_DIRECTORY, (int) (sizeof(keys) / sizeof(keys[0])),
+                 keys);
+
+    if (bc->tiled) {
+        chunk_width = chunk_height = BENCH_TILE_SIZE;
+        TIFFSetField(tiff, TIFFTAG_TILEWIDTH, chunk_width);
+        TIFFSetField(tiff, TIFFTAG_TILELENGTH, chunk_height);
+    } else {
+        chunk_width = bc->size;
+        chunk_height = TIFFDefaultStripSize(tiff, 0);
+        TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, chunk_height);
+    }
+
+    if (!(buf = (uint16_t *) malloc((size_t) chunk_width * chunk_height * bc->bands * 2)))
+        goto done;
+
+    /* Every chunk is written whole; the parts of edge tiles past the image
+     * are zero */
+    for (cy = 0; cy < bc->size; cy += chunk_height) {
+        for (cx = 0; cx < bc->size; cx += chunk_width) {
+            uint32_t rows = bc->tiled || cy + chunk_height <= bc->size ? chunk_height
+                                                                       : bc->size - cy;
+            uint16_t *p = buf;
+            tmsize_t nbytes = (tmsize_t) ((size_t) chunk_width * rows * bc->bands * 2);
+
+            for (y = cy; y < cy + rows; y++)
+                for (x = cx; x < cx + chunk_width; x++)
+                    for (b = 0; b < bc->bands; b++)
+                        *p++ = y < bc->size && x < bc->size ? bench_sample(y, x, b) : 0;
+
+            if ((bc->tiled ? TIFFWriteEncodedTile(tiff, TIFFComputeTile(tiff, cx, cy, 0, 0),
+                                                  buf, nbytes)
+                           : TIFFWriteEncodedStrip(tiff, TIFFComputeStrip(tiff, cy, 0), buf,
+                                                   nbytes)) < 0)
+                goto done;
+        }
+    }
+
+    ret = 0;
+
+done:
+    free(buf);
+    TIFFClose(tiff);
+
+    return ret;
+}
+
+/* Helper function to print the fields common to every result of a case */
+static void bench_print_case(const bench_case_t *bc, long long file_bytes, const char *metric)
+{
+    fprintf(bench_out_g,
+            "{\"layout\":\"%s\",\"compression\":\"%s\",\"bands\":%u,\"size\":%u,"
+            "\"bigtiff\":%s,\"file_bytes\":%lld,\"metric\":\"%s\"",
+            bc->tiled ? "tile" : "strip", bench_codec_name(bc->compression),
+            (unsigned) bc->bands, (unsigned) bc->size, bc->bigtiff ? "true" : "false",
+            file_bytes, metric);
+}
+
+/* Helper function to create a file access property list for the connector,
+ * with the chunk cache off so that every read decodes, opening files eagerly
+ * or lazily, and with or without sidecar indexes */
+static hid_t bench_fapl(hid_t vol_id, unsigned threads, int lazy, int index)
+{
+    geotiff_info_t info;
+    hid_t fapl_id;
+
+    info.threads = threads;
+    info.cache_mb = 0;
+    info.gap_kb = GEOTIFF_DEFAULT_GAP_KB;
+    info.io = GEOTIFF_IO_PREAD;
+    info.readahead_kb = GEOTIFF_DEFAULT_READAHEAD_KB;
+    info.buffer = NULL;
+    info.buffer_size = 0;
+    info.lazy = lazy;
+    info.index = index;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        return H5I_INVALID_HID;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0) {
+        H5Pclose(fapl_id);
+        return H5I_INVALID_HID;
+    }
+
+    return fapl_id;
+}
+
+/* Helper function to get the read statistics of a file */
+static int bench_get_stats(hid_t file_id, geotiff_stats_t *stats)
+{
+    geotiff_get_stats_args_t stats_args;
+    H5VL_optional_args_t vol_args;
+    int op_val;
+
+    if (H5VLfind_opt_operation(H5VL_SUBCLS_FILE, GEOTIFF_GET_STATS_OP_NAME, &op_val) < 0)
+        return -1;
+
+    stats_args.file = stats;
+    stats_args.global = NULL;
+    vol_args.op_type = op_val;
+    vol_args.args = &stats_args;
+
+    return H5VLfile_optional_op(file_id, &vol_args, H5P_DEFAULT, H5ES_NONE) < 0 ? -1 : 0;
+}
+
+/* Time opening the file and its image dataset, and closing both again */
+static int bench_open(const bench_case_t *bc, long long file_bytes, const char *path,
+                      hid_t vol_id, const bench_options_t *opts)
+{
+    double *samples;
+    hid_t fapl_id, file_id, dset_id;
+    unsigned i;
+    int ret = -1;
+
+    if (!(samples = (double *) malloc(opts->repeat * sizeof(double))))
+        return -1;
+    if ((fapl_id = bench_fapl(vol_id, 1, 0, 0)) < 0)
+        goto done;
+
+    for (i = 0; i < opts->repeat; i++) {
+        double start = bench_now();
+
+        if ((file_id = H5Fopen(path, H5F_ACC_RDONLY, fapl_id)) < 0)
+            goto done;
+        dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT);
+        if (dset_id >= 0)
+            H5Dclose(dset_id);
+        H5Fclose(file_id);
+        if (dset_id < 0)
+            goto done;
+        samples[i] = (bench_now() - start) * 1e3;
+    }
+
+    qsort(samples, opts->repeat, sizeof(double), bench_cmp_double);
+    bench_print_case(bc, file_bytes, "open");
+    fprintf(bench_out_g, ",\"unit\":\"ms\",\"min\":%.4f,\"p50\":%.4f,\"max\":%.4f}\n", samples[0],
+            bench_quantile(samples, opts->repeat, 0.5), samples[opts->repeat - 1]);
+
+    ret = 0;
+
+done:
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    free(samples);
+
+    return ret;
+}
+
+/* Time opening and closing the file alone, as a catalog crawler that only
+ * looks at names and sizes does: with its headers parsed in H5Fopen(), left
+ * for the first access that needs them, and read from its sidecar index
+ * (written by an untimed first open) */
+static int bench_file_open(const bench_case_t *bc, long long file_bytes, const char *path,
+                           hid_t vol_id, const bench_options_t *opts)
+{
+    static const char *const modes[] = {"eager", "lazy", "index"};
+    double *samples;
+    hid_t fapl_id = H5I_INVALID_HID, file_id;
+    char sidecar[4096];
+    unsigned i;
+    int mode, ret = -1;
+
+    snprintf(sidecar, sizeof(sidecar), "%s%s", path, GEOTIFF_INDEX_SUFFIX);
+    if (!(samples = (double *) malloc(opts->repeat * sizeof(double))))
+        return -1;
+
+    for (mode = 0; mode < 3; mode++) {
+        if ((fapl_id = bench_fapl(vol_id, 1, mode == 1, mode == 2)) < 0)
+            goto done;
+        if (mode == 2) {
+            if ((file_id = H5Fopen(path, H5F_ACC_RDONLY, fapl_id)) < 0)
+                goto done;
+            H5Fclose(file_id);
+        }
+
+        for (i = 0; i < opts->repeat; i++) {
+            double start = bench_now();
+
+            if ((file_id = H5Fopen(path, H5F_ACC_RDONLY, fapl_id)) < 0)
+                goto done;
+            H5Fclose(file_id);
+            samples[i] = (bench_now() - start) * 1e6;
+        }
+
+        qsort(samples, opts->repeat, sizeof(double), bench_cmp_double);
+        bench_print_case(bc, file_bytes, "file_open");
+        fprintf(bench_out_g,
+                ",\"mode\":\"%s\",\"unit\":\"us\",\"min\":%.2f,\"p50\":%.2f,\"max\":%.2f}\n",
+                modes[mode], samples[0], bench_quantile(samples, opts->repeat, 0.5),
+                samples[opts->repeat - 1]);
+
+        H5Pclose(fapl_id);
+        fapl_id = H5I_INVALID_HID;
+    }
+
+    ret = 0;
+
+done:
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    remove(sidecar);
+    free(samples);
+
+    return ret;
+}
+
+/* Helper function to read the whole image, in bands of rows small enough to
+ * bound the buffer */
+static int bench_read_all(hid_t dset_id, const bench_case_t *bc, void *buf, uint32_t band_rows)
+{
+    hsize_t start[3] = {0, 0, 0}, count[3];
+    hid_t file_space = H5I_INVALID_HID, mem_space = H5I_INVALID_HID;
+    int ndims = bc->bands > 1 ? 3 : 2, ret = -1;
+    uint32_t y;
+
+    if ((file_space = H5Dget_space(dset_id)) < 0)
+        return -1;
+
+    count[1] = bc->size;
+    count[2] = bc->bands;
+    for (y = 0; y < bc->size; y += band_rows) {
+        start[0] = y;
+        count[0] = bc->size - y < band_rows ? bc->size - y : band_rows;
+        if (H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+            goto done;
+        if ((mem_space = H5Screate_simple(ndims, count, NULL)) < 0)
+            goto done;
+        if (H5Dread(dset_id, H5T_NATIVE_UINT16, mem_space, file_space, H5P_DEFAULT, buf) < 0)
+            goto done;
+        H5Sclose(mem_space);
+        mem_space = H5I_INVALID_HID;
+    }
+
+    ret = 0;
+
+done:
+    if (mem_space >= 0)
+        H5Sclose(mem_space);
+    H5Sclose(file_space);
+
+    return ret;
+}
+
+/* Helper function to open the file with threads decoder threads and time
+ * opts->repeat full reads of it, after an untimed one that warms the page
+ * cache and the worker pool. The file's read statistics over the timed reads
+ * are left in stats. */
+static int bench_time_full_reads(const char *path, hid_t vol_id, unsigned threads,
+                                 const bench_case_t *bc, void *buf, uint32_t band_rows,
+                                 const bench_options_t *opts, double *samples,
+                                 geotiff_stats_t *stats)
+{
+    geotiff_stats_t before;
+    hid_t fapl_id, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    unsigned i;
+    int c, ret = -1;
+
+    if ((fapl_id = bench_fapl(vol_id, threads, 0, 0)) < 0)
+        return -1;
+    file_id = H5Fopen(path, H5F_ACC_RDONLY, fapl_id);
+    H5Pclose(fapl_id);
+    if (file_id < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+
+    if (bench_read_all(dset_id, bc, buf, band_rows) < 0 || bench_get_stats(file_id, &before) < 0)
+        goto done;
+    for (i = 0; i < opts->repeat; i++) {
+        double start = bench_now();
+
+        if (bench_read_all(dset_id, bc, buf, band_rows) < 0)
+            goto done;
+        samples[i] = bench_now() - start;
+    }
+    if (bench_get_stats(file_id, stats) < 0)
+        goto done;
+    for (c = 0; c < GEOTIFF_NCOUNTERS; c++)
+        stats->counters[c] -= before.counters[c];
+
+    ret = 0;
+
+done:
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Time reading the whole image with 1, 2, 4, ... decoder threads, giving the
+ * throughput in decoded MB/s, its speedup over one thread, and how much of
+ * the time went into decoding and converting samples */
+static int bench_full_read(const bench_case_t *bc, long long file_bytes, const char *path,
+                           hid_t vol_id, const bench_options_t *opts)
+{
+    size_t row_bytes = (size_t) bc->size * bc->bands * 2;
+    uint32_t band_rows = (uint32_t) (BENCH_MAX_READ_BYTES / row_bytes);
+    double image_mb = (double) row_bytes * bc->size / 1e6, base = 0.0, *samples;
+    geotiff_stats_t stats;
+    void *buf = NULL;
+    unsigned threads;
+    int ret = -1;
+
+    /* Bands of whole tile rows, so that no tile is decoded twice */
+    if (band_rows > bc->size)
+        band_rows = bc->size;
+    if (band_rows > BENCH_TILE_SIZE)
+        band_rows -= band_rows % BENCH_TILE_SIZE;
+    if (band_rows == 0)
+        band_rows = 1;
+    if (!(samples = (double *) malloc(opts->repeat * sizeof(double))))
+        return -1;
+    if (!(buf = malloc(row_bytes * band_rows)))
+        goto done;
+
+    for (threads = 1; threads <= opts->max_threads; threads *= 2) {
+        double mbps;
+
+        if (bench_time_full_reads(path, vol_id, threads, bc, buf, band_rows, opts, samples,
+                                  &stats) < 0)
+            goto done;
+
+        qsort(samples, opts->repeat, sizeof(double), bench_cmp_double);
+        mbps = image_mb / bench_quantile(samples, opts->repeat, 0.5);
+        if (threads == 1)
+            base = mbps;
+
+        bench_print_case(bc, file_bytes, "full_read");
+        fprintf(bench_out_g,
+                ",\"threads\":%u,\"unit\":\"MB/s\",\"p50\":%.2f,\"max\":%.2f,\"speedup\":%.3f,"
+                "\"decode_ms\":%.3f,\"convert_ms\":%.3f,\"bytes_read\":%llu}\n",
+                threads, mbps, image_mb / samples[0], mbps / base,
+                (double) stats.counters[GEOTIFF_COUNTER_DECODE_NS] / 1e6 / opts->repeat,
+                (double) stats.counters[GEOTIFF_COUNTER_CONVERT_NS] / 1e6 / opts->repeat,
+                (unsigned long long) stats.counters[GEOTIFF_COUNTER_BYTES_READ] / opts->repeat);
+    }
+
+    ret = 0;
+
+done:
+    free(buf);
+    free(samples);
+
+    return ret;
+}
+
+/* Time reading windows of BENCH_WINDOW_SIZE pixels (every band) at random
+ * places, one thread, the same places on every run */
+static int bench_window_read(const bench_case_t *bc, long long file_bytes, const char *path,
+                             hid_t vol_id, const bench_options_t *opts)
+{
+    uint32_t edge = bc->size < BENCH_WINDOW_SIZE ? bc->size : BENCH_WINDOW_SIZE;
+    hsize_t start[3] = {0, 0, 0}, count[3] = {edge, edge, bc->bands};
+    hid_t fapl_id, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    hid_t file_space = H5I_INVALID_HID, mem_space = H5I_INVALID_HID;
+    uint64_t seed = 0x2545F4914F6CDD1DULL;
+    double *samples;
+    void *buf = NULL;
+    unsigned i;
+    int ret = -1;
+
+    if (!(samples = (double *) malloc(opts->windows * sizeof(double))))
+        return -1;
+    if ((fapl_id = bench_fapl(vol_id, 1, 0, 0)) < 0)
+        goto done;
+    file_id = H5Fopen(path, H5F_ACC_RDONLY, fapl_id);
+    H5Pclose(fapl_id);
+    if (file_id < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((file_space = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((mem_space = H5Screate_simple(bc->bands > 1 ? 3 : 2, count, NULL)) < 0)
+        goto done;
+    if (!(buf = malloc((size_t) edge * edge * bc->bands * 2)))
+        goto done;
+
+    for (i = 0; i < opts->windows; i++) {
+        double t0;
+
+        /* xorshift64 */
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        start[0] = (seed >> 8) % (bc->size - edge + 1);
+        start[1] = (seed >> 36) % (bc->size - edge + 1);
+
+        t0 = bench_now();
+        if (H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, NULL, count, NULL) < 0 ||
+            H5Dread(dset_id, H5T_NATIVE_UINT16, mem_space, file_space, H5P_DEFAULT, buf) < 0)
+            goto done;
+        samples[i] = (bench_now() - t0) * 1e6;
+    }
+
+    qsort(samples, opts->windows, sizeof(double), bench_cmp_double);
+    bench_print_case(bc, file_bytes, "window_read");
+    fprintf(bench_out_g,
+            ",\"window\":%u,\"unit\":\"us\",\"min\":%.1f,\"p50\":%.1f,\"p95\":%.1f,"
+            "\"p99\":%.1f}\n",
+            (unsigned) edge, samples[0], bench_quantile(samples, opts->windows, 0.5),
+            bench_quantile(samples, opts->windows, 0.95),
+            bench_quantile(samples, opts->windows, 0.99));
+
+    ret = 0;
+
+done:
+    free(buf);
+    if (mem_space >= 0)
+        H5Sclose(mem_space);
+    if (file_space >= 0)
+        H5Sclose(file_space);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    free(samples);
+
+    return ret;
+}
+
+/* Synthesize the file of a case and run every measurement on it */
+static int bench_run_case(const bench_case_t *bc, hid_t vol_id, const bench_options_t *opts)
+{
+    char path[4096];
+    long long file_bytes;
+    double start;
+    FILE *fp;
+    int ret = -1;
+
+    snprintf(path, sizeof(path), "%s/bench_%s_%s_b%u_%u%s.tif", opts->dir,
+             bc->tiled ? "tile" : "strip", bench_codec_name(bc->compression),
+             (unsigned) bc->bands, (unsigned) bc->size, bc->bigtiff ? "_big" : "");
+
+    start = bench_now();
+    if (bench_write_file(path, bc) < 0) {
+        fprintf(stderr, "Failed to write %s\n", path);
+        goto done;
+    }
+    if (!(fp = fopen(path, "rb")) || fseek(fp, 0, SEEK_END) != 0) {
+        if (fp)
+            fclose(fp);
+        goto done;
+    }
+    file_bytes = (long long) ftell(fp);
+    fclose(fp);
+    fprintf(stderr, "%s: %lld bytes, written in %.1f s\n", path, file_bytes, bench_now() - start);
+
+    if (bench_open(bc, file_bytes, path, vol_id, opts) < 0 ||
+        bench_file_open(bc, file_bytes, path, vol_id, opts) < 0 ||
+        bench_full_read(bc, file_bytes, path, vol_id, opts) < 0 ||
+        bench_window_read(bc, file_bytes, path, vol_id, opts) < 0) {
+        fprintf(stderr, "Failed to benchmark %s\n", path);
+        goto done;
+    }
+    fflush(bench_out_g);
+
+    ret = 0;
+
+done:
+    if (!opts->keep)
+        remove(path);
+
+    return ret;
+}
+
+/* Helper function to add a case, unless it is too big or already there */
+static void bench_add_case(bench_case_t *cases, size_t *ncases, const bench_options_t *opts,
+                           uint32_t size, uint16_t bands, int tiled, uint16_t compression,
+                           int bigtiff)
+{
+    bench_case_t *bc = &cases[*ncases];
+    size_t i;
+
+    if (size > opts->max_size || !TIFFIsCODECConfigured(compression))
+        return;
+
+    /* Classic TIFF offsets stop at 4 GiB */
+    if (!bigtiff && (uint64_t) size * size * bands * 2 >= ((uint64_t) 1 << 32))
+        return;
+
+    for (i = 0; i < *ncases; i++)
+        if (cases[i].size == size && cases[i].bands == bands && cases[i].tiled == tiled &&
+            cases[i].compression == compression && cases[i].bigtiff == bigtiff)
+            return;
+
+    bc->size = size;
+    bc->bands = bands;
+    bc->tiled = tiled;
+    bc->compression = compression;
+    bc->bigtiff = bigtiff;
+    (*ncases)++;
+}
+
+/* Most cases bench_make_cases() builds */
+#define BENCH_MAX_CASES 64
+
+/* Helper function to build the cases: every codec in strips and tiles, band
+ * counts from 1 to 16, edges from 1K to 64K pixels, and BigTIFF, each swept
+ * on its own from a 2K-pixel single-band deflate tiled base case */
+static size_t bench_make_cases(bench_case_t *cases, const bench_options_t *opts)
+{
+    static const uint16_t bands[] = {1, 3, 4, 16};
+    static const uint32_t sizes[] = {1024, 4096, 16384, 65536};
+    size_t ncases = 0, i;
+
+    for (i = 0; i < BENCH_NCODECS; i++) {
+        bench_add_case(cases, &ncases, opts, 2048, 1, 1, bench_codecs_g[i].compression, 0);
+        bench_add_case(cases, &ncases, opts, 2048, 1, 0, bench_codecs_g[i].compression, 0);
+    }
+    for (i = 0; i < sizeof(bands) / sizeof(bands[0]); i++)
+        bench_add_case(cases, &ncases, opts, 2048, bands[i], 1, COMPRESSION_ADOBE_DEFLATE, 0);
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        bench_add_case(cases, &ncases, opts, sizes[i], 1, 1, COMPRESSION_ADOBE_DEFLATE, 0);
+        bench_add_case(cases, &ncases, opts, sizes[i], 1, 1, COMPRESSION_ADOBE_DEFLATE, 1);
+    }
+    bench_add_case(cases, &ncases, opts, 2048, 1, 1, COMPRESSION_ADOBE_DEFLATE, 1);
+
+    return ncases;
+}
+
+static void bench_usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [--dir DIR] [--max-size PIXELS] [--repeat N] [--windows N]\n"
+            "       [--threads N] [--output FILE] [--keep]\n"
+            "\n"
+            "  --dir DIR          where files are synthesized (default .)\n"
+            "  --max-size PIXELS  largest image edge, up to 65536 (default 4096)\n"
+            "  --repeat N         timed opens and full reads per file (default 5)\n"
+            "  --windows N        random windows read per file (default 100)\n"
+            "  --threads N        most decoder threads of the scaling runs (default 8)\n"
+            "  --output FILE      write the results there instead of stdout\n"
+            "  --keep             keep the synthesized files\n",
+            prog);
+}
+
+/* Helper function to parse a positive number option */
+static int bench_parse_uint(const char *arg, unsigned long max, unsigned long *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtoul(arg, &end, 10);
+
+    return errno == 0 && end != arg && *end == '\0' && *value > 0 && *value <= max ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    bench_options_t opts = {".", 4096, 5, 100, 8, 0};
+    bench_case_t cases[BENCH_MAX_CASES];
+    const char *output = NULL;
+    unsigned majnum = 0, minnum = 0, relnum = 0;
+    size_t ncases, i;
+    hid_t vol_id;
+    int a, nerrors = 0;
+
+    for (a = 1; a < argc; a++) {
+        unsigned long value = 0;
+        int has_value = a + 1 < argc;
+
+        if (strcmp(argv[a], "--keep") == 0) {
+            opts.keep = 1;
+        } else if (strcmp(argv[a], "--dir") == 0 && has_value) {
+            opts.dir = argv[++a];
+        } else if (strcmp(argv[a], "--output") == 0 && has_value) {
+            output = argv[++a];
+        } else if (strcmp(argv[a], "--max-size") == 0 && has_value &&
+                   bench_parse_uint(argv[++a], 65536, &value) == 0) {
+            opts.max_size = (uint32_t) value;
+        } else if (strcmp(argv[a], "--repeat") == 0 && has_value &&
+                   bench_parse_uint(argv[++a], 1000, &value) == 0) {
+            opts.repeat = (unsigned) value;
+        } else if (strcmp(argv[a], "--windows") == 0 && has_value &&
+                   bench_parse_uint(argv[++a], 100000, &value) == 0) {
+            opts.windows = (unsigned) value;
+        } else if (strcmp(argv[a], "--threads") == 0 && has_value &&
+                   bench_parse_uint(argv[++a], GEOTIFF_MAX_THREADS, &value) == 0) {
+            opts.max_threads = (unsigned) value;
+        } else {
+            bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bench_out_g = stdout;
+    if (output && !(bench_out_g = fopen(output, "w"))) {
+        fprintf(stderr, "Failed to open %s\n", output);
+        return 1;
+    }
+
+    /* Register the GeoTIFF VOL connector */
+    if ((vol_id = H5VLregister_connector_by_name(GEOTIFF_VOL_CONNECTOR_NAME, H5P_DEFAULT)) < 0) {
+        fprintf(stderr, "Failed to register GeoTIFF VOL connector\n");
+        return 1;
+    }
+
+    /* The first line says what was benchmarked */
+    H5get_libversion(&majnum, &minnum, &relnum);
+    fprintf(bench_out_g,
+            "{\"benchmark\":\"geotiff_vol_read\",\"hdf5\":\"%u.%u.%u\",\"libtiff\":\"", majnum,
+            minnum, relnum);
+    for (const char *p = TIFFGetVersion(); *p && *p != '\n'; p++)
+        if (*p != '"' && *p != '\\')
+            fputc(*p, bench_out_g);
+    fprintf(bench_out_g, "\",\"repeat\":%u,\"windows\":%u,\"max_threads\":%u}\n", opts.repeat,
+            opts.windows, opts.max_threads);
+
+    ncases = bench_make_cases(cases, &opts);
+    for (i = 0; i < ncases; i++)
+        if (bench_run_case(&cases[i], vol_id, &opts) < 0)
+            nerrors++;
+
+    H5VLunregister_connector(vol_id);
+    if (bench_out_g != stdout)
+        fclose(bench_out_g);
+
+    return nerrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,335 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Process-wide LRU cache of decoded tiles and strips, shared by
+ *              every file and dataset the connector opens
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Initial number of hash buckets (a power of two) */
+#define GEOTIFF_CACHE_MIN_BUCKETS 1024
+
+/* A decoded chunk. Entries stay alive while a reader holds them, even after
+ * they have been evicted from the cache. */
+struct geotiff_cache_entry_t {
+    geotiff_cache_key_t key;                 /* Chunk identity */
+    unsigned char *data;                     /* Decoded chunk */
+    size_t size;                             /* Size of data in bytes */
+    unsigned refs;                           /* Readers, plus one while cached */
+    int cached;                              /* Entry is in the hash table and LRU list */
+    struct geotiff_cache_entry_t *hash_next; /* Next entry in the same bucket */
+    struct geotiff_cache_entry_t *lru_prev;  /* More recently used entry */
+    struct geotiff_cache_entry_t *lru_next;  /* Less recently used entry */
+};
+
+/* The cache */
+typedef struct geotiff_cache_t {
+    pthread_mutex_t mutex;            /* Protects everything below */
+    geotiff_cache_entry_t **buckets;  /* Hash table */
+    size_t nbuckets;                  /* Number of buckets (a power of two) */
+    size_t nentries;                  /* Number of cached entries */
+    size_t bytes;                     /* Bytes held by cached entries */
+    size_t budget;                    /* Most bytes the cache may hold */
+    geotiff_cache_entry_t *lru_head;  /* Most recently used entry */
+    geotiff_cache_entry_t *lru_tail;  /* Least recently used entry */
+    uint64_t hits, misses, evictions; /* Counters */
+} geotiff_cache_t;
+
+static geotiff_cache_t geotiff_cache_g = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .budget = (size_t) GEOTIFF_DEFAULT_CACHE_MB * 1024 * 1024,
+};
+
+/* Helper function to hash a chunk key */
+static size_t geotiff_cache_hash(const geotiff_cache_key_t *key)
+{
+    uint64_t h = 14695981039346656037ULL;
+    uint64_t v[9];
+    int i;
+
+    v[0] = key->file.dev;
+    v[1] = key->file.ino;
+    v[2] = key->file.size;
+    v[3] = key->file.mtime;
+    v[4] = key->file.mtime_nsec;
+    v[5] = key->file.ctime;
+    v[6] = key->file.generation;
+    v[7] = key->ifd;
+    v[8] = key->chunk;
+
+    for (i = 0; i < 9; i++) {
+        h ^= v[i];
+        h *= 1099511628211ULL;
+        h ^= h >> 29;
+    }
+
+    return (size_t) h;
+}
+
+static int geotiff_cache_key_eq(const geotiff_cache_key_t *a, const geotiff_cache_key_t *b)
+{
+    return a->file.dev == b->file.dev && a->file.ino == b->file.ino &&
+           a->file.size == b->file.size && a->file.mtime == b->file.mtime &&
+           a->file.mtime_nsec == b->file.mtime_nsec && a->file.ctime == b->file.ctime &&
+           a->file.generation == b->file.generation && a->ifd == b->ifd && a->chunk == b->chunk;
+}
+
+/* Helper function to drop a reference, freeing the entry with the last one */
+static void geotiff_cache_unref(geotiff_cache_entry_t *entry)
+{
+    if (--entry->refs == 0) {
+        free(entry->data);
+        free(entry);
+    }
+}
+
+static void geotiff_cache_lru_unlink(geotiff_cache_t *cache, geotiff_cache_entry_t *entry)
+{
+    if (entry->lru_prev)
+        entry->lru_prev->lru_next = entry->lru_next;
+    else
+        cache->lru_head = entry->lru_next;
+    if (entry->lru_next)
+        entry->lru_next->lru_prev = entry->lru_prev;
+    else
+        cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void geotiff_cache_lru_push(geotiff_cache_t *cache, geotiff_cache_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head)
+        cache->lru_head->lru_prev = entry;
+    else
+        cache->lru_tail = entry;
+    cache->lru_head = entry;
+}
+
+/* Helper function to take an entry out of the cache. Readers still holding it
+ * keep it alive. */
+static void geotiff_cache_remove(geotiff_cache_t *cache, geotiff_cache_entry_t *entry)
+{
+    geotiff_cache_entry_t **link =
+        &cache->buckets[geotiff_cache_hash(&entry->key) & (cache->nbuckets - 1)];
+
+    while (*link != entry)
+        link = &(*link)->hash_next;
+    *link = entry->hash_next;
+    entry->hash_next = NULL;
+
+    geotiff_cache_lru_unlink(cache, entry);
+    cache->nentries--;
+    cache->bytes -= entry->size;
+    entry->cached = 0;
+    geotiff_cache_unref(entry);
+}
+
+/* Helper function to evict least recently used entries until the cache fits
+ * in its budget */
+static void geotiff_cache_trim(geotiff_cache_t *cache)
+{
+    while (cache->bytes > cache->budget && cache->lru_tail) {
+        geotiff_cache_remove(cache, cache->lru_tail);
+        cache->evictions++;
+    }
+}
+
+/* Helper function to double the hash table once it is as full as it is wide */
+static void geotiff_cache_grow(geotiff_cache_t *cache)
+{
+    geotiff_cache_entry_t **buckets;
+    size_t nbuckets = cache->nbuckets ? 2 * cache->nbuckets : GEOTIFF_CACHE_MIN_BUCKETS;
+    size_t i;
+
+    if (!(buckets = (geotiff_cache_entry_t **) calloc(nbuckets, sizeof(*buckets))))
+        return;
+
+    for (i = 0; i < cache->nbuckets; i++) {
+        geotiff_cache_entry_t *entry = cache->buckets[i], *next;
+
+        for (; entry; entry = next) {
+            size_t b = geotiff_cache_hash(&entry->key) & (nbuckets - 1);
+
+            next = entry->hash_next;
+            entry->hash_next = buckets[b];
+            buckets[b] = entry;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->nbuckets = nbuckets;
+}
+
+/* Helper function to check whether decoded chunks are being cached at all */
+int geotiff_cache_enabled(void)
+{
+    int enabled;
+
+    pthread_mutex_lock(&geotiff_cache_g.mutex);
+    enabled = geotiff_cache_g.budget > 0;
+    pthread_mutex_unlock(&geotiff_cache_g.mutex);
+
+    return enabled;
+}
+
+/* Helper function to set the cache's byte budget, evicting down to it */
+void geotiff_cache_set_budget(size_t bytes)
+{
+    pthread_mutex_lock(&geotiff_cache_g.mutex);
+    geotiff_cache_g.budget = bytes;
+    geotiff_cache_trim(&geotiff_cache_g);
+    pthread_mutex_unlock(&geotiff_cache_g.mutex);
+}
+
+/* Helper function to look up a decoded chunk. A hit is returned held, and
+ * must be handed back with geotiff_cache_release(). */
+geotiff_cache_entry_t *geotiff_cache_get(const geotiff_cache_key_t *key)
+{
+    geotiff_cache_t *cache = &geotiff_cache_g;
+    geotiff_cache_entry_t *entry = NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    if (cache->nbuckets > 0) {
+        entry = cache->buckets[geotiff_cache_hash(key) & (cache->nbuckets - 1)];
+        while (entry && !geotiff_cache_key_eq(&entry->key, key))
+            entry = entry->hash_next;
+    }
+
+    if (entry) {
+        entry->refs++;
+        geotiff_cache_lru_unlink(cache, entry);
+        geotiff_cache_lru_push(cache, entry);
+        cache->hits++;
+    } else {
+        cache->misses++;
+    }
+
+    pthread_mutex_unlock(&cache->mutex);
+
+    return entry;
+}
+
+/* Helper function to add a decoded chunk to the cache. The cache takes
+ * ownership of data (allocated with malloc) and returns the entry held, even
+ * when the chunk does not fit in the budget or another thread cached it first.
+ * Returns NULL, with data freed, only when out of memory. */
+geotiff_cache_entry_t *geotiff_cache_put(const geotiff_cache_key_t *key, unsigned char *data,
+                                         size_t size)
+{
+    geotiff_cache_t *cache = &geotiff_cache_g;
+    geotiff_cache_entry_t *entry, *existing = NULL;
+    size_t b;
+
+    if (!(entry = (geotiff_cache_entry_t *) calloc(1, sizeof(geotiff_cache_entry_t)))) {
+        free(data);
+        return NULL;
+    }
+    entry->key = *key;
+    entry->data = data;
+    entry->size = size;
+    entry->refs = 1;
+
+    pthread_mutex_lock(&cache->mutex);
+
+    if (size > cache->budget)
+        goto done;
+
+    if (cache->nentries >= cache->nbuckets)
+        geotiff_cache_grow(cache);
+    if (cache->nbuckets == 0)
+        goto done;
+
+    /* Another thread decoded the same chunk first: keep its copy */
+    b = geotiff_cache_hash(key) & (cache->nbuckets - 1);
+    for (existing = cache->buckets[b]; existing; existing = existing->hash_next)
+        if (geotiff_cache_key_eq(&existing->key, key))
+            break;
+    if (existing) {
+        existing->refs++;
+        goto done;
+    }
+
+    entry->refs++;
+    entry->cached = 1;
+    entry->hash_next = cache->buckets[b];
+    cache->buckets[b] = entry;
+    geotiff_cache_lru_push(cache, entry);
+    cache->nentries++;
+    cache->bytes += size;
+    geotiff_cache_trim(cache);
+
+done:
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (existing) {
+        free(entry->data);
+        free(entry);
+        entry = existing;
+    }
+
+    return entry;
+}
+
+/* Helper function to get the decoded pixels of a held entry */
+const unsigned char *geotiff_cache_data(const geotiff_cache_entry_t *entry)
+{
+    return entry->data;
+}
+
+/* Helper function to hand back an entry returned by geotiff_cache_get() or
+ * geotiff_cache_put() */
+void geotiff_cache_release(geotiff_cache_entry_t *entry)
+{
+    if (!entry)
+        return;
+
+    pthread_mutex_lock(&geotiff_cache_g.mutex);
+    geotiff_cache_unref(entry);
+    pthread_mutex_unlock(&geotiff_cache_g.mutex);
+}
+
+/* Helper function to get a snapshot of the cache counters */
+void geotiff_cache_get_stats(geotiff_cache_stats_t *stats)
+{
+    pthread_mutex_lock(&geotiff_cache_g.mutex);
+    stats->hits = geotiff_cache_g.hits;
+    stats->misses = geotiff_cache_g.misses;
+    stats->evictions = geotiff_cache_g.evictions;
+    stats->entries = geotiff_cache_g.nentries;
+    stats->bytes = geotiff_cache_g.bytes;
+    stats->budget = geotiff_cache_g.budget;
+    pthread_mutex_unlock(&geotiff_cache_g.mutex);
+}
+
+/* Helper function to drop every cached chunk, e.g. when the connector terminates */
+void geotiff_cache_clear(void)
+{
+    geotiff_cache_t *cache = &geotiff_cache_g;
+
+    pthread_mutex_lock(&cache->mutex);
+    while (cache->lru_tail)
+        geotiff_cache_remove(cache, cache->lru_tail);
+    free(cache->buckets);
+    cache->buckets = NULL;
+    cache->nbuckets = 0;
+    pthread_mutex_unlock(&cache->mutex);
+}
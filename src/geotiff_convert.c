@@ -0,0 +1,358 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Conversion of samples between the native integer and floating
+ *              point types, applied while pixels are copied out of a chunk
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEOTIFF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* Integer results saturate at the limits of the memory type, and NaN becomes
+ * 0, as with HDF5's own hard conversions. Samples are loaded and stored with
+ * memcpy() since pixels in a file mapping need not be aligned. */
+
+/* Samples are widened to the 64-bit type of their kind before being compared
+ * with the destination limits */
+typedef int64_t geotiff_wide_S;
+typedef uint64_t geotiff_wide_U;
+typedef double geotiff_wide_F;
+
+/* Signed source, integer destination */
+#define GEOTIFF_CONV_S(w, DT, LO, HI, SHI)                                                        \
+    ((DT) (w < (int64_t) (LO) ? (int64_t) (LO) : w > (int64_t) (SHI) ? (int64_t) (SHI) : w))
+
+/* Unsigned source, integer destination */
+#define GEOTIFF_CONV_U(w, DT, LO, HI, SHI) ((DT) (w > (uint64_t) (HI) ? (uint64_t) (HI) : w))
+
+/* Floating point source, integer destination */
+#define GEOTIFF_CONV_F(w, DT, LO, HI, SHI)                                                        \
+    (w != w ? (DT) 0 : w <= (double) (LO) ? (DT) (LO) : w >= (double) (HI) ? (DT) (HI) : (DT) w)
+
+#define GEOTIFF_DEF_CONV_INT(SN, ST, K, DN, DT, LO, HI, SHI)                                      \
+    static void geotiff_conv_##SN##_##DN(void *dst, const void *src, size_t n)                    \
+    {                                                                                              \
+        const unsigned char *s = (const unsigned char *) src;                                      \
+        unsigned char *d = (unsigned char *) dst;                                                  \
+        size_t i;                                                                                  \
+                                                                                                   \
+        for (i = 0; i < n; i++) {                                                                  \
+            ST v;                                                                                  \
+            geotiff_wide_##K w;                                                                    \
+            DT r;                                                                                  \
+                                                                                                   \
+            memcpy(&v, s + i * sizeof(ST), sizeof(ST));                                            \
+            w = (geotiff_wide_##K) v;                                                              \
+            r = GEOTIFF_CONV_##K(w, DT, LO, HI, SHI);                                              \
+            memcpy(d + i * sizeof(DT), &r, sizeof(DT));                                            \
+        }                                                                                          \
+    }
+
+#define GEOTIFF_DEF_CONV_FLOAT(SN, ST, DN, DT)                                                    \
+    static void geotiff_conv_##SN##_##DN(void *dst, const void *src, size_t n)                    \
+    {                                                                                              \
+        const unsigned char *s = (const unsigned char *) src;                                      \
+        unsigned char *d = (unsigned char *) dst;                                                  \
+        size_t i;                                                                                  \
+                                                                                                   \
+        for (i = 0; i < n; i++) {                                                                  \
+            ST v;                                                                                  \
+            DT r;                                                                                  \
+                                                                                                   \
+            memcpy(&v, s + i * sizeof(ST), sizeof(ST));                                            \
+            r = (DT) v;                                                                            \
+            memcpy(d + i * sizeof(DT), &r, sizeof(DT));                                            \
+        }                                                                                          \
+    }
+
+/* Every conversion from one source type: to each integer type (with its
+ * limits, and its upper limit as a signed 64-bit value), then to each
+ * floating point type */
+#define GEOTIFF_DEF_CONV_FROM(SN, ST, K)                                                          \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, u8, uint8_t, 0, UINT8_MAX, UINT8_MAX)                          \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, i8, int8_t, INT8_MIN, INT8_MAX, INT8_MAX)                      \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, u16, uint16_t, 0, UINT16_MAX, UINT16_MAX)                      \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, i16, int16_t, INT16_MIN, INT16_MAX, INT16_MAX)                 \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, u32, uint32_t, 0, UINT32_MAX, UINT32_MAX)                      \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, i32, int32_t, INT32_MIN, INT32_MAX, INT32_MAX)                 \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, u64, uint64_t, 0, UINT64_MAX, INT64_MAX)                       \
+    GEOTIFF_DEF_CONV_INT(SN, ST, K, i64, int64_t, INT64_MIN, INT64_MAX, INT64_MAX)                 \
+    GEOTIFF_DEF_CONV_FLOAT(SN, ST, f32, float)                                                     \
+    GEOTIFF_DEF_CONV_FLOAT(SN, ST, f64, double)
+
+GEOTIFF_DEF_CONV_FROM(u8, uint8_t, U)
+GEOTIFF_DEF_CONV_FROM(i8, int8_t, S)
+GEOTIFF_DEF_CONV_FROM(u16, uint16_t, U)
+GEOTIFF_DEF_CONV_FROM(i16, int16_t, S)
+GEOTIFF_DEF_CONV_FROM(u32, uint32_t, U)
+GEOTIFF_DEF_CONV_FROM(i32, int32_t, S)
+GEOTIFF_DEF_CONV_FROM(u64, uint64_t, U)
+GEOTIFF_DEF_CONV_FROM(i64, int64_t, S)
+GEOTIFF_DEF_CONV_FROM(f32, float, F)
+GEOTIFF_DEF_CONV_FROM(f64, double, F)
+
+#define GEOTIFF_CONV_ROW(SN)                                                                      \
+    {geotiff_conv_##SN##_u8,  geotiff_conv_##SN##_i8,  geotiff_conv_##SN##_u16,                    \
+     geotiff_conv_##SN##_i16, geotiff_conv_##SN##_u32, geotiff_conv_##SN##_i32,                    \
+     geotiff_conv_##SN##_u64, geotiff_conv_##SN##_i64, geotiff_conv_##SN##_f32,                    \
+     geotiff_conv_##SN##_f64}
+
+/* Conversion functions by [source][destination] type; identical types are
+ * copied with memcpy() instead */
+static geotiff_convert_func_t geotiff_convert_g[GEOTIFF_NTYPES][GEOTIFF_NTYPES] = {
+    GEOTIFF_CONV_ROW(u8),  GEOTIFF_CONV_ROW(i8),  GEOTIFF_CONV_ROW(u16), GEOTIFF_CONV_ROW(i16),
+    GEOTIFF_CONV_ROW(u32), GEOTIFF_CONV_ROW(i32), GEOTIFF_CONV_ROW(u64), GEOTIFF_CONV_ROW(i64),
+    GEOTIFF_CONV_ROW(f32), GEOTIFF_CONV_ROW(f64),
+};
+
+static pthread_once_t geotiff_convert_once_g = PTHREAD_ONCE_INIT;
+
+#ifdef GEOTIFF_HAVE_X86_SIMD
+/* Vector versions of the widening conversions to float that dominate image
+ * processing; the remainder of each run goes through the scalar loop */
+
+__attribute__((target("sse2"))) static void geotiff_conv_u8_f32_sse2(void *dst, const void *src,
+                                                                     size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + i));
+        __m128i lo = _mm_unpacklo_epi8(x, zero), hi = _mm_unpackhi_epi8(x, zero);
+
+        _mm_storeu_ps(d + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+        _mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+        _mm_storeu_ps(d + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+        _mm_storeu_ps(d + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+    }
+    geotiff_conv_u8_f32(d + i, s + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void geotiff_conv_u16_f32_sse2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    const __m128i zero = _mm_setzero_si128();
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + 2 * i));
+
+        _mm_storeu_ps(d + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)));
+        _mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)));
+    }
+    geotiff_conv_u16_f32(d + i, s + 2 * i, n - i);
+}
+
+__attribute__((target("sse2"))) static void geotiff_conv_i16_f32_sse2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + 2 * i));
+
+        /* Sign-extend by shifting each sample down from the top half */
+        _mm_storeu_ps(d + i, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16)));
+        _mm_storeu_ps(d + i + 4, _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16)));
+    }
+    geotiff_conv_i16_f32(d + i, s + 2 * i, n - i);
+}
+
+__attribute__((target("sse2"))) static void geotiff_conv_i32_f32_sse2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm_storeu_ps(d + i, _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *) (s + 4 * i))));
+    geotiff_conv_i32_f32(d + i, s + 4 * i, n - i);
+}
+
+__attribute__((target("avx2"))) static void geotiff_conv_u8_f32_avx2(void *dst, const void *src,
+                                                                     size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadl_epi64((const __m128i *) (s + i));
+
+        _mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(x)));
+    }
+    geotiff_conv_u8_f32(d + i, s + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void geotiff_conv_u16_f32_avx2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + 2 * i));
+
+        _mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(x)));
+    }
+    geotiff_conv_u16_f32(d + i, s + 2 * i, n - i);
+}
+
+__attribute__((target("avx2"))) static void geotiff_conv_i16_f32_avx2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (s + 2 * i));
+
+        _mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)));
+    }
+    geotiff_conv_i16_f32(d + i, s + 2 * i, n - i);
+}
+
+__attribute__((target("avx2"))) static void geotiff_conv_i32_f32_avx2(void *dst, const void *src,
+                                                                      size_t n)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    float *d = (float *) dst;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (s + 4 * i));
+
+        _mm256_storeu_ps(d + i, _mm256_cvtepi32_ps(x));
+    }
+    geotiff_conv_i32_f32(d + i, s + 4 * i, n - i);
+}
+#endif /* GEOTIFF_HAVE_X86_SIMD */
+
+/* Helper function to install the vector conversions the CPU supports */
+static void geotiff_convert_init(void)
+{
+    int t;
+
+    for (t = 0; t < GEOTIFF_NTYPES; t++)
+        geotiff_convert_g[t][t] = NULL;
+
+#ifdef GEOTIFF_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        geotiff_convert_g[GEOTIFF_U8][GEOTIFF_F32] = geotiff_conv_u8_f32_avx2;
+        geotiff_convert_g[GEOTIFF_U16][GEOTIFF_F32] = geotiff_conv_u16_f32_avx2;
+        geotiff_convert_g[GEOTIFF_I16][GEOTIFF_F32] = geotiff_conv_i16_f32_avx2;
+        geotiff_convert_g[GEOTIFF_I32][GEOTIFF_F32] = geotiff_conv_i32_f32_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        geotiff_convert_g[GEOTIFF_U8][GEOTIFF_F32] = geotiff_conv_u8_f32_sse2;
+        geotiff_convert_g[GEOTIFF_U16][GEOTIFF_F32] = geotiff_conv_u16_f32_sse2;
+        geotiff_convert_g[GEOTIFF_I16][GEOTIFF_F32] = geotiff_conv_i16_f32_sse2;
+        geotiff_convert_g[GEOTIFF_I32][GEOTIFF_F32] = geotiff_conv_i32_f32_sse2;
+    }
+#endif
+}
+
+/* Helper function to get the function converting src samples to dst samples,
+ * or NULL when they are the same type and a plain copy will do */
+geotiff_convert_func_t geotiff_get_convert(geotiff_ntype_t src, geotiff_ntype_t dst)
+{
+    pthread_once(&geotiff_convert_once_g, geotiff_convert_init);
+
+    return geotiff_convert_g[src][dst];
+}
+
+/* Helper function to get the size in bytes of a sample type */
+size_t geotiff_ntype_size(geotiff_ntype_t type)
+{
+    static const size_t sizes[GEOTIFF_NTYPES] = {1, 1, 2, 2, 4, 4, 8, 8, 4, 8};
+
+    return sizes[type];
+}
+
+/* Helper function to get the sample type of a TIFF sample format and width.
+ * Returns -1 for samples the connector cannot convert (e.g. 16-bit floats). */
+int geotiff_get_tiff_ntype(uint16_t sample_format, uint16_t bits_per_sample)
+{
+    int is_signed = sample_format == SAMPLEFORMAT_INT;
+
+    if (sample_format == SAMPLEFORMAT_IEEEFP) {
+        if (bits_per_sample == 32)
+            return GEOTIFF_F32;
+        if (bits_per_sample == 64)
+            return GEOTIFF_F64;
+        return -1;
+    }
+    if (sample_format != SAMPLEFORMAT_UINT && sample_format != SAMPLEFORMAT_INT)
+        return -1;
+
+    switch (bits_per_sample) {
+        case 8:
+            return is_signed ? GEOTIFF_I8 : GEOTIFF_U8;
+        case 16:
+            return is_signed ? GEOTIFF_I16 : GEOTIFF_U16;
+        case 32:
+            return is_signed ? GEOTIFF_I32 : GEOTIFF_U32;
+        case 64:
+            return is_signed ? GEOTIFF_I64 : GEOTIFF_U64;
+        default:
+            return -1;
+    }
+}
+
+/* Helper function to get the sample type of an HDF5 memory type. Returns -1
+ * for anything other than a native-order integer or IEEE float, which the
+ * caller then leaves to H5Tconvert(). */
+int geotiff_get_mem_ntype(hid_t type_id)
+{
+    hid_t native[GEOTIFF_NTYPES];
+    htri_t eq;
+    int t;
+
+    native[GEOTIFF_U8] = H5T_NATIVE_UINT8;
+    native[GEOTIFF_I8] = H5T_NATIVE_INT8;
+    native[GEOTIFF_U16] = H5T_NATIVE_UINT16;
+    native[GEOTIFF_I16] = H5T_NATIVE_INT16;
+    native[GEOTIFF_U32] = H5T_NATIVE_UINT32;
+    native[GEOTIFF_I32] = H5T_NATIVE_INT32;
+    native[GEOTIFF_U64] = H5T_NATIVE_UINT64;
+    native[GEOTIFF_I64] = H5T_NATIVE_INT64;
+    native[GEOTIFF_F32] = H5T_NATIVE_FLOAT;
+    native[GEOTIFF_F64] = H5T_NATIVE_DOUBLE;
+
+    for (t = 0; t < GEOTIFF_NTYPES; t++) {
+        if ((eq = H5Tequal(type_id, native[t])) < 0)
+            return -1;
+        if (eq)
+            return t;
+    }
+
+    return -1;
+}
@@ -0,0 +1,350 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Coordinate variables of an image, computed from the file's
+ *              geotransform for just the elements a read selects
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEOTIFF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* GeoKey values the coordinates depend on */
+#define GEOTIFF_MODEL_GEOGRAPHIC      2    /* GTModelTypeGeoKey */
+#define GEOTIFF_RASTER_PIXEL_IS_POINT 2    /* GTRasterTypeGeoKey */
+#define GEOTIFF_LINEAR_METER          9001 /* ProjLinearUnitsGeoKey */
+#define GEOTIFF_LINEAR_FOOT           9002
+#define GEOTIFF_LINEAR_US_FOOT        9003
+
+/* Dataset names, by coordinate variable */
+static const char *const geotiff_coord_names_g[GEOTIFF_NCOORDS] = {"x", "y", "lon", "lat"};
+
+/* Fills values[i] = a + (x0 + i) * b, for i < n */
+typedef void (*geotiff_ramp_func_t)(double *values, size_t n, double a, double x0, double b);
+
+static void geotiff_ramp(double *values, size_t n, double a, double x0, double b)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        values[i] = a + (x0 + (double) i) * b;
+}
+
+static geotiff_ramp_func_t geotiff_ramp_g = geotiff_ramp;
+static pthread_once_t geotiff_ramp_once_g = PTHREAD_ONCE_INIT;
+
+#ifdef GEOTIFF_HAVE_X86_SIMD
+/* Vector versions of the ramp. Raster positions are whole numbers (plus a
+ * half), so stepping them by the vector width is exact and every value comes
+ * out bit for bit as the scalar loop computes it. */
+
+__attribute__((target("sse2"))) static void geotiff_ramp_sse2(double *values, size_t n, double a,
+                                                              double x0, double b)
+{
+    const __m128d va = _mm_set1_pd(a), vb = _mm_set1_pd(b), step = _mm_set1_pd(2.0);
+    __m128d x = _mm_set_pd(x0 + 1.0, x0);
+    size_t i;
+
+    for (i = 0; i + 2 <= n; i += 2) {
+        _mm_storeu_pd(values + i, _mm_add_pd(va, _mm_mul_pd(x, vb)));
+        x = _mm_add_pd(x, step);
+    }
+    geotiff_ramp(values + i, n - i, a, x0 + (double) i, b);
+}
+
+__attribute__((target("avx"))) static void geotiff_ramp_avx(double *values, size_t n, double a,
+                                                            double x0, double b)
+{
+    const __m256d va = _mm256_set1_pd(a), vb = _mm256_set1_pd(b), step = _mm256_set1_pd(4.0);
+    __m256d x = _mm256_set_pd(x0 + 3.0, x0 + 2.0, x0 + 1.0, x0);
+    size_t i;
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(values + i, _mm256_add_pd(va, _mm256_mul_pd(x, vb)));
+        x = _mm256_add_pd(x, step);
+    }
+    geotiff_ramp(values + i, n - i, a, x0 + (double) i, b);
+}
+#endif /* GEOTIFF_HAVE_X86_SIMD */
+
+/* Helper function to install the vector ramp the CPU supports */
+static void geotiff_ramp_init(void)
+{
+#ifdef GEOTIFF_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        geotiff_ramp_g = geotiff_ramp_avx;
+    else if (__builtin_cpu_supports("sse2"))
+        geotiff_ramp_g = geotiff_ramp_sse2;
+#endif
+}
+
+/* Helper function to get the first value of a SHORT GeoKey from the file's
+ * metadata catalog, or def if the file does not have it */
+static int geotiff_coords_get_key(const geotiff_meta_t *meta, const char *name, int def)
+{
+    const geotiff_meta_entry_t *entry = geotiff_meta_find(meta, name);
+    uint16_t value;
+
+    if (!entry || entry->type != GEOTIFF_META_SHORT || entry->count < 1)
+        return def;
+    memcpy(&value, meta->pool + entry->data, sizeof(value));
+
+    return value;
+}
+
+/* Helper function to get the geotransform of the image from its
+ * ModelTransformationTag, or from its first tie point and its pixel scale.
+ * Returns 1 if the file has one, 0 if not (e.g. it only has ground control
+ * points). */
+static int geotiff_coords_get_transform(const geotiff_meta_t *meta, geotiff_transform_t *transform)
+{
+    const geotiff_meta_entry_t *matrix, *tiepoint, *scale;
+    double *gt = transform->gt;
+
+    if ((matrix = geotiff_meta_find(meta, "ModelTransformationTag")) && matrix->count >= 16) {
+        const double *m = (const double *) (meta->pool + matrix->data);
+
+        /* Row-major 4 x 4 matrix of which only the X and Y rows matter */
+        gt[0] = m[3];
+        gt[1] = m[0];
+        gt[2] = m[1];
+        gt[3] = m[7];
+        gt[4] = m[4];
+        gt[5] = m[5];
+    } else if ((tiepoint = geotiff_meta_find(meta, "ModelTiepointTag")) &&
+               tiepoint->count >= 6 &&
+               (scale = geotiff_meta_find(meta, "ModelPixelScaleTag")) && scale->count >= 2) {
+        const double *tp = (const double *) (meta->pool + tiepoint->data);
+        const double *s = (const double *) (meta->pool + scale->data);
+
+        /* Raster (I, J) of the tie point is at model (X, Y), and rows go down */
+        gt[0] = tp[3] - tp[0] * s[0];
+        gt[1] = s[0];
+        gt[2] = 0;
+        gt[3] = tp[4] + tp[1] * s[1];
+        gt[4] = 0;
+        gt[5] = -s[1];
+    } else {
+        return 0;
+    }
+
+    /* Pixel centers are half a pixel into each pixel's area, or at the
+     * raster positions themselves when pixels are points */
+    transform->center = geotiff_coords_get_key(meta, "GTRasterTypeGeoKey", 1) ==
+                                GEOTIFF_RASTER_PIXEL_IS_POINT
+                            ? 0.0
+                            : 0.5;
+    transform->geographic =
+        geotiff_coords_get_key(meta, "GTModelTypeGeoKey", 0) == GEOTIFF_MODEL_GEOGRAPHIC;
+
+    return 1;
+}
+
+/* Helper function to add a string attribute to a catalog */
+static herr_t geotiff_coords_add_attr(geotiff_meta_t *meta, const char *name, const char *value)
+{
+    return geotiff_meta_add(meta, name, GEOTIFF_META_STRING, value, strlen(value));
+}
+
+/* Helper function to build the attributes of a coordinate variable: the
+ * dimension scale attributes of the 1-D ones, which netCDF-C reads as
+ * coordinate variables, and CF attributes naming what they hold */
+static herr_t geotiff_coords_set_attrs(const geotiff_file_t *file, geotiff_coord_t coord,
+                                       geotiff_meta_t *meta)
+{
+    static const char *const axes[GEOTIFF_NCOORDS] = {"X", "Y", "X", "Y"};
+    static const char *const geographic_names[GEOTIFF_NCOORDS] = {"longitude", "latitude",
+                                                                  "longitude", "latitude"};
+    static const char *const geographic_units[GEOTIFF_NCOORDS] = {"degrees_east", "degrees_north",
+                                                                  "degrees_east", "degrees_north"};
+    static const char *const projected_names[2] = {"projection_x_coordinate",
+                                                   "projection_y_coordinate"};
+    static const char *const projected_long_names[2] = {"x coordinate of projection",
+                                                        "y coordinate of projection"};
+    const char *units = NULL;
+
+    if (geotiff_coords_ndims(coord) == 1) {
+        if (geotiff_coords_add_attr(meta, "CLASS", "DIMENSION_SCALE") < 0 ||
+            geotiff_coords_add_attr(meta, "NAME", geotiff_coord_names_g[coord]) < 0)
+            return -1;
+    }
+    if (geotiff_coords_add_attr(meta, "axis", axes[coord]) < 0)
+        return -1;
+
+    if (file->coords.transform.geographic) {
+        if (geotiff_coords_add_attr(meta, "standard_name", geographic_names[coord]) < 0 ||
+            geotiff_coords_add_attr(meta, "long_name", geographic_names[coord]) < 0)
+            return -1;
+        units = geographic_units[coord];
+    } else {
+        if (geotiff_coords_add_attr(meta, "standard_name", projected_names[coord]) < 0 ||
+            geotiff_coords_add_attr(meta, "long_name", projected_long_names[coord]) < 0)
+            return -1;
+        switch (geotiff_coords_get_key(&file->meta, "ProjLinearUnitsGeoKey", 0)) {
+            case GEOTIFF_LINEAR_METER:
+                units = "m";
+                break;
+            case GEOTIFF_LINEAR_FOOT:
+                units = "ft";
+                break;
+            case GEOTIFF_LINEAR_US_FOOT:
+                units = "US_survey_foot";
+                break;
+            default:
+                break;
+        }
+    }
+    if (units && geotiff_coords_add_attr(meta, "units", units) < 0)
+        return -1;
+
+    return geotiff_meta_index(meta);
+}
+
+/* Helper function to set up the coordinate variables of a file from its
+ * metadata catalog and the size of its image: 1-D x and y when the
+ * geotransform is not rotated, 2-D lon and lat when it is and the model is
+ * geographic (projected rotated grids would need a projection library to get
+ * latitudes and longitudes) */
+herr_t geotiff_coords_init(geotiff_file_t *file, uint32_t width, uint32_t height)
+{
+    geotiff_coords_t *coords = &file->coords;
+    const double *gt = coords->transform.gt;
+    int c;
+
+    memset(coords, 0, sizeof(*coords));
+
+    coords->transform.width = width;
+    coords->transform.height = height;
+    if (!geotiff_coords_get_transform(&file->meta, &coords->transform))
+        return 0;
+
+    if (gt[2] == 0 && gt[4] == 0)
+        coords->mask = (1u << GEOTIFF_COORD_X) | (1u << GEOTIFF_COORD_Y);
+    else if (coords->transform.geographic)
+        coords->mask = (1u << GEOTIFF_COORD_LON) | (1u << GEOTIFF_COORD_LAT);
+
+    for (c = 0; c < GEOTIFF_NCOORDS; c++)
+        if ((coords->mask & (1u << c)) &&
+            geotiff_coords_set_attrs(file, (geotiff_coord_t) c, &coords->meta[c]) < 0) {
+            geotiff_coords_free(file);
+            return -1;
+        }
+
+    return 0;
+}
+
+/* Helper function to free the coordinate variables of a file */
+void geotiff_coords_free(geotiff_file_t *file)
+{
+    int c;
+
+    for (c = 0; c < GEOTIFF_NCOORDS; c++)
+        geotiff_meta_free(&file->coords.meta[c]);
+    file->coords.mask = 0;
+}
+
+/* Helper function to look a coordinate variable of a file up by dataset name.
+ * Returns -1 if the file has no such variable. */
+int geotiff_coords_find(const geotiff_file_t *file, const char *name)
+{
+    int c;
+
+    for (c = 0; c < GEOTIFF_NCOORDS; c++)
+        if ((file->coords.mask & (1u << c)) && strcmp(name, geotiff_coord_names_g[c]) == 0)
+            return c;
+
+    return -1;
+}
+
+/* Helper function to get the dataset name of a coordinate variable */
+const char *geotiff_coords_name(geotiff_coord_t coord)
+{
+    return geotiff_coord_names_g[coord];
+}
+
+/* Helper function to get the rank of a coordinate variable: 1 for x and y
+ * (one value per column or row), 2 for lon and lat (one per [row, column]) */
+int geotiff_coords_ndims(geotiff_coord_t coord)
+{
+    return coord == GEOTIFF_COORD_X || coord == GEOTIFF_COORD_Y ? 1 : 2;
+}
+
+/* Helper function to compute the values of a coordinate variable over a
+ * block of it, row-major: count[0] values from start[0] of x or y, or
+ * count[0] rows of count[1] values from (start[0], start[1]) of lon or lat */
+void geotiff_coords_fill(const geotiff_transform_t *transform, geotiff_coord_t coord,
+                         const hsize_t *start, const hsize_t *count, double *values)
+{
+    const double *gt = transform->gt;
+    double row;
+    hsize_t r;
+
+    pthread_once(&geotiff_ramp_once_g, geotiff_ramp_init);
+
+    switch (coord) {
+        case GEOTIFF_COORD_X:
+            geotiff_ramp_g(values, (size_t) count[0], gt[0],
+                           (double) start[0] + transform->center, gt[1]);
+            break;
+        case GEOTIFF_COORD_Y:
+            geotiff_ramp_g(values, (size_t) count[0], gt[3],
+                           (double) start[0] + transform->center, gt[5]);
+            break;
+        case GEOTIFF_COORD_LON:
+        case GEOTIFF_COORD_LAT:
+        default:
+            /* Each row is a ramp along the columns from where the row starts */
+            for (r = 0; r < count[0]; r++) {
+                row = (double) (start[0] + r) + transform->center;
+                if (coord == GEOTIFF_COORD_LON)
+                    geotiff_ramp_g(values + r * count[1], (size_t) count[1], gt[0] + row * gt[2],
+                                   (double) start[1] + transform->center, gt[1]);
+                else
+                    geotiff_ramp_g(values + r * count[1], (size_t) count[1], gt[3] + row * gt[5],
+                                   (double) start[1] + transform->center, gt[4]);
+            }
+            break;
+    }
+}
+
+/* Helper function to compute the value of a coordinate variable at one
+ * element, exactly as geotiff_coords_fill() does */
+double geotiff_coords_value(const geotiff_transform_t *transform, geotiff_coord_t coord,
+                            const hsize_t *point)
+{
+    const double *gt = transform->gt;
+    double row, col;
+
+    switch (coord) {
+        case GEOTIFF_COORD_X:
+            return gt[0] + ((double) point[0] + transform->center) * gt[1];
+        case GEOTIFF_COORD_Y:
+            return gt[3] + ((double) point[0] + transform->center) * gt[5];
+        case GEOTIFF_COORD_LON:
+            row = (double) point[0] + transform->center;
+            col = (double) point[1] + transform->center;
+            return (gt[0] + row * gt[2]) + col * gt[1];
+        case GEOTIFF_COORD_LAT:
+        default:
+            row = (double) point[0] + transform->center;
+            col = (double) point[1] + transform->center;
+            return (gt[3] + row * gt[5]) + col * gt[4];
+    }
+}
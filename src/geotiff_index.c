@@ -0,0 +1,546 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Sidecar index of a file's headers: its directories, the raster
+ *              layout and tile or strip tables of each, and its GeoKeys and
+ *              georeferencing tags, written next to the file the first time
+ *              it is opened and mapped instead of parsing the TIFF afterwards
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Signature and version of the index format. The layout is native (byte
+ * order, type sizes), so an index only serves the kind of machine that wrote
+ * it; any change to it bumps the version. */
+#define GEOTIFF_INDEX_MAGIC      "GTIFVIDX"
+#define GEOTIFF_INDEX_VERSION    1
+#define GEOTIFF_INDEX_BYTE_ORDER 0x01020304U
+
+/* Sections of an index start on 8-byte boundaries */
+#define GEOTIFF_INDEX_ALIGN(n) (((n) + 7) & ~(uint64_t) 7)
+
+/* Header of an index, followed by a record per directory, the file offsets
+ * and then the stored sizes of every directory's chunks, the metadata
+ * catalog's entries and its pool */
+typedef struct geotiff_index_header_t {
+    char magic[8];               /* GEOTIFF_INDEX_MAGIC */
+    uint32_t version;            /* GEOTIFF_INDEX_VERSION */
+    uint32_t byte_order;         /* GEOTIFF_INDEX_BYTE_ORDER, as written */
+    uint32_t header_size;        /* Sizes of the structures written, as a check on the layout */
+    uint32_t record_size;
+    uint32_t entry_size;
+    uint32_t nifds;              /* Number of directories */
+    uint32_t nmain_ifds;         /* Number of directories in the main chain */
+    uint32_t same_pages;         /* Every page of the main chain has the same layout */
+    uint32_t width;              /* Size of the first image, for the coordinate variables */
+    uint32_t height;
+    uint32_t nentries;           /* Entries of the metadata catalog */
+    uint32_t reserved;
+    uint64_t pool_size;          /* Bytes of the catalog's pool */
+    uint64_t nchunks;            /* Chunks of every directory */
+    uint64_t file_size;          /* Size of the file indexed */
+    int64_t mtime_sec;           /* Modification time of the file indexed */
+    int64_t mtime_nsec;
+    uint64_t index_size;         /* Size of the whole index */
+} geotiff_index_header_t;
+
+/* One directory of the file */
+typedef struct geotiff_index_ifd_t {
+    uint64_t offset;       /* File offset of the directory */
+    uint64_t first_chunk;  /* Position of its chunks in the chunk tables */
+    uint64_t row_bytes;    /* geotiff_chunk_table_t.row_bytes */
+    uint32_t nchunks;      /* Number of its chunks */
+    uint32_t rows;         /* Rows of a full chunk */
+    uint32_t subfile_type; /* TIFFTAG_SUBFILETYPE flags */
+    uint32_t is_raster;    /* The connector can read the image */
+    geotiff_image_t image; /* Raster layout, if is_raster */
+} geotiff_index_ifd_t;
+
+/* An index mapped for an open file */
+struct geotiff_index_t {
+    void *map;                        /* Mapping of the index */
+    size_t size;                      /* Size of the mapping */
+    const geotiff_index_ifd_t *ifds;  /* Record of each directory */
+    uint32_t nifds;                   /* Number of directories */
+    const uint64_t *offsets;          /* File offset of every chunk */
+    const uint64_t *counts;           /* Stored size of every chunk */
+};
+
+/* Helper function to get the path of a file's index, which the caller frees */
+static char *geotiff_index_path(const char *filename)
+{
+    size_t len = strlen(filename);
+    char *path;
+
+    if (!(path = (char *) malloc(len + sizeof(GEOTIFF_INDEX_SUFFIX))))
+        return NULL;
+    memcpy(path, filename, len);
+    memcpy(path + len, GEOTIFF_INDEX_SUFFIX, sizeof(GEOTIFF_INDEX_SUFFIX));
+
+    return path;
+}
+
+#ifndef _WIN32
+/* Helper function to get the size and modification time an index of a file
+ * is checked against */
+static herr_t geotiff_index_stamp(const char *filename, uint64_t *size, int64_t *sec,
+                                  int64_t *nsec)
+{
+    struct stat st;
+
+    if (stat(filename, &st) < 0)
+        return -1;
+    *size = (uint64_t) st.st_size;
+    *sec = (int64_t) st.st_mtime;
+#ifdef __APPLE__
+    *nsec = (int64_t) st.st_mtimespec.tv_nsec;
+#else
+    *nsec = (int64_t) st.st_mtim.tv_nsec;
+#endif
+
+    return 0;
+}
+
+/* Helper function to get the offset of each section of an index from its
+ * header: the records, the two chunk tables, the entries and the pool.
+ * Returns the size of the whole index, or 0 if it would overflow. */
+static uint64_t geotiff_index_layout(const geotiff_index_header_t *header, uint64_t *sections)
+{
+    uint64_t n = header->nchunks;
+
+    if (n > (UINT64_MAX >> 5) || header->pool_size > (UINT64_MAX >> 2))
+        return 0;
+    sections[0] = GEOTIFF_INDEX_ALIGN(sizeof(geotiff_index_header_t));
+    sections[1] = sections[0] + GEOTIFF_INDEX_ALIGN((uint64_t) header->nifds *
+                                                    sizeof(geotiff_index_ifd_t));
+    sections[2] = sections[1] + n * sizeof(uint64_t);
+    sections[3] = sections[2] + n * sizeof(uint64_t);
+    sections[4] = sections[3] + GEOTIFF_INDEX_ALIGN((uint64_t) header->nentries *
+                                                    sizeof(geotiff_meta_entry_t));
+
+    return sections[4] + GEOTIFF_INDEX_ALIGN(header->pool_size);
+}
+
+/* Helper function to check that the raster layout of a record is one
+ * geotiff_get_image_info() could have produced and describes the record's
+ * chunks, so that nothing read from the index sizes a buffer wrongly */
+static int geotiff_index_image_ok(const geotiff_index_ifd_t *record)
+{
+    const geotiff_image_t *image = &record->image;
+    uint64_t nplanes, line_bytes, band_rows, nchunks;
+
+    if (image->width == 0 || image->height == 0 || image->samples_per_pixel == 0 ||
+        image->chunk_width == 0 || image->chunk_height == 0 || image->chunk_size == 0)
+        return 0;
+    if ((unsigned) image->is_tiled > 1 || (unsigned) image->is_separate > 1 ||
+        (unsigned) image->by_scanline > 1 || (image->is_separate && image->samples_per_pixel < 2))
+        return 0;
+    if (image->bits_per_sample != 8 * image->elem_size ||
+        (image->elem_size != 1 && image->elem_size != 2 && image->elem_size != 4 &&
+         image->elem_size != 8))
+        return 0;
+
+    /* A chunk holds whole rows of chunk_width pixels of one plane or all */
+    nplanes = image->is_separate ? image->samples_per_pixel : 1;
+    line_bytes = (uint64_t) image->chunk_width *
+                 (image->is_separate ? 1 : image->samples_per_pixel) * image->elem_size;
+    if (image->chunk_size % line_bytes != 0 ||
+        image->chunk_size / line_bytes != image->chunk_height)
+        return 0;
+    if (record->row_bytes != 0 && record->row_bytes != line_bytes)
+        return 0;
+
+    if (image->is_tiled) {
+        if (image->by_scanline || record->rows != image->chunk_height)
+            return 0;
+    } else {
+        /* Strips span the image; those too large to decode whole are read in
+         * bands of scanlines, as many as fit */
+        if (image->chunk_width != image->width || record->rows == 0 ||
+            record->rows > image->height)
+            return 0;
+        if (image->by_scanline !=
+            ((uint64_t) record->rows * line_bytes > GEOTIFF_MAX_CHUNK_BYTES))
+            return 0;
+        band_rows = GEOTIFF_MAX_CHUNK_BYTES / line_bytes ? GEOTIFF_MAX_CHUNK_BYTES / line_bytes : 1;
+        if (image->chunk_height != (image->by_scanline ? band_rows : record->rows))
+            return 0;
+    }
+
+    if (image->chunks_across !=
+            ((uint64_t) image->width + image->chunk_width - 1) / image->chunk_width ||
+        image->chunks_down !=
+            ((uint64_t) image->height + image->chunk_height - 1) / image->chunk_height ||
+        image->chunks_per_plane != (uint64_t) image->chunks_across * image->chunks_down)
+        return 0;
+
+    /* Scanline bands are not chunks of the file: its strips are */
+    nchunks = image->by_scanline ? ((uint64_t) image->height + record->rows - 1) / record->rows
+                                 : image->chunks_per_plane;
+
+    return nchunks * nplanes == record->nchunks;
+}
+
+/* Helper function to rebuild a file's metadata catalog from the entries and
+ * pool of its index, checking that every entry lies within the pool */
+static herr_t geotiff_index_load_meta(geotiff_meta_t *meta, const geotiff_meta_entry_t *entries,
+                                      uint32_t nentries, const char *pool, uint64_t pool_size)
+{
+    static const size_t value_sizes[] = {sizeof(uint16_t), sizeof(double), 1};
+    uint32_t i;
+
+    memset(meta, 0, sizeof(*meta));
+
+    for (i = 0; i < nentries; i++) {
+        const geotiff_meta_entry_t *entry = &entries[i];
+        size_t value_size;
+
+        if ((unsigned) entry->type > GEOTIFF_META_STRING || entry->name >= pool_size ||
+            !memchr(pool + entry->name, '\0', (size_t) (pool_size - entry->name)))
+            goto error;
+        value_size = value_sizes[entry->type];
+        if (entry->data > pool_size ||
+            (uint64_t) entry->count * value_size > pool_size - entry->data)
+            goto error;
+
+        /* A string's count includes its terminator, which the catalog adds */
+        if (entry->type == GEOTIFF_META_STRING) {
+            if (entry->count == 0 || pool[entry->data + entry->count - 1] != '\0')
+                goto error;
+            if (geotiff_meta_add(meta, pool + entry->name, entry->type, pool + entry->data,
+                                 entry->count - 1) < 0)
+                goto error;
+        } else if (geotiff_meta_add(meta, pool + entry->name, entry->type, pool + entry->data,
+                                    entry->count) < 0) {
+            goto error;
+        }
+    }
+
+    if (geotiff_meta_index(meta) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    geotiff_meta_free(meta);
+
+    return -1;
+}
+#endif /* _WIN32 */
+
+/* Helper function to read a file's headers from its index, if it has one
+ * that is up to date (of the same size and modification time as the file):
+ * its directories, its metadata catalog and coordinate variables, and the
+ * mapped index itself, which serves the raster layouts and chunk tables.
+ * Returns -1, leaving the file as it was, if there is no usable index. */
+herr_t geotiff_index_load(geotiff_file_t *file)
+{
+#ifndef _WIN32
+    const geotiff_index_header_t *header;
+    const geotiff_index_ifd_t *records;
+    geotiff_index_t *index = NULL;
+    geotiff_ifd_t *ifds = NULL;
+    uint64_t sections[5], file_size;
+    int64_t sec, nsec;
+    struct stat st;
+    char *path;
+    void *map = MAP_FAILED;
+    uint32_t i;
+    int fd;
+
+    if (geotiff_index_stamp(file->filename, &file_size, &sec, &nsec) < 0)
+        return -1;
+    if (!(path = geotiff_index_path(file->filename)))
+        return -1;
+    fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) == 0 && (uint64_t) st.st_size >= sizeof(geotiff_index_header_t) &&
+        (uint64_t) st.st_size <= SIZE_MAX)
+        map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    /* An index of another version, machine or file, or of the file as it
+     * was before it changed, is ignored (and rewritten) */
+    header = (const geotiff_index_header_t *) map;
+    if (memcmp(header->magic, GEOTIFF_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != GEOTIFF_INDEX_VERSION ||
+        header->byte_order != GEOTIFF_INDEX_BYTE_ORDER ||
+        header->header_size != sizeof(geotiff_index_header_t) ||
+        header->record_size != sizeof(geotiff_index_ifd_t) ||
+        header->entry_size != sizeof(geotiff_meta_entry_t))
+        goto error;
+    if (header->file_size != file_size || header->mtime_sec != sec || header->mtime_nsec != nsec)
+        goto error;
+    if (header->index_size != (uint64_t) st.st_size ||
+        geotiff_index_layout(header, sections) != header->index_size)
+        goto error;
+    if (header->nifds == 0 || header->nmain_ifds == 0 || header->nmain_ifds > header->nifds)
+        goto error;
+
+    records = (const geotiff_index_ifd_t *) ((const char *) map + sections[0]);
+    for (i = 0; i < header->nifds; i++) {
+        if (records[i].first_chunk > header->nchunks ||
+            records[i].nchunks > header->nchunks - records[i].first_chunk)
+            goto error;
+        if (records[i].is_raster && !geotiff_index_image_ok(&records[i]))
+            goto error;
+    }
+
+    if (!(index = (geotiff_index_t *) calloc(1, sizeof(geotiff_index_t))) ||
+        !(ifds = (geotiff_ifd_t *) malloc(header->nifds * sizeof(geotiff_ifd_t))))
+        goto error;
+    index->map = map;
+    index->size = (size_t) st.st_size;
+    index->ifds = records;
+    index->nifds = header->nifds;
+    index->offsets = (const uint64_t *) ((const char *) map + sections[1]);
+    index->counts = (const uint64_t *) ((const char *) map + sections[2]);
+
+    for (i = 0; i < header->nifds; i++) {
+        ifds[i].offset = records[i].offset;
+        ifds[i].subfile_type = records[i].subfile_type;
+        ifds[i].is_raster = records[i].is_raster != 0;
+    }
+
+    if (geotiff_index_load_meta(&file->meta,
+                                (const geotiff_meta_entry_t *) ((const char *) map + sections[3]),
+                                header->nentries, (const char *) map + sections[4],
+                                header->pool_size) < 0)
+        goto error;
+    if (geotiff_coords_init(file, header->width, header->height) < 0) {
+        geotiff_meta_free(&file->meta);
+        goto error;
+    }
+
+    file->ifds = ifds;
+    file->nifds = header->nifds;
+    file->nmain_ifds = header->nmain_ifds;
+    file->same_pages = header->same_pages != 0;
+    file->index = index;
+
+    return 0;
+
+error:
+    free(ifds);
+    free(index);
+    munmap(map, (size_t) st.st_size);
+
+    return -1;
+#else
+    (void) file;
+    return -1;
+#endif
+}
+
+/* Helper function to write the index of a file whose headers were just
+ * parsed, through its own handle, which is moved through every directory to
+ * read its chunk tables and left on the first one. The index is written to a
+ * temporary file and renamed into place, so readers never see half of one,
+ * and is dropped again if the file changed meanwhile. */
+herr_t geotiff_index_save(geotiff_file_t *file)
+{
+#ifndef _WIN32
+    geotiff_index_header_t header;
+    geotiff_index_ifd_t *records = NULL;
+    geotiff_chunk_table_t table;
+    uint64_t *offsets = NULL, *counts = NULL, sections[5], size, after_size;
+    uint64_t nchunks = 0, alloc = 0;
+    int64_t after_sec, after_nsec;
+    TIFF *tiff = file->tiff;
+    char *path = NULL, *tmp = NULL, *buf = NULL;
+    uint32_t i;
+    herr_t ret = -1;
+    int fd;
+
+    memset(&header, 0, sizeof(header));
+    if (!tiff || geotiff_index_stamp(file->filename, &header.file_size, &header.mtime_sec,
+                                     &header.mtime_nsec) < 0)
+        return -1;
+    /* The headers parsed may be older than the file now */
+    if (header.file_size != file->id.size || (uint64_t) header.mtime_sec != file->id.mtime ||
+        (uint64_t) header.mtime_nsec != file->id.mtime_nsec)
+        return -1;
+
+    if (!(records = (geotiff_index_ifd_t *) calloc(file->nifds, sizeof(geotiff_index_ifd_t))))
+        goto done;
+    for (i = 0; i < file->nifds; i++) {
+        geotiff_index_ifd_t *record = &records[i];
+
+        record->offset = file->ifds[i].offset;
+        record->subfile_type = file->ifds[i].subfile_type;
+        record->first_chunk = nchunks;
+        if (!file->ifds[i].is_raster)
+            continue;
+
+        if (!TIFFSetSubDirectory(tiff, record->offset) ||
+            geotiff_get_image_info(tiff, &record->image) < 0 ||
+            geotiff_get_chunk_table(tiff, &record->image, &table) < 0)
+            goto done;
+        record->is_raster = 1;
+        record->nchunks = table.nchunks;
+        record->rows = table.rows;
+        record->row_bytes = table.row_bytes;
+
+        /* Nor write what the next open would reject (e.g. subsampled YCbCr) */
+        if (!geotiff_index_image_ok(record))
+            goto done;
+
+        if (nchunks + table.nchunks > alloc) {
+            uint64_t *grown;
+
+            alloc = 2 * (nchunks + table.nchunks);
+            if (!(grown = (uint64_t *) realloc(offsets, alloc * sizeof(uint64_t))))
+                goto done;
+            offsets = grown;
+            if (!(grown = (uint64_t *) realloc(counts, alloc * sizeof(uint64_t))))
+                goto done;
+            counts = grown;
+        }
+        memcpy(offsets + nchunks, table.offsets, table.nchunks * sizeof(uint64_t));
+        memcpy(counts + nchunks, table.counts, table.nchunks * sizeof(uint64_t));
+        nchunks += table.nchunks;
+    }
+
+    memcpy(header.magic, GEOTIFF_INDEX_MAGIC, sizeof(header.magic));
+    header.version = GEOTIFF_INDEX_VERSION;
+    header.byte_order = GEOTIFF_INDEX_BYTE_ORDER;
+    header.header_size = sizeof(geotiff_index_header_t);
+    header.record_size = sizeof(geotiff_index_ifd_t);
+    header.entry_size = sizeof(geotiff_meta_entry_t);
+    header.nifds = file->nifds;
+    header.nmain_ifds = file->nmain_ifds;
+    header.same_pages = file->same_pages != 0;
+    header.width = file->coords.transform.width;
+    header.height = file->coords.transform.height;
+    header.nentries = file->meta.nentries;
+    header.pool_size = file->meta.pool_size;
+    header.nchunks = nchunks;
+    if (!(size = geotiff_index_layout(&header, sections)) || size > SIZE_MAX)
+        goto done;
+    header.index_size = size;
+
+    if (!(buf = (char *) calloc(1, (size_t) size)))
+        goto done;
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sections[0], records, file->nifds * sizeof(geotiff_index_ifd_t));
+    if (nchunks > 0) {
+        memcpy(buf + sections[1], offsets, (size_t) nchunks * sizeof(uint64_t));
+        memcpy(buf + sections[2], counts, (size_t) nchunks * sizeof(uint64_t));
+    }
+    if (file->meta.nentries > 0) {
+        memcpy(buf + sections[3], file->meta.entries,
+               file->meta.nentries * sizeof(geotiff_meta_entry_t));
+        memcpy(buf + sections[4], file->meta.pool, file->meta.pool_size);
+    }
+
+    if (!(path = geotiff_index_path(file->filename)) ||
+        !(tmp = (char *) malloc(strlen(path) + 32)))
+        goto done;
+    snprintf(tmp, strlen(path) + 32, "%s.%ld.tmp", path, (long) getpid());
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+        goto done;
+    if (write(fd, buf, (size_t) size) != (ssize_t) size) {
+        close(fd);
+        unlink(tmp);
+        goto done;
+    }
+    if (close(fd) < 0 || rename(tmp, path) < 0) {
+        unlink(tmp);
+        goto done;
+    }
+
+    /* A file rewritten while it was indexed may not match its index */
+    if (geotiff_index_stamp(file->filename, &after_size, &after_sec, &after_nsec) < 0 ||
+        after_size != header.file_size || after_sec != header.mtime_sec ||
+        after_nsec != header.mtime_nsec) {
+        unlink(path);
+        goto done;
+    }
+
+    ret = 0;
+
+done:
+    /* Leave the handle on the first directory, as TIFFOpen() did */
+    if (file->nifds > 0)
+        TIFFSetSubDirectory(tiff, file->ifds[0].offset);
+    free(tmp);
+    free(path);
+    free(buf);
+    free(counts);
+    free(offsets);
+    free(records);
+
+    return ret;
+#else
+    (void) file;
+    return -1;
+#endif
+}
+
+/* Helper function to unmap an index and free it */
+void geotiff_index_close(geotiff_index_t *index)
+{
+    if (!index)
+        return;
+
+#ifndef _WIN32
+    munmap(index->map, index->size);
+#endif
+    free(index);
+}
+
+/* Helper function to get the raster layout of a directory from an index, or
+ * NULL if the connector cannot read its image */
+const geotiff_image_t *geotiff_index_image(const geotiff_index_t *index, uint32_t ifd)
+{
+    if (ifd >= index->nifds || !index->ifds[ifd].is_raster)
+        return NULL;
+
+    return &index->ifds[ifd].image;
+}
+
+/* Helper function to get where the chunks of a directory are stored from an
+ * index. The tables are in the index's mapping, which lasts as long as the
+ * file is open. */
+herr_t geotiff_index_chunks(const geotiff_index_t *index, uint32_t ifd,
+                            geotiff_chunk_table_t *table)
+{
+    const geotiff_index_ifd_t *record;
+
+    if (ifd >= index->nifds || !index->ifds[ifd].is_raster)
+        return -1;
+
+    record = &index->ifds[ifd];
+    table->offsets = index->offsets + record->first_chunk;
+    table->counts = index->counts + record->first_chunk;
+    table->nchunks = record->nchunks;
+    table->rows = record->rows;
+    table->row_bytes = record->row_bytes;
+
+    return 0;
+}
@@ -0,0 +1,550 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Storage backends a file is read from (pread(), a mapping,
+ *              O_DIRECT or a buffer in memory), TIFF client I/O over them, and
+ *              merged byte ranges read once for several tiles or strips: while
+ *              a chunk is decoded, libtiff's reads of its bytes are served
+ *              from the range staged on its handle
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* Granularity of file offsets, sizes and buffer addresses with O_DIRECT */
+#define GEOTIFF_DIRECT_ALIGN 4096
+
+/* The storage of one open file, shared by all its TIFF handles. Every read
+ * names its offset, so handles on several threads can read at once. */
+struct geotiff_storage_t {
+    geotiff_io_t io;           /* Backend */
+    int fd;                    /* File, for the pread backends, or -1 */
+    const unsigned char *base; /* The file's bytes, for the mmap and memory backends */
+    uint64_t size;             /* File size */
+    size_t align;              /* Granularity of reads: GEOTIFF_DIRECT_ALIGN, or 1 */
+    size_t readahead;          /* Size small reads are rounded up to, or 0 */
+    pthread_mutex_t mutex;     /* Held while the file is mapped on request */
+    void *map;                 /* Mapping of the file made by the connector, if any */
+    geotiff_stats_t *stats;    /* Statistics the file's reads are counted in, or NULL */
+    unsigned refs;             /* The file, plus each open handle */
+};
+
+/* A merged byte range, read by the first task that needs it */
+struct geotiff_run_t {
+    pthread_mutex_t mutex; /* Held while the range is read */
+    uint64_t offset;       /* File offset of the range */
+    size_t size;           /* Size of the range in bytes */
+    void *block;           /* Buffer read into, aligned for the storage */
+    unsigned char *data;   /* The range, once read */
+    int state;             /* 0 until read, 1 once read, -1 if the read failed */
+    unsigned refs;         /* Chunks still to be decoded from the range */
+};
+
+/* Client I/O state of one TIFF handle */
+typedef struct geotiff_client_t {
+    geotiff_storage_t *storage; /* Storage of the file */
+    uint64_t pos;               /* Offset of the next read */
+    const geotiff_run_t *stage; /* Range the chunk being decoded lies in, if any */
+    unsigned char *ahead;       /* Readahead buffer of storage->readahead bytes, once used */
+    uint64_t ahead_offset;      /* File offset of the readahead buffer */
+    size_t ahead_size;          /* Bytes read into the readahead buffer */
+} geotiff_client_t;
+
+static const char *const geotiff_io_names_g[GEOTIFF_NIO] = {"pread", "mmap", "direct", "memory"};
+
+/* Helper function to get the name of a storage backend in the connector info
+ * string */
+const char *geotiff_io_name(geotiff_io_t io)
+{
+    return (unsigned) io < GEOTIFF_NIO ? geotiff_io_names_g[io] : "unknown";
+}
+
+#ifndef _WIN32
+/* Helper function to read up to n bytes at offset, stopping short once at
+ * least need bytes are in (the end of the file may come first) */
+static tmsize_t geotiff_pread(int fd, void *buf, size_t n, size_t need, uint64_t offset)
+{
+    size_t done = 0;
+
+    while (done < need) {
+        ssize_t nread = pread(fd, (char *) buf + done, n - done, (off_t) (offset + done));
+
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0)
+            return -1;
+        if (nread == 0)
+            break;
+        done += (size_t) nread;
+    }
+
+    return (tmsize_t) done;
+}
+
+/* Helper function to read n bytes at offset, short only at the end of the
+ * file. Reads that O_DIRECT cannot serve as they stand go through an aligned
+ * bounce buffer. */
+static tmsize_t geotiff_storage_read(const geotiff_storage_t *storage, void *buf, size_t n,
+                                     uint64_t offset)
+{
+    size_t align = storage->align, skip, span;
+    void *bounce;
+    tmsize_t nread;
+
+    if (offset >= storage->size)
+        return 0;
+    if (align == 1 || (offset % align == 0 && n % align == 0 && (uintptr_t) buf % align == 0)) {
+        size_t avail = (size_t) (storage->size - offset < n ? storage->size - offset : n);
+
+        if (!storage->base) {
+            if ((nread = geotiff_pread(storage->fd, buf, n, avail, offset)) > 0)
+                geotiff_count(storage->stats, GEOTIFF_COUNTER_BYTES_READ, (uint64_t) nread);
+            return nread;
+        }
+        memcpy(buf, storage->base + offset, avail);
+        return (tmsize_t) avail;
+    }
+    if (n > storage->size - offset)
+        n = (size_t) (storage->size - offset);
+
+    skip = (size_t) (offset % align);
+    span = (skip + n + align - 1) / align * align;
+    if (posix_memalign(&bounce, align, span) != 0)
+        return -1;
+    if ((nread = geotiff_pread(storage->fd, bounce, span, skip + n, offset - skip)) >= 0) {
+        geotiff_count(storage->stats, GEOTIFF_COUNTER_BYTES_READ, (uint64_t) nread);
+        nread = nread > (tmsize_t) skip ? nread - (tmsize_t) skip : 0;
+        if (nread > (tmsize_t) n)
+            nread = (tmsize_t) n;
+        memcpy(buf, (unsigned char *) bounce + skip, (size_t) nread);
+    }
+    free(bounce);
+
+    return nread;
+}
+
+/* Helper function to serve a read smaller than the readahead size from the
+ * handle's readahead buffer, refilling it (from an aligned offset, for
+ * O_DIRECT) when the read is not all in it. Returns 0 when the read should
+ * go to the file as it is. */
+static tmsize_t geotiff_client_read_ahead(geotiff_client_t *client, void *buf, size_t n)
+{
+    const geotiff_storage_t *storage = client->storage;
+    uint64_t pos = client->pos, start;
+    tmsize_t nread;
+
+    if (pos < client->ahead_offset || pos + n > client->ahead_offset + client->ahead_size) {
+        start = pos - pos % storage->align;
+        if (pos + n > start + storage->readahead)
+            return 0;
+        if (!client->ahead &&
+            posix_memalign((void **) &client->ahead,
+                           storage->align > sizeof(void *) ? storage->align : sizeof(void *),
+                           storage->readahead) != 0) {
+            client->ahead = NULL;
+            return 0;
+        }
+        client->ahead_size = 0;
+        if ((nread = geotiff_storage_read(storage, client->ahead, storage->readahead, start)) < 0)
+            return -1;
+        client->ahead_offset = start;
+        client->ahead_size = (size_t) nread;
+        if (pos >= start + client->ahead_size)
+            return 0;
+        if (pos + n > start + client->ahead_size)
+            n = (size_t) (start + client->ahead_size - pos);
+    }
+    memcpy(buf, client->ahead + (pos - client->ahead_offset), n);
+
+    return (tmsize_t) n;
+}
+
+static tmsize_t geotiff_client_read(thandle_t handle, void *buf, tmsize_t n)
+{
+    geotiff_client_t *client = (geotiff_client_t *) handle;
+    const geotiff_storage_t *storage = client->storage;
+    const geotiff_run_t *stage = client->stage;
+    tmsize_t nread = 0;
+
+    if (n <= 0)
+        return 0;
+
+    if (stage && client->pos >= stage->offset &&
+        client->pos + (uint64_t) n <= stage->offset + stage->size) {
+        memcpy(buf, stage->data + (client->pos - stage->offset), (size_t) n);
+        nread = n;
+    } else if (storage->readahead > (size_t) n && !storage->base &&
+               (nread = geotiff_client_read_ahead(client, buf, (size_t) n)) < 0) {
+        return -1;
+    }
+    if (nread == 0 && (nread = geotiff_storage_read(storage, buf, (size_t) n, client->pos)) < 0)
+        return -1;
+    client->pos += (uint64_t) nread;
+
+    return nread;
+}
+
+static tmsize_t geotiff_client_write(thandle_t __attribute__((unused)) handle,
+                                     void __attribute__((unused)) * buf,
+                                     tmsize_t __attribute__((unused)) n)
+{
+    /* Files are only ever opened for reading */
+    return -1;
+}
+
+static toff_t geotiff_client_seek(thandle_t handle, toff_t offset, int whence)
+{
+    geotiff_client_t *client = (geotiff_client_t *) handle;
+
+    switch (whence) {
+        case SEEK_SET:
+            client->pos = offset;
+            break;
+        case SEEK_CUR:
+            client->pos += offset;
+            break;
+        case SEEK_END:
+            client->pos = client->storage->size + offset;
+            break;
+        default:
+            return (toff_t) -1;
+    }
+
+    return client->pos;
+}
+
+static int geotiff_client_close(thandle_t handle)
+{
+    geotiff_client_t *client = (geotiff_client_t *) handle;
+
+    geotiff_storage_release(client->storage);
+    free(client->ahead);
+    free(client);
+
+    return 0;
+}
+
+static toff_t geotiff_client_size(thandle_t handle)
+{
+    return ((geotiff_client_t *) handle)->storage->size;
+}
+
+/* libtiff reads straight out of a mapped file, bypassing the read procedure,
+ * so only files already in memory are handed to it that way */
+static int geotiff_client_map(thandle_t handle, void **base, toff_t *size)
+{
+    const geotiff_storage_t *storage = ((geotiff_client_t *) handle)->storage;
+
+    if (!storage->base)
+        return 0;
+    *base = (void *) storage->base;
+    *size = storage->size;
+
+    return 1;
+}
+
+static void geotiff_client_unmap(thandle_t __attribute__((unused)) handle,
+                                 void __attribute__((unused)) * base,
+                                 toff_t __attribute__((unused)) size)
+{
+}
+#endif /* _WIN32 */
+
+/* Helper function to open the storage of a file with the backend and
+ * readahead size of the connector info. The memory backend reads the info's
+ * buffer instead of the file, and the others fall back to plain pread() where
+ * the file cannot be mapped or the file system does not do O_DIRECT. Bytes
+ * read from the file are counted in stats. The caller holds the one
+ * reference. */
+geotiff_storage_t *geotiff_storage_open(const char *filename, const geotiff_info_t *info,
+                                        geotiff_stats_t *stats)
+{
+    geotiff_storage_t *storage;
+    geotiff_io_t io = info->io;
+
+    if ((unsigned) io >= GEOTIFF_NIO || (io == GEOTIFF_IO_MEMORY && !info->buffer))
+        return NULL;
+    if (!(storage = (geotiff_storage_t *) calloc(1, sizeof(geotiff_storage_t))))
+        return NULL;
+    pthread_mutex_init(&storage->mutex, NULL);
+    storage->io = io;
+    storage->fd = -1;
+    storage->align = 1;
+    storage->stats = stats;
+    storage->refs = 1;
+
+    if (io == GEOTIFF_IO_MEMORY) {
+        storage->base = (const unsigned char *) info->buffer;
+        storage->size = info->buffer_size;
+        return storage;
+    }
+
+#ifndef _WIN32
+    {
+        struct stat st;
+
+#ifdef O_DIRECT
+        if (io == GEOTIFF_IO_DIRECT && (storage->fd = open(filename, O_RDONLY | O_DIRECT)) >= 0)
+            storage->align = GEOTIFF_DIRECT_ALIGN;
+#endif
+        if (storage->fd < 0 && (storage->fd = open(filename, O_RDONLY)) < 0)
+            goto error;
+        /* Readahead is in whole aligned blocks, which O_DIRECT reads straight
+         * into the buffer */
+        if (info->readahead_kb > 0 && info->readahead_kb <= SIZE_MAX / 1024)
+            storage->readahead = (info->readahead_kb * 1024 + storage->align - 1) /
+                                 storage->align * storage->align;
+        if (fstat(storage->fd, &st) < 0)
+            goto error;
+        storage->size = (uint64_t) st.st_size;
+
+        if (io == GEOTIFF_IO_MMAP && storage->size > 0 && storage->size <= SIZE_MAX) {
+            void *map = mmap(NULL, (size_t) storage->size, PROT_READ, MAP_SHARED, storage->fd, 0);
+
+            if (map != MAP_FAILED) {
+                storage->map = map;
+                storage->base = (const unsigned char *) map;
+            }
+        }
+    }
+#else
+    (void) filename;
+#endif
+
+    return storage;
+
+#ifndef _WIN32
+error:
+    geotiff_storage_release(storage);
+    return NULL;
+#endif
+}
+
+/* Helper function to drop a reference to a file's storage, closing it with
+ * the last one */
+void geotiff_storage_release(geotiff_storage_t *storage)
+{
+    if (!storage || __atomic_sub_fetch(&storage->refs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+#ifndef _WIN32
+    if (storage->map)
+        munmap(storage->map, (size_t) storage->size);
+    if (storage->fd >= 0)
+        close(storage->fd);
+#endif
+    pthread_mutex_destroy(&storage->mutex);
+    free(storage);
+}
+
+/* Helper function to get the whole file as bytes in memory, mapping a pread()
+ * file on first use. Returns NULL where the file cannot be mapped, and always
+ * with O_DIRECT, whose point is to stay out of the page cache. */
+const unsigned char *geotiff_storage_map(geotiff_storage_t *storage, size_t *size)
+{
+    const unsigned char *data = storage->base;
+
+#ifndef _WIN32
+    if (!data && storage->io == GEOTIFF_IO_PREAD) {
+        pthread_mutex_lock(&storage->mutex);
+        if (!storage->map && storage->size > 0 && storage->size <= SIZE_MAX) {
+            void *map = mmap(NULL, (size_t) storage->size, PROT_READ, MAP_SHARED, storage->fd, 0);
+
+            if (map != MAP_FAILED)
+                storage->map = map;
+        }
+        data = (const unsigned char *) storage->map;
+        pthread_mutex_unlock(&storage->mutex);
+    }
+#endif
+    if (data && size)
+        *size = (size_t) storage->size;
+
+    return data;
+}
+
+/* Helper function to check whether the file's bytes are all in memory, in
+ * which case merging reads gains nothing */
+int geotiff_storage_resident(const geotiff_storage_t *storage)
+{
+    return storage->base != NULL;
+}
+
+/* Helper function to check, from its first four bytes alone, that a file is
+ * a classic TIFF or a BigTIFF, so that a lazy open can turn other files away
+ * without parsing any directory */
+int geotiff_storage_is_tiff(const geotiff_storage_t *storage)
+{
+    unsigned char magic[4];
+    unsigned version;
+
+#ifndef _WIN32
+    if (geotiff_storage_read(storage, magic, sizeof(magic), 0) != (tmsize_t) sizeof(magic))
+        return 0;
+#else
+    /* Without our own I/O, leave the check to libtiff */
+    if (!storage->base)
+        return 1;
+    if (storage->size < sizeof(magic))
+        return 0;
+    memcpy(magic, storage->base, sizeof(magic));
+#endif
+
+    if (magic[0] == 'I' && magic[1] == 'I')
+        version = (unsigned) magic[2] | (unsigned) magic[3] << 8;
+    else if (magic[0] == 'M' && magic[1] == 'M')
+        version = (unsigned) magic[2] << 8 | (unsigned) magic[3];
+    else
+        return 0;
+
+    return version == TIFF_VERSION_CLASSIC || version == TIFF_VERSION_BIG;
+}
+
+/* Helper function to open a TIFF handle on a file's storage, which the handle
+ * holds a reference to until it is closed */
+TIFF *geotiff_tiff_open(const char *filename, geotiff_storage_t *storage)
+{
+#ifndef _WIN32
+    geotiff_client_t *client;
+    TIFF *tiff;
+
+    if (!(client = (geotiff_client_t *) calloc(1, sizeof(geotiff_client_t))))
+        return NULL;
+    client->storage = storage;
+    __atomic_add_fetch(&storage->refs, 1, __ATOMIC_ACQ_REL);
+
+    /* Files in memory are handed to libtiff as mapped ("m" turns that off).
+     * libtiff leaves closing the file to us when the open fails. */
+    if (!(tiff = TIFFClientOpen(filename, storage->base ? "r" : "rm", (thandle_t) client,
+                                geotiff_client_read, geotiff_client_write, geotiff_client_seek,
+                                geotiff_client_close, geotiff_client_size, geotiff_client_map,
+                                geotiff_client_unmap)))
+        geotiff_client_close((thandle_t) client);
+
+    return tiff;
+#else
+    return storage->io == GEOTIFF_IO_MEMORY ? NULL : TIFFOpen(filename, "r");
+#endif
+}
+
+/* Helper function to serve a handle's reads that fall in a run from the run,
+ * until it is unstaged with a NULL run */
+void geotiff_tiff_stage(TIFF *tiff, const geotiff_run_t *run)
+{
+#ifndef _WIN32
+    ((geotiff_client_t *) TIFFClientdata(tiff))->stage = run && run->state > 0 ? run : NULL;
+#else
+    (void) tiff;
+    (void) run;
+#endif
+}
+
+/* Helper function to tell the kernel a range of the file will be read soon,
+ * so it can be fetched while earlier chunks are decoded */
+void geotiff_storage_willneed(const geotiff_storage_t *storage, uint64_t offset, uint64_t size)
+{
+#ifndef _WIN32
+    if (storage->io == GEOTIFF_IO_PREAD) {
+#ifdef POSIX_FADV_WILLNEED
+        posix_fadvise(storage->fd, (off_t) offset, (off_t) size, POSIX_FADV_WILLNEED);
+#endif
+    } else if (storage->map && offset < storage->size) {
+        long page = sysconf(_SC_PAGESIZE);
+        uint64_t skip = page > 0 ? offset % (uint64_t) page : 0;
+
+        if (size > storage->size - offset)
+            size = storage->size - offset;
+        madvise((unsigned char *) storage->map + (offset - skip), (size_t) (size + skip),
+                MADV_WILLNEED);
+    }
+#else
+    (void) storage;
+    (void) offset;
+    (void) size;
+#endif
+}
+
+/* Helper function to create a run of size bytes at offset, shared by refs
+ * chunks */
+geotiff_run_t *geotiff_run_create(uint64_t offset, size_t size, unsigned refs)
+{
+    geotiff_run_t *run;
+
+    if (!(run = (geotiff_run_t *) calloc(1, sizeof(geotiff_run_t))))
+        return NULL;
+    pthread_mutex_init(&run->mutex, NULL);
+    run->offset = offset;
+    run->size = size;
+    run->refs = refs;
+
+    return run;
+}
+
+/* Helper function to read a run through a handle on its file, unless another
+ * task has already. Returns 0 once the run is in memory. */
+herr_t geotiff_run_load(geotiff_run_t *run, TIFF *tiff)
+{
+    herr_t ret;
+
+    pthread_mutex_lock(&run->mutex);
+    if (run->state == 0) {
+        run->state = -1;
+#ifndef _WIN32
+        {
+            const geotiff_storage_t *storage =
+                ((geotiff_client_t *) TIFFClientdata(tiff))->storage;
+            size_t align = storage->align, skip = (size_t) (run->offset % align);
+            size_t span = (skip + run->size + align - 1) / align * align;
+
+            /* Read whole aligned blocks, so O_DIRECT needs no bounce buffer */
+            if (posix_memalign(&run->block, align > sizeof(void *) ? align : sizeof(void *),
+                               span) == 0 &&
+                geotiff_storage_read(storage, run->block, span, run->offset - skip) >=
+                    (tmsize_t) (skip + run->size)) {
+                run->data = (unsigned char *) run->block + skip;
+                run->state = 1;
+                geotiff_count(storage->stats, GEOTIFF_COUNTER_RANGES_READ, 1);
+            }
+        }
+#else
+        (void) tiff;
+#endif
+    }
+    ret = run->state > 0 ? 0 : -1;
+    pthread_mutex_unlock(&run->mutex);
+
+    return ret;
+}
+
+/* Helper function to drop one chunk's reference to a run, freeing it with the
+ * last one */
+void geotiff_run_release(geotiff_run_t *run)
+{
+    if (!run || __atomic_sub_fetch(&run->refs, 1, __ATOMIC_ACQ_REL) > 0)
+        return;
+
+    pthread_mutex_destroy(&run->mutex);
+    free(run->block);
+    free(run);
+}
@@ -0,0 +1,231 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     The namespace of a file: the datasets of its root group, listed
+ *              once when it is opened so that tools can discover them
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Helper function to append a link to the namespace being built */
+static herr_t geotiff_links_add(geotiff_file_t *file, uint32_t *alloc, const char *name,
+                                int is_raster)
+{
+    geotiff_link_t *link;
+
+    if (file->nlinks == *alloc) {
+        uint32_t new_alloc = *alloc ? 2 * *alloc : 8;
+        geotiff_link_t *links;
+
+        if (!(links = (geotiff_link_t *) realloc(file->links, new_alloc * sizeof(geotiff_link_t))))
+            return -1;
+        file->links = links;
+        *alloc = new_alloc;
+    }
+
+    link = &file->links[file->nlinks++];
+    snprintf(link->name, sizeof(link->name), "%s", name);
+    link->is_raster = is_raster;
+
+    return 0;
+}
+
+static int geotiff_links_cmp(const void *a, const void *b)
+{
+    return strcmp(((const geotiff_link_t *) a)->name, ((const geotiff_link_t *) b)->name);
+}
+
+/* Helper function to list the datasets of a file from its directories and
+ * coordinate variables: "image", its "overview_N" levels, "mask" and the
+ * "overview_N_mask" levels, "pages" if the pages stack, and "x" and "y" or
+ * "lon" and "lat". Directories the connector cannot read (e.g. the 1-bit
+ * masks GDAL writes) are left out, as are the "<name>_bsq" views, which open
+ * but are not listed. */
+herr_t geotiff_links_init(geotiff_file_t *file)
+{
+    char name[GEOTIFF_LINK_NAME_LEN];
+    uint32_t alloc = 0, level = 0, mask_level = 0, npages = 0, i;
+    int have_mask = 0, c;
+
+    file->links = NULL;
+    file->nlinks = 0;
+
+    for (i = 0; i < file->nifds; i++) {
+        const geotiff_ifd_t *ifd = &file->ifds[i];
+        uint32_t type = ifd->subfile_type & (FILETYPE_REDUCEDIMAGE | FILETYPE_MASK);
+
+        /* Count every level, readable or not, as geotiff_find_pages() does */
+        name[0] = '\0';
+        if (i == 0) {
+            snprintf(name, sizeof(name), "image");
+        } else if (type == FILETYPE_REDUCEDIMAGE) {
+            snprintf(name, sizeof(name), "overview_%u", (unsigned) ++level);
+        } else if (type == (FILETYPE_REDUCEDIMAGE | FILETYPE_MASK)) {
+            snprintf(name, sizeof(name), "overview_%u_mask", (unsigned) ++mask_level);
+        } else if (type == FILETYPE_MASK && !have_mask) {
+            have_mask = 1;
+            snprintf(name, sizeof(name), "mask");
+        }
+        if (i < file->nmain_ifds && type == 0)
+            npages++;
+
+        if (name[0] && ifd->is_raster && geotiff_links_add(file, &alloc, name, 1) < 0)
+            goto error;
+    }
+
+    if (npages > 1 && file->same_pages && geotiff_links_add(file, &alloc, "pages", 1) < 0)
+        goto error;
+
+    for (c = 0; c < GEOTIFF_NCOORDS; c++)
+        if ((file->coords.mask & (1u << c)) &&
+            geotiff_links_add(file, &alloc, geotiff_coords_name((geotiff_coord_t) c), 0) < 0)
+            goto error;
+
+    if (file->nlinks > 1)
+        qsort(file->links, file->nlinks, sizeof(geotiff_link_t), geotiff_links_cmp);
+
+    return 0;
+
+error:
+    geotiff_links_free(file);
+
+    return -1;
+}
+
+void geotiff_links_free(geotiff_file_t *file)
+{
+    free(file->links);
+    file->links = NULL;
+    file->nlinks = 0;
+}
+
+/* Helper function to find a link by name. Returns -1 if there is none. */
+static int64_t geotiff_links_find(const geotiff_file_t *file, const char *name, size_t len)
+{
+    uint32_t lo = 0, hi = file->nlinks;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        int cmp = strncmp(file->links[mid].name, name, len);
+
+        if (cmp == 0 && file->links[mid].name[len] != '\0')
+            cmp = 1;
+        if (cmp == 0)
+            return (int64_t) mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return -1;
+}
+
+/* Helper function to find the object a path names from the root group: "/"
+ * (or "" or ".") for the root group itself, "image" or "/image" for a
+ * dataset, "image_bsq" for its band-sequential view. Returns -1 if there is
+ * no such object. */
+herr_t geotiff_links_lookup(const geotiff_file_t *file, const char *path, uint64_t *id)
+{
+    size_t len;
+    int64_t i;
+
+    if (!path)
+        return -1;
+
+    for (;;) {
+        if (*path == '/')
+            path++;
+        else if (path[0] == '.' && (path[1] == '/' || path[1] == '\0'))
+            path++;
+        else
+            break;
+    }
+    if (*path == '\0') {
+        *id = GEOTIFF_ROOT_ID;
+        return 0;
+    }
+    if (strchr(path, '/'))
+        return -1;
+
+    len = strlen(path);
+    if ((i = geotiff_links_find(file, path, len)) >= 0) {
+        *id = GEOTIFF_LINK_ID(i);
+        return 0;
+    }
+    if (len > 4 && strcmp(path + len - 4, "_bsq") == 0 &&
+        (i = geotiff_links_find(file, path, len - 4)) >= 0 && file->links[i].is_raster) {
+        *id = GEOTIFF_VIEW_ID(i);
+        return 0;
+    }
+
+    return -1;
+}
+
+/* Helper function to find the nth link of the root group. Links are only
+ * indexed by name, as in a native group that does not track creation order. */
+herr_t geotiff_links_get(const geotiff_file_t *file, H5_index_t idx_type, H5_iter_order_t order,
+                         hsize_t n, uint64_t *id)
+{
+    if (idx_type != H5_INDEX_NAME || n >= file->nlinks)
+        return -1;
+
+    if (order == H5_ITER_DEC)
+        n = file->nlinks - 1 - n;
+    *id = GEOTIFF_LINK_ID(n);
+
+    return 0;
+}
+
+/* Helper function to write the absolute path of an object into buf, e.g.
+ * "/overview_1", truncated to size bytes like snprintf(). Returns the length
+ * of the whole path. */
+size_t geotiff_links_path(const geotiff_file_t *file, uint64_t id, char *buf, size_t size)
+{
+    const char *name = "";
+    int len;
+
+    if (id != GEOTIFF_ROOT_ID && GEOTIFF_ID_LINK(id) < file->nlinks)
+        name = file->links[GEOTIFF_ID_LINK(id)].name;
+
+    len = snprintf(buf, size, "/%s%s", name, (id & 1) ? "_bsq" : "");
+
+    return len < 0 ? 0 : (size_t) len;
+}
+
+/* Helper function to encode an object as its token */
+void geotiff_links_token(uint64_t id, H5O_token_t *token)
+{
+    memset(token, 0, sizeof(H5O_token_t));
+    memcpy(token, &id, sizeof(id));
+}
+
+/* Helper function to decode a token into an object of the file, checking
+ * that there is such an object */
+herr_t geotiff_links_token_id(const geotiff_file_t *file, const H5O_token_t *token, uint64_t *id)
+{
+    memcpy(id, token, sizeof(*id));
+
+    if (*id == GEOTIFF_ROOT_ID)
+        return 0;
+    if (GEOTIFF_ID_LINK(*id) >= file->nlinks)
+        return -1;
+    if ((*id & 1) && !file->links[GEOTIFF_ID_LINK(*id)].is_raster)
+        return -1;
+
+    return 0;
+}
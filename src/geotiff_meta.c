@@ -0,0 +1,412 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Catalog of a file's GeoKeys and georeferencing tags, parsed
+ *              once when the file is opened and served as attributes
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* TIFF tags of the GeoTIFF and GDAL georeferencing metadata */
+#define GEOTIFF_TAG_PIXEL_SCALE    33550
+#define GEOTIFF_TAG_TIEPOINT       33922
+#define GEOTIFF_TAG_TRANSFORMATION 34264
+#define GEOTIFF_TAG_KEY_DIRECTORY  34735
+#define GEOTIFF_TAG_GDAL_METADATA  42112
+#define GEOTIFF_TAG_GDAL_NODATA    42113
+
+/* Number of elements of a static array */
+#define GEOTIFF_META_NELMTS(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Georeferencing tags served besides the GeoKeys */
+static const struct {
+    uint32_t tag;      /* TIFF tag */
+    TIFFDataType type; /* Type of its values */
+    const char *name;  /* Attribute name */
+} geotiff_meta_tags_g[] = {
+    {GEOTIFF_TAG_PIXEL_SCALE, TIFF_DOUBLE, "ModelPixelScaleTag"},
+    {GEOTIFF_TAG_TIEPOINT, TIFF_DOUBLE, "ModelTiepointTag"},
+    {GEOTIFF_TAG_TRANSFORMATION, TIFF_DOUBLE, "ModelTransformationTag"},
+    {GEOTIFF_TAG_GDAL_METADATA, TIFF_ASCII, "GDAL_METADATA"},
+    {GEOTIFF_TAG_GDAL_NODATA, TIFF_ASCII, "GDAL_NODATA"},
+};
+
+/* GeoKeys the GeoTIFF specification defines, looked for when the key
+ * directory itself cannot be read */
+static const struct {
+    geokey_t first, last;
+} geotiff_meta_key_ranges_g[] = {
+    {1024, 1026}, /* GeoTIFF configuration keys */
+    {2048, 2062}, /* Geographic CS parameter keys */
+    {3072, 3096}, /* Projected CS parameter keys */
+    {4096, 4099}, /* Vertical CS parameter keys */
+    {5120, 5120}, /* Coordinate epoch (GeoTIFF 1.1) */
+};
+
+/* Helper function to hash an entry name */
+static uint32_t geotiff_meta_hash(const char *name)
+{
+    uint32_t h = 2166136261U;
+
+    while (*name) {
+        h ^= (unsigned char) *name++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+/* Helper function to get the size of one value of a type */
+static size_t geotiff_meta_value_size(geotiff_meta_type_t type)
+{
+    switch (type) {
+        case GEOTIFF_META_SHORT:
+            return sizeof(uint16_t);
+        case GEOTIFF_META_DOUBLE:
+            return sizeof(double);
+        case GEOTIFF_META_STRING:
+        default:
+            return 1;
+    }
+}
+
+/* Helper function to append bytes to the pool, aligned for doubles. Returns
+ * the offset they were stored at, or -1 when out of memory. */
+static int64_t geotiff_meta_append(geotiff_meta_t *meta, const void *data, size_t size,
+                                   int terminate)
+{
+    size_t offset = (meta->pool_size + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    size_t end = offset + size + (terminate ? 1 : 0);
+
+    if (end > UINT32_MAX)
+        return -1;
+    if (end > meta->pool_cap) {
+        size_t cap = meta->pool_cap ? meta->pool_cap : 1024;
+        char *pool;
+
+        while (cap < end)
+            cap *= 2;
+        if (!(pool = (char *) realloc(meta->pool, cap)))
+            return -1;
+        meta->pool = pool;
+        meta->pool_cap = cap;
+    }
+
+    memcpy(meta->pool + offset, data, size);
+    if (terminate)
+        meta->pool[offset + size] = '\0';
+    meta->pool_size = end;
+
+    return (int64_t) offset;
+}
+
+/* Helper function to add an entry of count values to a catalog being built;
+ * a string's count is its length */
+herr_t geotiff_meta_add(geotiff_meta_t *meta, const char *name, geotiff_meta_type_t type,
+                        const void *data, size_t count)
+{
+    geotiff_meta_entry_t *entry;
+    int is_string = type == GEOTIFF_META_STRING;
+    int64_t name_offset, data_offset;
+
+    if (meta->nentries == meta->entries_cap) {
+        uint32_t cap = meta->entries_cap ? meta->entries_cap * 2 : 32;
+        geotiff_meta_entry_t *entries;
+
+        if (!(entries = (geotiff_meta_entry_t *) realloc(meta->entries, cap * sizeof(*entries))))
+            return -1;
+        meta->entries = entries;
+        meta->entries_cap = cap;
+    }
+
+    if ((name_offset = geotiff_meta_append(meta, name, strlen(name), 1)) < 0 ||
+        (data_offset = geotiff_meta_append(meta, data, count * geotiff_meta_value_size(type),
+                                           is_string)) < 0)
+        return -1;
+
+    entry = &meta->entries[meta->nentries++];
+    entry->name = (uint32_t) name_offset;
+    entry->data = (uint32_t) data_offset;
+    entry->count = (uint32_t) count + (is_string ? 1 : 0);
+    entry->type = type;
+
+    return 0;
+}
+
+/* Helper function to get the values of a tag of the current directory,
+ * whether libtiff knows the tag or made it up while reading the directory.
+ * The values belong to libtiff. */
+static const void *geotiff_meta_get_tag(TIFF *tiff, uint32_t tag, TIFFDataType type,
+                                        uint32_t *count)
+{
+    const TIFFField *field = TIFFFindField(tiff, tag, TIFF_ANY);
+    void *data = NULL;
+
+    *count = 0;
+    if (!field || TIFFFieldDataType(field) != type)
+        return NULL;
+
+    if (!TIFFFieldPassCount(field)) {
+        /* Only strings come without a count */
+        if (type != TIFF_ASCII || !TIFFGetField(tiff, tag, &data) || !data)
+            return NULL;
+        *count = (uint32_t) strlen((const char *) data) + 1;
+    } else if (TIFFFieldReadCount(field) == TIFF_VARIABLE2) {
+        uint32_t n = 0;
+
+        if (!TIFFGetField(tiff, tag, &n, &data))
+            return NULL;
+        *count = n;
+    } else {
+        uint16_t n = 0;
+
+        if (!TIFFGetField(tiff, tag, &n, &data))
+            return NULL;
+        *count = n;
+    }
+
+    return *count > 0 ? data : NULL;
+}
+
+/* Helper function to add a GeoKey to the catalog, if the file has it */
+static herr_t geotiff_meta_add_key(geotiff_meta_t *meta, GTIF *gtif, geokey_t key)
+{
+    tagtype_t type;
+    void *values;
+    size_t len;
+    int size, count;
+    herr_t ret = 0;
+
+    if ((count = GTIFKeyInfo(gtif, key, &size, &type)) <= 0)
+        return 0;
+
+    /* One more byte for a string's terminator */
+    if (!(values = calloc((size_t) count + 1, type == TYPE_DOUBLE ? sizeof(double) : 2)))
+        return -1;
+
+    switch (type) {
+        case TYPE_SHORT:
+            if (GTIFKeyGet(gtif, key, values, 0, count) == count)
+                ret = geotiff_meta_add(meta, GTIFKeyName(key), GEOTIFF_META_SHORT, values,
+                                       (size_t) count);
+            break;
+        case TYPE_DOUBLE:
+            if (GTIFKeyGet(gtif, key, values, 0, count) == count)
+                ret = geotiff_meta_add(meta, GTIFKeyName(key), GEOTIFF_META_DOUBLE, values,
+                                       (size_t) count);
+            break;
+        case TYPE_ASCII:
+            /* Strings end with the '|' separator of the GeoTIFF ASCII params */
+            if (GTIFKeyGet(gtif, key, values, 0, count) > 0) {
+                len = strnlen((const char *) values, (size_t) count);
+                while (len > 0 && ((const char *) values)[len - 1] == '|')
+                    len--;
+                ret = geotiff_meta_add(meta, GTIFKeyName(key), GEOTIFF_META_STRING, values, len);
+            }
+            break;
+        default:
+            /* No other types are defined for GeoKeys */
+            break;
+    }
+
+    free(values);
+
+    return ret;
+}
+
+/* Helper function to finish building a catalog: hash the names of its
+ * entries and sort them */
+herr_t geotiff_meta_index(geotiff_meta_t *meta)
+{
+    uint32_t i, j, slot;
+
+    meta->nbuckets = 8;
+    while (meta->nbuckets < meta->nentries * 2)
+        meta->nbuckets *= 2;
+    if (!(meta->buckets = (uint32_t *) calloc(meta->nbuckets, sizeof(uint32_t))) ||
+        !(meta->by_name = (uint32_t *) malloc((meta->nentries + 1) * sizeof(uint32_t))))
+        return -1;
+
+    /* Catalogs hold a few dozen entries, so an insertion sort does */
+    for (i = 0; i < meta->nentries; i++) {
+        const char *name = meta->pool + meta->entries[i].name;
+
+        for (j = i; j > 0 && strcmp(meta->pool + meta->entries[meta->by_name[j - 1]].name,
+                                    name) > 0;
+             j--)
+            meta->by_name[j] = meta->by_name[j - 1];
+        meta->by_name[j] = i;
+    }
+
+    for (i = 0; i < meta->nentries; i++) {
+        const char *name = meta->pool + meta->entries[i].name;
+
+        /* The first of two entries of the same name wins */
+        if (geotiff_meta_find(meta, name))
+            continue;
+        slot = geotiff_meta_hash(name) & (meta->nbuckets - 1);
+        while (meta->buckets[slot])
+            slot = (slot + 1) & (meta->nbuckets - 1);
+        meta->buckets[slot] = i + 1;
+    }
+
+    return 0;
+}
+
+/* Helper function to parse the GeoKeys and georeferencing tags of the current
+ * directory (the first one of a GeoTIFF) into a catalog. Values are copied, so
+ * serving them needs no more TIFF I/O. */
+herr_t geotiff_meta_load(geotiff_meta_t *meta, TIFF *tiff, GTIF *gtif)
+{
+    const uint16_t *dir;
+    const void *data;
+    uint32_t count, i;
+    size_t r;
+    geokey_t key;
+
+    memset(meta, 0, sizeof(*meta));
+
+    if (gtif) {
+        /* Every key of the key directory: a header of four shorts (the last
+         * one the number of keys), then four shorts per key, its ID first */
+        dir = (const uint16_t *) geotiff_meta_get_tag(tiff, GEOTIFF_TAG_KEY_DIRECTORY, TIFF_SHORT,
+                                                      &count);
+        if (dir && count >= 4) {
+            for (i = 0; i < dir[3] && 4 + 4 * i < count; i++)
+                if (geotiff_meta_add_key(meta, gtif, (geokey_t) dir[4 + 4 * i]) < 0)
+                    goto error;
+        } else {
+            for (r = 0; r < GEOTIFF_META_NELMTS(geotiff_meta_key_ranges_g); r++)
+                for (key = geotiff_meta_key_ranges_g[r].first;
+                     key <= geotiff_meta_key_ranges_g[r].last; key++)
+                    if (geotiff_meta_add_key(meta, gtif, key) < 0)
+                        goto error;
+        }
+    }
+
+    for (r = 0; r < GEOTIFF_META_NELMTS(geotiff_meta_tags_g); r++) {
+        if (!(data = geotiff_meta_get_tag(tiff, geotiff_meta_tags_g[r].tag,
+                                          geotiff_meta_tags_g[r].type, &count)))
+            continue;
+        if (geotiff_meta_tags_g[r].type == TIFF_DOUBLE) {
+            if (geotiff_meta_add(meta, geotiff_meta_tags_g[r].name, GEOTIFF_META_DOUBLE, data,
+                                 count) < 0)
+                goto error;
+        } else if (geotiff_meta_add(meta, geotiff_meta_tags_g[r].name, GEOTIFF_META_STRING,
+                                    data, strnlen((const char *) data, count)) < 0)
+            goto error;
+    }
+
+    if (geotiff_meta_index(meta) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    geotiff_meta_free(meta);
+    return -1;
+}
+
+/* Helper function to free a catalog */
+void geotiff_meta_free(geotiff_meta_t *meta)
+{
+    free(meta->entries);
+    free(meta->buckets);
+    free(meta->by_name);
+    free(meta->pool);
+    memset(meta, 0, sizeof(*meta));
+}
+
+/* Helper function to look an entry of a catalog up by name. Returns NULL if
+ * the file has no such GeoKey or tag. */
+const geotiff_meta_entry_t *geotiff_meta_find(const geotiff_meta_t *meta, const char *name)
+{
+    uint32_t slot;
+
+    if (!meta->buckets)
+        return NULL;
+
+    slot = geotiff_meta_hash(name) & (meta->nbuckets - 1);
+    while (meta->buckets[slot]) {
+        const geotiff_meta_entry_t *entry = &meta->entries[meta->buckets[slot] - 1];
+
+        if (strcmp(meta->pool + entry->name, name) == 0)
+            return entry;
+        slot = (slot + 1) & (meta->nbuckets - 1);
+    }
+
+    return NULL;
+}
+
+/* Helper function to get the nth entry of a catalog in name order, or in the
+ * order of the file (which stands in for creation order). Returns NULL past
+ * the last entry. */
+const geotiff_meta_entry_t *geotiff_meta_get(const geotiff_meta_t *meta, H5_index_t idx_type,
+                                              H5_iter_order_t order, hsize_t n)
+{
+    uint32_t i;
+
+    if (n >= meta->nentries)
+        return NULL;
+
+    i = (uint32_t) (order == H5_ITER_DEC ? meta->nentries - 1 - n : n);
+
+    return &meta->entries[idx_type == H5_INDEX_NAME ? meta->by_name[i] : i];
+}
+
+/* Helper function to get the size of the values of an entry in bytes */
+size_t geotiff_meta_size(const geotiff_meta_entry_t *entry)
+{
+    return (size_t) entry->count * geotiff_meta_value_size(entry->type);
+}
+
+/* Helper function to get the HDF5 datatype of an entry: a fixed-size string,
+ * or the native type of its numbers. The caller closes it. */
+hid_t geotiff_meta_type(const geotiff_meta_entry_t *entry)
+{
+    hid_t type_id;
+
+    switch (entry->type) {
+        case GEOTIFF_META_SHORT:
+            return H5Tcopy(H5T_NATIVE_USHORT);
+        case GEOTIFF_META_DOUBLE:
+            return H5Tcopy(H5T_NATIVE_DOUBLE);
+        case GEOTIFF_META_STRING:
+        default:
+            if ((type_id = H5Tcopy(H5T_C_S1)) < 0)
+                return H5I_INVALID_HID;
+            if (H5Tset_size(type_id, entry->count) < 0 ||
+                H5Tset_strpad(type_id, H5T_STR_NULLTERM) < 0) {
+                H5Tclose(type_id);
+                return H5I_INVALID_HID;
+            }
+            return type_id;
+    }
+}
+
+/* Helper function to get the HDF5 dataspace of an entry: scalar for a
+ * string, one dimension of all values for numbers. The caller closes it. */
+hid_t geotiff_meta_space(const geotiff_meta_entry_t *entry)
+{
+    hsize_t dims[1];
+
+    if (entry->type == GEOTIFF_META_STRING)
+        return H5Screate(H5S_SCALAR);
+
+    dims[0] = entry->count;
+
+    return H5Screate_simple(1, dims, NULL);
+}
@@ -0,0 +1,521 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Worker threads and per-file TIFF handles used to decode
+ *              tiles and strips of one read in parallel, or in the background
+ *              for asynchronous reads
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* A set of tasks handed to the pool by one geotiff_pool_run() or
+ * geotiff_pool_start() call */
+struct geotiff_batch_t {
+    geotiff_pool_t *pool;               /* Pool running the batch, NULL if run inline */
+    geotiff_task_func_t func;           /* Task callback */
+    geotiff_batch_done_func_t done;     /* Called once a background batch has finished */
+    void *ctx;                          /* Task and done callback context */
+    size_t ntasks;                      /* Number of tasks */
+    size_t next;                        /* Next task to hand out */
+    size_t ndone;                       /* Number of finished tasks */
+    unsigned nworkers;                  /* Pool threads working on this batch */
+    unsigned max_workers;               /* Most pool threads allowed on this batch */
+    herr_t status;                      /* -1 once any task has failed */
+    int background;                     /* Started by geotiff_pool_start(), no caller works on it */
+    int finished;                       /* Background batch done (or cancelled) and unreferenced */
+    pthread_cond_t done_cond;           /* Signalled when the batch can be freed */
+    struct geotiff_batch_t *next_batch; /* Next batch waiting for workers */
+};
+
+/* Worker thread pool */
+struct geotiff_pool_t {
+    pthread_mutex_t mutex;    /* Protects everything below */
+    pthread_cond_t work_cond; /* Signalled when a batch is queued or on shutdown */
+    pthread_t *threads;       /* Worker threads */
+    unsigned nthreads;        /* Number of worker threads */
+    int shutdown;             /* Set when the pool is being destroyed */
+    geotiff_batch_t *head;    /* Batches that still have tasks to hand out */
+};
+
+/* TIFF handles on one file: the file's own handle, lent only to the threads
+ * that call into the connector, and idle handles of the pool threads. Each
+ * handle has its own directory position and decoder state, so a handle is
+ * only ever used by one thread at a time. */
+struct geotiff_handles_t {
+    pthread_mutex_t own_mutex;  /* Held by the thread using the file's own handle */
+    pthread_mutex_t mutex;      /* Protects everything below */
+    char *filename;             /* File the handles are opened on */
+    geotiff_storage_t *storage; /* Storage they read, held by the file */
+    TIFF *own;                  /* The file's own handle */
+    TIFF **idle;                /* Stack of idle handles */
+    size_t nidle;               /* Number of idle handles */
+    size_t alloc;               /* Allocated stack slots */
+};
+
+/* Process-wide pool, created on the first multi-threaded read */
+static geotiff_pool_t *geotiff_pool_g = NULL;
+static pthread_mutex_t geotiff_pool_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+
+/* Set on the pool's own threads */
+static __thread int geotiff_on_worker_g = 0;
+
+/* Run tasks of a batch until none are left to hand out. Called with the pool
+ * mutex held; drops it while a task runs. */
+static void geotiff_batch_work(pthread_mutex_t *mutex, geotiff_batch_t *batch)
+{
+    while (batch->next < batch->ntasks) {
+        size_t task = batch->next++;
+        herr_t status;
+
+        pthread_mutex_unlock(mutex);
+        status = batch->func(batch->ctx, task);
+        pthread_mutex_lock(mutex);
+
+        if (status < 0)
+            batch->status = -1;
+        if (++batch->ndone == batch->ntasks)
+            pthread_cond_signal(&batch->done_cond);
+    }
+}
+
+/* Remove a batch from the list of batches waiting for workers */
+static void geotiff_batch_unlink(geotiff_pool_t *pool, const geotiff_batch_t *batch)
+{
+    geotiff_batch_t **link;
+
+    for (link = &pool->head; *link; link = &(*link)->next_batch) {
+        if (*link == batch) {
+            *link = batch->next_batch;
+            break;
+        }
+    }
+}
+
+/* Mark a background batch finished once no worker refers to it, calling its
+ * done callback first. Called with the pool mutex held; drops it while the
+ * callback runs. */
+static void geotiff_batch_finish(pthread_mutex_t *mutex, geotiff_batch_t *batch)
+{
+    if (batch->done) {
+        pthread_mutex_unlock(mutex);
+        batch->done(batch->ctx, batch->status);
+        pthread_mutex_lock(mutex);
+    }
+    batch->finished = 1;
+    pthread_cond_broadcast(&batch->done_cond);
+}
+
+static void *geotiff_pool_worker(void *arg)
+{
+    geotiff_pool_t *pool = (geotiff_pool_t *) arg;
+
+    geotiff_on_worker_g = 1;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        geotiff_batch_t *batch;
+
+        /* Find a batch with tasks left and room for another worker */
+        for (batch = pool->head; batch; batch = batch->next_batch)
+            if (batch->next < batch->ntasks && batch->nworkers < batch->max_workers)
+                break;
+
+        if (!batch) {
+            if (pool->shutdown)
+                break;
+            pthread_cond_wait(&pool->work_cond, &pool->mutex);
+            continue;
+        }
+
+        batch->nworkers++;
+        geotiff_batch_work(&pool->mutex, batch);
+        geotiff_batch_unlink(pool, batch);
+
+        /* The owner frees the batch once no worker still refers to it */
+        if (--batch->nworkers == 0 && batch->ndone == batch->ntasks) {
+            if (batch->background)
+                geotiff_batch_finish(&pool->mutex, batch);
+            else
+                pthread_cond_signal(&batch->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/* Helper function to get the process-wide pool with at least nworkers threads,
+ * or as many as could be started. Returns NULL if none could. */
+geotiff_pool_t *geotiff_pool_get(unsigned nworkers)
+{
+    geotiff_pool_t *pool;
+
+    pthread_mutex_lock(&geotiff_pool_mutex_g);
+
+    if (!geotiff_pool_g) {
+        if ((pool = (geotiff_pool_t *) calloc(1, sizeof(geotiff_pool_t)))) {
+            pthread_mutex_init(&pool->mutex, NULL);
+            pthread_cond_init(&pool->work_cond, NULL);
+            geotiff_pool_g = pool;
+        }
+    }
+    pool = geotiff_pool_g;
+
+    /* Grow the pool; a pool that could not grow still serves with fewer threads */
+    if (pool && pool->nthreads < nworkers) {
+        pthread_t *threads = (pthread_t *) realloc(pool->threads, nworkers * sizeof(pthread_t));
+
+        if (threads) {
+            pool->threads = threads;
+            while (pool->nthreads < nworkers &&
+                   pthread_create(&pool->threads[pool->nthreads], NULL, geotiff_pool_worker,
+                                  pool) == 0)
+                pool->nthreads++;
+        }
+    }
+
+    /* A pool without a single thread would never run a background batch, so
+     * callers get none and run their tasks themselves */
+    if (pool && pool->nthreads == 0)
+        pool = NULL;
+
+    pthread_mutex_unlock(&geotiff_pool_mutex_g);
+
+    return pool;
+}
+
+/* Helper function to stop the process-wide pool's threads */
+void geotiff_pool_shutdown(void)
+{
+    geotiff_pool_t *pool;
+    unsigned i;
+
+    pthread_mutex_lock(&geotiff_pool_mutex_g);
+    pool = geotiff_pool_g;
+    geotiff_pool_g = NULL;
+    pthread_mutex_unlock(&geotiff_pool_mutex_g);
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nthreads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+/* Helper function to run ntasks tasks on the calling thread plus up to
+ * max_workers pool threads, returning once all of them have finished.
+ * With no pool the tasks simply run in order on the calling thread. */
+herr_t geotiff_pool_run(geotiff_pool_t *pool, size_t ntasks, unsigned max_workers,
+                        geotiff_task_func_t func, void *ctx)
+{
+    geotiff_batch_t batch;
+    size_t task;
+
+    if (!pool || max_workers == 0 || ntasks < 2) {
+        herr_t status = 0;
+
+        for (task = 0; task < ntasks; task++)
+            if (func(ctx, task) < 0)
+                status = -1;
+        return status;
+    }
+
+    memset(&batch, 0, sizeof(batch));
+    batch.func = func;
+    batch.ctx = ctx;
+    batch.ntasks = ntasks;
+    batch.max_workers = max_workers;
+    pthread_cond_init(&batch.done_cond, NULL);
+
+    pthread_mutex_lock(&pool->mutex);
+    batch.next_batch = pool->head;
+    pool->head = &batch;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    /* The caller works on its own batch too, then waits for stragglers */
+    geotiff_batch_work(&pool->mutex, &batch);
+    geotiff_batch_unlink(pool, &batch);
+    while (batch.ndone < batch.ntasks || batch.nworkers > 0)
+        pthread_cond_wait(&batch.done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_cond_destroy(&batch.done_cond);
+
+    return batch.status;
+}
+
+/* Helper function to start ntasks tasks on up to max_workers pool threads and
+ * return without waiting for them. done (if not NULL) is called, on whichever
+ * thread finishes the last task, before the batch counts as finished. With no
+ * pool the tasks run in order on the calling thread before this returns.
+ * Returns NULL when out of memory. */
+geotiff_batch_t *geotiff_pool_start(geotiff_pool_t *pool, size_t ntasks, unsigned max_workers,
+                                    geotiff_task_func_t func, geotiff_batch_done_func_t done,
+                                    void *ctx)
+{
+    geotiff_batch_t *batch, **link;
+    size_t task;
+
+    if (!(batch = (geotiff_batch_t *) calloc(1, sizeof(geotiff_batch_t))))
+        return NULL;
+    batch->func = func;
+    batch->done = done;
+    batch->ctx = ctx;
+    batch->ntasks = ntasks;
+    batch->max_workers = max_workers;
+    batch->background = 1;
+    pthread_cond_init(&batch->done_cond, NULL);
+
+    if (!pool || max_workers == 0 || ntasks == 0) {
+        for (task = 0; task < ntasks; task++)
+            if (func(ctx, task) < 0)
+                batch->status = -1;
+        batch->next = batch->ndone = ntasks;
+        if (done)
+            done(ctx, batch->status);
+        batch->finished = 1;
+        return batch;
+    }
+
+    /* Background batches queue behind those already waiting, first come first
+     * served, where a blocking caller's batch goes ahead of them */
+    batch->pool = pool;
+    pthread_mutex_lock(&pool->mutex);
+    for (link = &pool->head; *link; link = &(*link)->next_batch)
+        ;
+    *link = batch;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return batch;
+}
+
+/* Helper function to wait up to timeout nanoseconds (UINT64_MAX for ever, 0
+ * to only test) for a batch from geotiff_pool_start() to finish. Returns
+ * nonzero once it has finished. */
+int geotiff_batch_wait(geotiff_batch_t *batch, uint64_t timeout)
+{
+    geotiff_pool_t *pool = batch->pool;
+    struct timespec deadline;
+    int finished;
+
+    if (!pool)
+        return batch->finished;
+
+    if (timeout != UINT64_MAX && timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t) (timeout / 1000000000);
+        deadline.tv_nsec += (long) (timeout % 1000000000);
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!batch->finished && timeout > 0) {
+        if (timeout == UINT64_MAX)
+            pthread_cond_wait(&batch->done_cond, &pool->mutex);
+        else if (pthread_cond_timedwait(&batch->done_cond, &pool->mutex, &deadline) ==
+                 ETIMEDOUT)
+            break;
+    }
+    finished = batch->finished;
+    pthread_mutex_unlock(&pool->mutex);
+
+    return finished;
+}
+
+/* Helper function to get the status of a finished batch: -1 if any task failed */
+herr_t geotiff_batch_status(const geotiff_batch_t *batch)
+{
+    return batch->status;
+}
+
+/* Helper function to cancel a batch from geotiff_pool_start() that no thread
+ * has started on yet; its done callback is called from here, with status -1.
+ * Returns nonzero if the batch was cancelled, zero if it is already running or
+ * finished. */
+int geotiff_batch_cancel(geotiff_batch_t *batch)
+{
+    geotiff_pool_t *pool = batch->pool;
+    int cancelled = 0;
+
+    if (!pool)
+        return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    if (!batch->finished && batch->next == 0) {
+        geotiff_batch_unlink(pool, batch);
+        batch->ntasks = 0;
+        batch->status = -1;
+        geotiff_batch_finish(&pool->mutex, batch);
+        cancelled = 1;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return cancelled;
+}
+
+/* Helper function to wait for a batch from geotiff_pool_start() to finish,
+ * then free it */
+void geotiff_batch_free(geotiff_batch_t *batch)
+{
+    if (!batch)
+        return;
+
+    geotiff_batch_wait(batch, UINT64_MAX);
+    pthread_cond_destroy(&batch->done_cond);
+    free(batch);
+}
+
+/* Helper function to create the handle pool of a file around its already
+ * open handle, which the pool then owns, or around none for a file whose
+ * headers came from its sidecar index (the handle is then opened once
+ * needed). More handles are opened on the file's storage, which must outlive
+ * the pool. */
+geotiff_handles_t *geotiff_handles_create(const char *filename, geotiff_storage_t *storage,
+                                          TIFF *tiff)
+{
+    geotiff_handles_t *handles;
+
+    if (!(handles = (geotiff_handles_t *) calloc(1, sizeof(geotiff_handles_t))))
+        return NULL;
+
+    if (!(handles->filename = strdup(filename))) {
+        free(handles);
+        return NULL;
+    }
+
+    pthread_mutex_init(&handles->own_mutex, NULL);
+    pthread_mutex_init(&handles->mutex, NULL);
+    handles->storage = storage;
+    handles->own = tiff;
+
+    return handles;
+}
+
+/* Helper function to take the file's own handle to read metadata with (the
+ * directories and chunk offsets), waiting while another thread uses it. The
+ * handle is NULL until geotiff_handles_own() opens it, if the pool was
+ * created without one. */
+TIFF *geotiff_handles_lock(geotiff_handles_t *handles)
+{
+    pthread_mutex_lock(&handles->own_mutex);
+
+    return handles->own;
+}
+
+/* Helper function to get the file's own handle, taken with
+ * geotiff_handles_lock(), opening it first if need be. Returns NULL if the
+ * file cannot be opened. */
+TIFF *geotiff_handles_own(geotiff_handles_t *handles)
+{
+    if (!handles->own)
+        handles->own = geotiff_tiff_open(handles->filename, handles->storage);
+
+    return handles->own;
+}
+
+/* Helper function to hand back the handle taken with geotiff_handles_lock() */
+void geotiff_handles_unlock(geotiff_handles_t *handles)
+{
+    pthread_mutex_unlock(&handles->own_mutex);
+}
+
+/* Helper function to take a handle to decode with, opening another if none
+ * is free. A thread calling into the connector borrows the file's own handle
+ * when nobody else is using it; pool threads never get it, so that decoding
+ * in the background never holds up the calling thread reading metadata. */
+TIFF *geotiff_handles_acquire(geotiff_handles_t *handles)
+{
+    TIFF *tiff = NULL;
+
+    if (!geotiff_on_worker_g && pthread_mutex_trylock(&handles->own_mutex) == 0) {
+        if (geotiff_handles_own(handles))
+            return handles->own;
+        pthread_mutex_unlock(&handles->own_mutex);
+    }
+
+    pthread_mutex_lock(&handles->mutex);
+    if (handles->nidle > 0)
+        tiff = handles->idle[--handles->nidle];
+    pthread_mutex_unlock(&handles->mutex);
+
+    if (!tiff)
+        tiff = geotiff_tiff_open(handles->filename, handles->storage);
+
+    return tiff;
+}
+
+/* Helper function to return a handle taken with geotiff_handles_acquire() */
+void geotiff_handles_release(geotiff_handles_t *handles, TIFF *tiff)
+{
+    if (tiff == handles->own) {
+        pthread_mutex_unlock(&handles->own_mutex);
+        return;
+    }
+
+    pthread_mutex_lock(&handles->mutex);
+    if (handles->nidle == handles->alloc) {
+        size_t alloc = handles->alloc ? 2 * handles->alloc : 4;
+        TIFF **idle = (TIFF **) realloc(handles->idle, alloc * sizeof(TIFF *));
+
+        if (!idle) {
+            pthread_mutex_unlock(&handles->mutex);
+            TIFFClose(tiff);
+            return;
+        }
+        handles->idle = idle;
+        handles->alloc = alloc;
+    }
+    handles->idle[handles->nidle++] = tiff;
+    pthread_mutex_unlock(&handles->mutex);
+}
+
+/* Helper function to close the file's own handle and every idle one, and
+ * free the pool */
+void geotiff_handles_destroy(geotiff_handles_t *handles)
+{
+    size_t i;
+
+    if (!handles)
+        return;
+
+    if (handles->own)
+        TIFFClose(handles->own);
+    for (i = 0; i < handles->nidle; i++)
+        TIFFClose(handles->idle[i]);
+
+    pthread_mutex_destroy(&handles->own_mutex);
+    pthread_mutex_destroy(&handles->mutex);
+    free(handles->idle);
+    free(handles->filename);
+    free(handles);
+}
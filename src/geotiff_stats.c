@@ -0,0 +1,150 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Counters of how reads were served, for each open file and for
+ *              the process
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static geotiff_stats_t geotiff_stats_g;
+
+static const char *const geotiff_counter_names_g[GEOTIFF_NCOUNTERS] = {
+    "chunks_decoded", "chunks_mapped", "ranges_read", "chunks_merged",
+    "cache_hits",     "cache_misses",  "bytes_read",  "bytes_decoded",
+    "decode_ns",      "convert_ns",    "reads",       "read_ns",
+};
+
+static const char *const geotiff_codec_names_g[GEOTIFF_NCODECS] = {
+    "none", "lzw", "deflate", "jpeg", "packbits", "lzma", "zstd", "webp", "lerc", "other",
+};
+
+/* Helper function to map a TIFF compression scheme to its codec */
+static geotiff_codec_t geotiff_get_codec(uint16_t compression)
+{
+    switch (compression) {
+        case COMPRESSION_NONE:
+            return GEOTIFF_CODEC_NONE;
+        case COMPRESSION_LZW:
+            return GEOTIFF_CODEC_LZW;
+        case COMPRESSION_ADOBE_DEFLATE:
+        case COMPRESSION_DEFLATE:
+            return GEOTIFF_CODEC_DEFLATE;
+        case COMPRESSION_OJPEG:
+        case COMPRESSION_JPEG:
+            return GEOTIFF_CODEC_JPEG;
+        case COMPRESSION_PACKBITS:
+            return GEOTIFF_CODEC_PACKBITS;
+        case 34925: /* COMPRESSION_LZMA */
+            return GEOTIFF_CODEC_LZMA;
+        case 50000: /* COMPRESSION_ZSTD */
+            return GEOTIFF_CODEC_ZSTD;
+        case 50001: /* COMPRESSION_WEBP */
+            return GEOTIFF_CODEC_WEBP;
+        case 34887: /* COMPRESSION_LERC */
+            return GEOTIFF_CODEC_LERC;
+        default:
+            return GEOTIFF_CODEC_OTHER;
+    }
+}
+
+/* Helper function to add to a counter of a file (if stats is not NULL) and of
+ * the process; safe to call from decoder threads */
+void geotiff_count(geotiff_stats_t *stats, geotiff_counter_t counter, uint64_t n)
+{
+    if (stats)
+        __atomic_fetch_add(&stats->counters[counter], n, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&geotiff_stats_g.counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/* Helper function to count a chunk of bytes decoded in ns with a compression
+ * scheme */
+void geotiff_count_decode(geotiff_stats_t *stats, uint16_t compression, uint64_t bytes,
+                          uint64_t ns)
+{
+    geotiff_codec_t codec = geotiff_get_codec(compression);
+    geotiff_stats_t *targets[2] = {stats, &geotiff_stats_g};
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (!targets[i])
+            continue;
+        __atomic_fetch_add(&targets[i]->counters[GEOTIFF_COUNTER_CHUNKS_DECODED], 1,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&targets[i]->counters[GEOTIFF_COUNTER_BYTES_DECODED], bytes,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&targets[i]->counters[GEOTIFF_COUNTER_DECODE_NS], ns,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&targets[i]->codec_chunks[codec], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&targets[i]->codec_ns[codec], ns, __ATOMIC_RELAXED);
+    }
+}
+
+/* Helper function to get a monotonic time stamp in nanoseconds */
+uint64_t geotiff_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+/* Helper function to take a snapshot of a file's statistics, or of the
+ * process's when stats is NULL */
+void geotiff_stats_get(const geotiff_stats_t *stats, geotiff_stats_t *snapshot)
+{
+    int i;
+
+    if (!stats)
+        stats = &geotiff_stats_g;
+
+    for (i = 0; i < GEOTIFF_NCOUNTERS; i++)
+        snapshot->counters[i] = __atomic_load_n(&stats->counters[i], __ATOMIC_RELAXED);
+    for (i = 0; i < GEOTIFF_NCODECS; i++) {
+        snapshot->codec_chunks[i] = __atomic_load_n(&stats->codec_chunks[i], __ATOMIC_RELAXED);
+        snapshot->codec_ns[i] = __atomic_load_n(&stats->codec_ns[i], __ATOMIC_RELAXED);
+    }
+}
+
+/* Helper function to print the process's statistics to stderr when the
+ * GEOTIFF_VOL_STATS environment variable is set */
+void geotiff_stats_report(void)
+{
+    geotiff_stats_t stats;
+    geotiff_cache_stats_t cache;
+    int i;
+
+    if (!getenv("GEOTIFF_VOL_STATS"))
+        return;
+
+    geotiff_stats_get(NULL, &stats);
+
+    fprintf(stderr, "geotiff_vol_connector statistics:\n");
+    for (i = 0; i < GEOTIFF_NCOUNTERS; i++)
+        fprintf(stderr, "  %-16s %llu\n", geotiff_counter_names_g[i],
+                (unsigned long long) stats.counters[i]);
+    for (i = 0; i < GEOTIFF_NCODECS; i++)
+        if (stats.codec_chunks[i] > 0)
+            fprintf(stderr, "  decode_%-9s %llu chunks, %llu ns\n", geotiff_codec_names_g[i],
+                    (unsigned long long) stats.codec_chunks[i],
+                    (unsigned long long) stats.codec_ns[i]);
+
+    geotiff_cache_get_stats(&cache);
+    fprintf(stderr, "  %-16s %llu\n", "cache_evictions", (unsigned long long) cache.evictions);
+    fprintf(stderr, "  %-16s %zu\n", "cache_bytes", cache.bytes);
+}
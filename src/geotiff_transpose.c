@@ -0,0 +1,251 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ * Copyright by The HDF Group.                                               *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This file is part of HDF5.  The full HDF5 copyright notice, including     *
+ * terms governing use, modification, and redistribution, is contained in    *
+ * the COPYING file, which can be found at the root of the source code       *
+ * distribution tree, or in https://support.hdfgroup.org/ftp/HDF5/releases.  *
+ * If you do not have access to either file, you may request a copy from     *
+ * help@hdfgroup.org.                                                        *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+/* Purpose:     Transposition of samples between pixel-interleaved and
+ *              band-sequential order, applied while pixels are copied out of
+ *              a chunk
+ */
+
+/* This connector's header */
+#include "template_vol_connector.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GEOTIFF_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/* A transpose copies a rows x cols matrix whose element (i, j) is at
+ * src[i * src_stride + j] to dst[j * dst_stride + i], strides counting
+ * samples. It is walked in square blocks small enough that the rows read and
+ * the rows written all stay in L1. Samples are loaded and stored with memcpy()
+ * since pixels in a file mapping need not be aligned. */
+#define GEOTIFF_TRANSPOSE_BLOCK 32
+
+#define GEOTIFF_DEF_TRANSPOSE(SN, ST)                                                             \
+    static void geotiff_transpose_##SN(void *dst, size_t dst_stride, const void *src,              \
+                                       size_t src_stride, size_t rows, size_t cols)                \
+    {                                                                                              \
+        const unsigned char *s = (const unsigned char *) src;                                      \
+        unsigned char *d = (unsigned char *) dst;                                                  \
+        size_t i0, j0, i, j;                                                                       \
+                                                                                                   \
+        for (i0 = 0; i0 < rows; i0 += GEOTIFF_TRANSPOSE_BLOCK) {                                   \
+            size_t i1 = i0 + GEOTIFF_TRANSPOSE_BLOCK < rows ? i0 + GEOTIFF_TRANSPOSE_BLOCK : rows; \
+                                                                                                   \
+            for (j0 = 0; j0 < cols; j0 += GEOTIFF_TRANSPOSE_BLOCK) {                               \
+                size_t j1 =                                                                        \
+                    j0 + GEOTIFF_TRANSPOSE_BLOCK < cols ? j0 + GEOTIFF_TRANSPOSE_BLOCK : cols;     \
+                                                                                                   \
+                for (j = j0; j < j1; j++)                                                          \
+                    for (i = i0; i < i1; i++) {                                                    \
+                        ST v;                                                                      \
+                                                                                                   \
+                        memcpy(&v, s + (i * src_stride + j) * sizeof(ST), sizeof(ST));            \
+                        memcpy(d + (j * dst_stride + i) * sizeof(ST), &v, sizeof(ST));            \
+                    }                                                                              \
+            }                                                                                      \
+        }                                                                                          \
+    }
+
+GEOTIFF_DEF_TRANSPOSE(8, uint8_t)
+GEOTIFF_DEF_TRANSPOSE(16, uint16_t)
+GEOTIFF_DEF_TRANSPOSE(32, uint32_t)
+GEOTIFF_DEF_TRANSPOSE(64, uint64_t)
+
+/* Transposes by sample size in bytes, log2 */
+static geotiff_transpose_func_t geotiff_transpose_g[4] = {
+    geotiff_transpose_8,
+    geotiff_transpose_16,
+    geotiff_transpose_32,
+    geotiff_transpose_64,
+};
+
+static pthread_once_t geotiff_transpose_once_g = PTHREAD_ONCE_INIT;
+
+#ifdef GEOTIFF_HAVE_X86_SIMD
+/* Vector versions transpose whole K x K tiles in registers and leave the
+ * ragged right and bottom edges to the scalar loops */
+
+/* Transpose of one K x K tile, strides in samples */
+typedef void (*geotiff_tile_func_t)(unsigned char *dst, size_t dst_stride,
+                                    const unsigned char *src, size_t src_stride);
+
+__attribute__((target("sse2"))) static void geotiff_tile_8_sse2(unsigned char *d, size_t ds,
+                                                                const unsigned char *s, size_t ss)
+{
+    __m128i r0 = _mm_loadl_epi64((const __m128i *) (s + 0 * ss));
+    __m128i r1 = _mm_loadl_epi64((const __m128i *) (s + 1 * ss));
+    __m128i r2 = _mm_loadl_epi64((const __m128i *) (s + 2 * ss));
+    __m128i r3 = _mm_loadl_epi64((const __m128i *) (s + 3 * ss));
+    __m128i r4 = _mm_loadl_epi64((const __m128i *) (s + 4 * ss));
+    __m128i r5 = _mm_loadl_epi64((const __m128i *) (s + 5 * ss));
+    __m128i r6 = _mm_loadl_epi64((const __m128i *) (s + 6 * ss));
+    __m128i r7 = _mm_loadl_epi64((const __m128i *) (s + 7 * ss));
+    __m128i a0 = _mm_unpacklo_epi8(r0, r1), a1 = _mm_unpacklo_epi8(r2, r3);
+    __m128i a2 = _mm_unpacklo_epi8(r4, r5), a3 = _mm_unpacklo_epi8(r6, r7);
+    __m128i b0 = _mm_unpacklo_epi16(a0, a1), b1 = _mm_unpackhi_epi16(a0, a1);
+    __m128i b2 = _mm_unpacklo_epi16(a2, a3), b3 = _mm_unpackhi_epi16(a2, a3);
+    __m128i c0 = _mm_unpacklo_epi32(b0, b2), c1 = _mm_unpackhi_epi32(b0, b2);
+    __m128i c2 = _mm_unpacklo_epi32(b1, b3), c3 = _mm_unpackhi_epi32(b1, b3);
+
+    /* Each register now holds two columns of the tile */
+    _mm_storel_epi64((__m128i *) (d + 0 * ds), c0);
+    _mm_storel_epi64((__m128i *) (d + 1 * ds), _mm_srli_si128(c0, 8));
+    _mm_storel_epi64((__m128i *) (d + 2 * ds), c1);
+    _mm_storel_epi64((__m128i *) (d + 3 * ds), _mm_srli_si128(c1, 8));
+    _mm_storel_epi64((__m128i *) (d + 4 * ds), c2);
+    _mm_storel_epi64((__m128i *) (d + 5 * ds), _mm_srli_si128(c2, 8));
+    _mm_storel_epi64((__m128i *) (d + 6 * ds), c3);
+    _mm_storel_epi64((__m128i *) (d + 7 * ds), _mm_srli_si128(c3, 8));
+}
+
+__attribute__((target("sse2"))) static void geotiff_tile_16_sse2(unsigned char *d, size_t ds,
+                                                                 const unsigned char *s, size_t ss)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *) (s + 0 * 2 * ss));
+    __m128i r1 = _mm_loadu_si128((const __m128i *) (s + 1 * 2 * ss));
+    __m128i r2 = _mm_loadu_si128((const __m128i *) (s + 2 * 2 * ss));
+    __m128i r3 = _mm_loadu_si128((const __m128i *) (s + 3 * 2 * ss));
+    __m128i r4 = _mm_loadu_si128((const __m128i *) (s + 4 * 2 * ss));
+    __m128i r5 = _mm_loadu_si128((const __m128i *) (s + 5 * 2 * ss));
+    __m128i r6 = _mm_loadu_si128((const __m128i *) (s + 6 * 2 * ss));
+    __m128i r7 = _mm_loadu_si128((const __m128i *) (s + 7 * 2 * ss));
+    __m128i a0 = _mm_unpacklo_epi16(r0, r1), a1 = _mm_unpackhi_epi16(r0, r1);
+    __m128i a2 = _mm_unpacklo_epi16(r2, r3), a3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i a4 = _mm_unpacklo_epi16(r4, r5), a5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i a6 = _mm_unpacklo_epi16(r6, r7), a7 = _mm_unpackhi_epi16(r6, r7);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+
+    _mm_storeu_si128((__m128i *) (d + 0 * 2 * ds), _mm_unpacklo_epi64(b0, b4));
+    _mm_storeu_si128((__m128i *) (d + 1 * 2 * ds), _mm_unpackhi_epi64(b0, b4));
+    _mm_storeu_si128((__m128i *) (d + 2 * 2 * ds), _mm_unpacklo_epi64(b1, b5));
+    _mm_storeu_si128((__m128i *) (d + 3 * 2 * ds), _mm_unpackhi_epi64(b1, b5));
+    _mm_storeu_si128((__m128i *) (d + 4 * 2 * ds), _mm_unpacklo_epi64(b2, b6));
+    _mm_storeu_si128((__m128i *) (d + 5 * 2 * ds), _mm_unpackhi_epi64(b2, b6));
+    _mm_storeu_si128((__m128i *) (d + 6 * 2 * ds), _mm_unpacklo_epi64(b3, b7));
+    _mm_storeu_si128((__m128i *) (d + 7 * 2 * ds), _mm_unpackhi_epi64(b3, b7));
+}
+
+__attribute__((target("sse2"))) static void geotiff_tile_32_sse2(unsigned char *d, size_t ds,
+                                                                 const unsigned char *s, size_t ss)
+{
+    __m128 r0 = _mm_loadu_ps((const float *) (s + 0 * 4 * ss));
+    __m128 r1 = _mm_loadu_ps((const float *) (s + 1 * 4 * ss));
+    __m128 r2 = _mm_loadu_ps((const float *) (s + 2 * 4 * ss));
+    __m128 r3 = _mm_loadu_ps((const float *) (s + 3 * 4 * ss));
+
+    /* Moves only, so any 32-bit sample survives, NaN payloads included */
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+    _mm_storeu_ps((float *) (d + 0 * 4 * ds), r0);
+    _mm_storeu_ps((float *) (d + 1 * 4 * ds), r1);
+    _mm_storeu_ps((float *) (d + 2 * 4 * ds), r2);
+    _mm_storeu_ps((float *) (d + 3 * 4 * ds), r3);
+}
+
+/* Helper function to transpose with K x K tiles, blocked as the scalar loops
+ * are, finishing the edges with the scalar transpose */
+static void geotiff_transpose_tiled(geotiff_tile_func_t tile, size_t k, size_t size,
+                                    geotiff_transpose_func_t scalar, void *dst,
+                                    size_t dst_stride, const void *src, size_t src_stride,
+                                    size_t rows, size_t cols)
+{
+    const unsigned char *s = (const unsigned char *) src;
+    unsigned char *d = (unsigned char *) dst;
+    size_t full_rows = rows - rows % k, full_cols = cols - cols % k;
+    size_t i0, j0, i, j;
+
+    for (i0 = 0; i0 < full_rows; i0 += GEOTIFF_TRANSPOSE_BLOCK) {
+        size_t i1 = i0 + GEOTIFF_TRANSPOSE_BLOCK < full_rows ? i0 + GEOTIFF_TRANSPOSE_BLOCK
+                                                             : full_rows;
+
+        for (j0 = 0; j0 < full_cols; j0 += GEOTIFF_TRANSPOSE_BLOCK) {
+            size_t j1 = j0 + GEOTIFF_TRANSPOSE_BLOCK < full_cols ? j0 + GEOTIFF_TRANSPOSE_BLOCK
+                                                                 : full_cols;
+
+            for (i = i0; i < i1; i += k)
+                for (j = j0; j < j1; j += k)
+                    tile(d + (j * dst_stride + i) * size, dst_stride,
+                         s + (i * src_stride + j) * size, src_stride);
+        }
+    }
+
+    /* Columns right of the last whole tile, then rows below it */
+    if (full_cols < cols)
+        scalar(d + full_cols * dst_stride * size, dst_stride, s + full_cols * size, src_stride,
+               rows, cols - full_cols);
+    if (full_rows < rows)
+        scalar(d + full_rows * size, dst_stride, s + full_rows * src_stride * size, src_stride,
+               rows - full_rows, full_cols);
+}
+
+static void geotiff_transpose_8_sse2(void *dst, size_t dst_stride, const void *src,
+                                     size_t src_stride, size_t rows, size_t cols)
+{
+    geotiff_transpose_tiled(geotiff_tile_8_sse2, 8, 1, geotiff_transpose_8, dst, dst_stride, src,
+                            src_stride, rows, cols);
+}
+
+static void geotiff_transpose_16_sse2(void *dst, size_t dst_stride, const void *src,
+                                      size_t src_stride, size_t rows, size_t cols)
+{
+    geotiff_transpose_tiled(geotiff_tile_16_sse2, 8, 2, geotiff_transpose_16, dst, dst_stride, src,
+                            src_stride, rows, cols);
+}
+
+static void geotiff_transpose_32_sse2(void *dst, size_t dst_stride, const void *src,
+                                      size_t src_stride, size_t rows, size_t cols)
+{
+    geotiff_transpose_tiled(geotiff_tile_32_sse2, 4, 4, geotiff_transpose_32, dst, dst_stride, src,
+                            src_stride, rows, cols);
+}
+#endif /* GEOTIFF_HAVE_X86_SIMD */
+
+/* Helper function to install the vector transposes the CPU supports */
+static void geotiff_transpose_init(void)
+{
+#ifdef GEOTIFF_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        geotiff_transpose_g[0] = geotiff_transpose_8_sse2;
+        geotiff_transpose_g[1] = geotiff_transpose_16_sse2;
+        geotiff_transpose_g[2] = geotiff_transpose_32_sse2;
+    }
+#endif
+}
+
+/* Helper function to get the function transposing samples of size bytes, or
+ * NULL if there is none for that size */
+geotiff_transpose_func_t geotiff_get_transpose(size_t size)
+{
+    pthread_once(&geotiff_transpose_once_g, geotiff_transpose_init);
+
+    switch (size) {
+        case 1:
+            return geotiff_transpose_g[0];
+        case 2:
+            return geotiff_transpose_g[1];
+        case 4:
+            return geotiff_transpose_g[2];
+        case 8:
+            return geotiff_transpose_g[3];
+        default:
+            return NULL;
+    }
+}
@@ -20,10 +20,18 @@
 #include <H5PLextern.h>
 #include <assert.h>
 #include <hdf5.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+/* Number of selection sequences fetched per H5Ssel_iter_get_seq_list() call */
+#define GEOTIFF_SEQ_LIST_LEN 64
+
+/* Largest byte range read in one go for several chunks */
+#define GEOTIFF_MAX_RUN_BYTES ((uint64_t) 16 * 1024 * 1024)
 
 #ifdef _MSC_VER
 #ifndef strdup
@@ -31,25 +39,231 @@
 #endif
 #endif
 
+/* Operation type HDF5 assigned to the get_stats file optional operation */
+static int geotiff_get_stats_op_g = -1;
+
 /* GeoTIFF VOL connector initialization */
 herr_t geotiff_init_connector(hid_t __attribute__((unused)) vipl_id)
 {
+    if (geotiff_get_stats_op_g < 0 &&
+        H5VLregister_opt_operation(H5VL_SUBCLS_FILE, GEOTIFF_GET_STATS_OP_NAME,
+                                   &geotiff_get_stats_op_g) < 0)
+        return -1;
+
     return 0;
 }
 
 /* GeoTIFF VOL connector termination */
 herr_t geotiff_term_connector(void)
 {
+    geotiff_pool_shutdown();
+    geotiff_stats_report();
+    geotiff_cache_clear();
+    if (geotiff_get_stats_op_g >= 0) {
+        H5VLunregister_opt_operation(H5VL_SUBCLS_FILE, GEOTIFF_GET_STATS_OP_NAME);
+        geotiff_get_stats_op_g = -1;
+    }
+    return 0;
+}
+
+/* Connector info operations */
+void *geotiff_info_copy(const void *info)
+{
+    geotiff_info_t *copy;
+
+    if (!(copy = (geotiff_info_t *) malloc(sizeof(geotiff_info_t))))
+        return NULL;
+    memcpy(copy, info, sizeof(geotiff_info_t));
+
+    return copy;
+}
+
+herr_t geotiff_info_cmp(int *cmp_value, const void *info1, const void *info2)
+{
+    const geotiff_info_t *i1 = (const geotiff_info_t *) info1;
+    const geotiff_info_t *i2 = (const geotiff_info_t *) info2;
+
+    *cmp_value = (i1->threads > i2->threads) - (i1->threads < i2->threads);
+    if (*cmp_value == 0)
+        *cmp_value = (i1->cache_mb > i2->cache_mb) - (i1->cache_mb < i2->cache_mb);
+    if (*cmp_value == 0)
+        *cmp_value = (i1->gap_kb > i2->gap_kb) - (i1->gap_kb < i2->gap_kb);
+    if (*cmp_value == 0)
+        *cmp_value = (i1->io > i2->io) - (i1->io < i2->io);
+    if (*cmp_value == 0)
+        *cmp_value = (i1->readahead_kb > i2->readahead_kb) - (i1->readahead_kb < i2->readahead_kb);
+    if (*cmp_value == 0)
+        *cmp_value = (!!i1->lazy > !!i2->lazy) - (!!i1->lazy < !!i2->lazy);
+    if (*cmp_value == 0)
+        *cmp_value = (!!i1->index > !!i2->index) - (!!i1->index < !!i2->index);
+    if (*cmp_value == 0)
+        *cmp_value = ((uintptr_t) i1->buffer > (uintptr_t) i2->buffer) -
+                     ((uintptr_t) i1->buffer < (uintptr_t) i2->buffer);
+    if (*cmp_value == 0)
+        *cmp_value = (i1->buffer_size > i2->buffer_size) - (i1->buffer_size < i2->buffer_size);
+
+    return 0;
+}
+
+herr_t geotiff_info_free(void *info)
+{
+    free(info);
+    return 0;
+}
+
+herr_t geotiff_info_to_str(const void *info, char **str)
+{
+    const geotiff_info_t *gi = (const geotiff_info_t *) info;
+
+    /* HDF5 releases the string with H5free_memory() */
+    if (!(*str = (char *) H5allocate_memory(160, 0)))
+        return -1;
+    snprintf(*str, 160,
+             "threads=%u;cache_mb=%zu;gap_kb=%zu;io=%s;readahead_kb=%zu;lazy=%d;index=%d",
+             gi->threads, gi->cache_mb, gi->gap_kb, geotiff_io_name(gi->io), gi->readahead_kb,
+             gi->lazy ? 1 : 0, gi->index ? 1 : 0);
+
+    return 0;
+}
+
+/* Helper function to set one key=value pair of the connector info string */
+static herr_t geotiff_info_set(geotiff_info_t *info, const char *key, size_t key_len,
+                               const char *value, size_t value_len)
+{
+    char buf[32];
+    char *end;
+    unsigned long val;
+
+    if (value_len == 0 || value_len >= sizeof(buf))
+        return -1;
+    memcpy(buf, value, value_len);
+    buf[value_len] = '\0';
+
+    /* The memory backend needs a buffer, which only a geotiff_info_t can carry */
+    if (key_len == strlen("io") && !strncmp(key, "io", key_len)) {
+        int io;
+
+        for (io = 0; io < GEOTIFF_IO_MEMORY; io++)
+            if (!strcmp(buf, geotiff_io_name((geotiff_io_t) io))) {
+                info->io = (geotiff_io_t) io;
+                return 0;
+            }
+        return -1;
+    }
+
+    if (key_len == strlen("threads") && !strncmp(key, "threads", key_len)) {
+        val = strtoul(buf, &end, 10);
+        if (*end != '\0' || buf[0] == '-' || val == 0 || val > GEOTIFF_MAX_THREADS)
+            return -1;
+        info->threads = (unsigned) val;
+        return 0;
+    }
+    if (key_len == strlen("cache_mb") && !strncmp(key, "cache_mb", key_len)) {
+        val = strtoul(buf, &end, 10);
+        if (*end != '\0' || buf[0] == '-' || val > SIZE_MAX / (1024 * 1024))
+            return -1;
+        info->cache_mb = (size_t) val;
+        return 0;
+    }
+    if (key_len == strlen("gap_kb") && !strncmp(key, "gap_kb", key_len)) {
+        val = strtoul(buf, &end, 10);
+        if (*end != '\0' || buf[0] == '-' || val > SIZE_MAX / 1024)
+            return -1;
+        info->gap_kb = (size_t) val;
+        return 0;
+    }
+    if (key_len == strlen("readahead_kb") && !strncmp(key, "readahead_kb", key_len)) {
+        val = strtoul(buf, &end, 10);
+        if (*end != '\0' || buf[0] == '-' || val > SIZE_MAX / 1024)
+            return -1;
+        info->readahead_kb = (size_t) val;
+        return 0;
+    }
+    if (key_len == strlen("lazy") && !strncmp(key, "lazy", key_len)) {
+        if (strcmp(buf, "0") != 0 && strcmp(buf, "1") != 0)
+            return -1;
+        info->lazy = buf[0] == '1';
+        return 0;
+    }
+    if (key_len == strlen("index") && !strncmp(key, "index", key_len)) {
+        if (strcmp(buf, "0") != 0 && strcmp(buf, "1") != 0)
+            return -1;
+        info->index = buf[0] == '1';
+        return 0;
+    }
+
+    /* Unknown key */
+    return -1;
+}
+
+herr_t geotiff_info_from_str(const char *str, void **info)
+{
+    geotiff_info_t *gi;
+    const char *p = str;
+
+    if (!(gi = (geotiff_info_t *) malloc(sizeof(geotiff_info_t))))
+        return -1;
+    gi->threads = GEOTIFF_DEFAULT_THREADS;
+    gi->cache_mb = GEOTIFF_DEFAULT_CACHE_MB;
+    gi->gap_kb = GEOTIFF_DEFAULT_GAP_KB;
+    gi->io = GEOTIFF_IO_PREAD;
+    gi->readahead_kb = GEOTIFF_DEFAULT_READAHEAD_KB;
+    gi->lazy = GEOTIFF_DEFAULT_LAZY;
+    gi->index = GEOTIFF_DEFAULT_INDEX;
+    gi->buffer = NULL;
+    gi->buffer_size = 0;
+
+    /* Pairs are separated by ';', ',' or whitespace, e.g. "threads=8" */
+    while (p && *p) {
+        const char *eq;
+        size_t len;
+
+        p += strspn(p, "; ,\t");
+        if (!(len = strcspn(p, "; ,\t")))
+            break;
+        if (!(eq = (const char *) memchr(p, '=', len)) ||
+            geotiff_info_set(gi, p, (size_t) (eq - p), eq + 1, len - (size_t) (eq - p) - 1) < 0) {
+            free(gi);
+            return -1;
+        }
+        p += len;
+    }
+
+    *info = gi;
+
     return 0;
 }
 
-/* Simple introspect opt_query function that reports no optional operations are supported */
+/* Introspect opt_query function: the chunk queries and direct chunk reads
+ * of datasets, and getting the read statistics of a file, are the only
+ * optional operations supported */
 herr_t geotiff_introspect_opt_query(void __attribute__((unused)) * obj, H5VL_subclass_t subcls,
-                                    int opt_type, uint64_t __attribute__((unused)) * flags)
+                                    int opt_type, uint64_t *flags)
 {
-    /* We don't support any optional operations */
-    (void) subcls;
-    (void) opt_type;
+    *flags = 0;
+
+    if (subcls == H5VL_SUBCLS_FILE) {
+        if (geotiff_get_stats_op_g >= 0 && opt_type == geotiff_get_stats_op_g)
+            *flags = H5VL_OPT_QUERY_SUPPORTED | H5VL_OPT_QUERY_QUERY_METADATA;
+        return 0;
+    }
+    if (subcls != H5VL_SUBCLS_DATASET)
+        return 0;
+
+    switch (opt_type) {
+        case H5VL_NATIVE_DATASET_GET_NUM_CHUNKS:
+        case H5VL_NATIVE_DATASET_GET_CHUNK_INFO_BY_IDX:
+        case H5VL_NATIVE_DATASET_GET_CHUNK_INFO_BY_COORD:
+        case H5VL_NATIVE_DATASET_GET_CHUNK_STORAGE_SIZE:
+            *flags = H5VL_OPT_QUERY_SUPPORTED | H5VL_OPT_QUERY_QUERY_METADATA;
+            break;
+        case H5VL_NATIVE_DATASET_CHUNK_READ:
+            *flags = H5VL_OPT_QUERY_SUPPORTED | H5VL_OPT_QUERY_READ_DATA;
+            break;
+        default:
+            break;
+    }
+
     return 0;
 }
 
@@ -59,17 +273,17 @@ static const H5VL_class_t geotiff_class_g = {
     GEOTIFF_VOL_CONNECTOR_VALUE, /* value                    */
     GEOTIFF_VOL_CONNECTOR_NAME,  /* name                     */
     1,                           /* version                  */
-    0,                           /* capability flags         */
+    H5VL_CAP_FLAG_ASYNC,         /* capability flags         */
     geotiff_init_connector,      /* initialize               */
     geotiff_term_connector,      /* terminate                */
     {
         /* info_cls */
-        (size_t) 0, /* size    */
-        NULL,       /* copy    */
-        NULL,       /* compare */
-        NULL,       /* free    */
-        NULL,       /* to_str  */
-        NULL,       /* from_str */
+        sizeof(geotiff_info_t), /* size    */
+        geotiff_info_copy,     /* copy    */
+        geotiff_info_cmp,      /* compare */
+        geotiff_info_free,     /* free    */
+        geotiff_info_to_str,   /* to_str  */
+        geotiff_info_from_str, /* from_str */
     },
     {
         /* wrap_cls */
@@ -81,25 +295,25 @@ static const H5VL_class_t geotiff_class_g = {
     },
     {
         /* attribute_cls */
-        NULL,              /* create       */
-        geotiff_attr_open, /* open         */
-        geotiff_attr_read, /* read         */
-        NULL,              /* write        */
-        geotiff_attr_get,  /* get          */
-        NULL,              /* specific     */
-        NULL,              /* optional     */
-        geotiff_attr_close /* close        */
+        NULL,                  /* create       */
+        geotiff_attr_open,     /* open         */
+        geotiff_attr_read,     /* read         */
+        NULL,                  /* write        */
+        geotiff_attr_get,      /* get          */
+        geotiff_attr_specific, /* specific     */
+        NULL,                  /* optional     */
+        geotiff_attr_close     /* close        */
     },
     {
         /* dataset_cls */
-        NULL,                 /* create       */
-        geotiff_dataset_open, /* open         */
-        geotiff_dataset_read, /* read         */
-        NULL,                 /* write        */
-        geotiff_dataset_get,  /* get          */
-        NULL,                 /* specific     */
-        NULL,                 /* optional     */
-        geotiff_dataset_close /* close        */
+        NULL,                     /* create       */
+        geotiff_dataset_open,     /* open         */
+        geotiff_dataset_read,     /* read         */
+        NULL,                     /* write        */
+        geotiff_dataset_get,      /* get          */
+        NULL,                     /* specific     */
+        geotiff_dataset_optional, /* optional     */
+        geotiff_dataset_close     /* close        */
     },
     {
         /* datatype_cls */
@@ -112,12 +326,12 @@ static const H5VL_class_t geotiff_class_g = {
     },
     {
         /* file_cls */
-        geotiff_file_create, /* create       */
-        geotiff_file_open,   /* open         */
-        geotiff_file_get,    /* get          */
-        NULL,                /* specific     */
-        NULL,                /* optional     */
-        geotiff_file_close   /* close        */
+        geotiff_file_create,   /* create       */
+        geotiff_file_open,     /* open         */
+        geotiff_file_get,      /* get          */
+        NULL,                  /* specific     */
+        geotiff_file_optional, /* optional     */
+        geotiff_file_close     /* close        */
     },
     {
         /* group_cls */
@@ -130,20 +344,20 @@ static const H5VL_class_t geotiff_class_g = {
     },
     {
         /* link_cls */
-        NULL, /* create       */
-        NULL, /* copy         */
-        NULL, /* move         */
-        NULL, /* get          */
-        NULL, /* specific     */
-        NULL  /* optional     */
+        NULL,                  /* create       */
+        NULL,                  /* copy         */
+        NULL,                  /* move         */
+        geotiff_link_get,      /* get          */
+        geotiff_link_specific, /* specific     */
+        NULL                   /* optional     */
     },
     {
         /* object_cls */
-        NULL, /* open         */
-        NULL, /* copy         */
-        NULL, /* get          */
-        NULL, /* specific     */
-        NULL  /* optional     */
+        geotiff_object_open,     /* open         */
+        NULL,                    /* copy         */
+        geotiff_object_get,      /* get          */
+        geotiff_object_specific, /* specific     */
+        NULL                     /* optional     */
     },
     {
         /* introscpect_cls */
@@ -153,12 +367,12 @@ static const H5VL_class_t geotiff_class_g = {
     },
     {
         /* request_cls */
-        NULL, /* wait         */
-        NULL, /* notify       */
-        NULL, /* cancel       */
-        NULL, /* specific     */
-        NULL, /* optional     */
-        NULL  /* free         */
+        geotiff_request_wait,   /* wait         */
+        geotiff_request_notify, /* notify       */
+        geotiff_request_cancel, /* cancel       */
+        NULL,                   /* specific     */
+        NULL,                   /* optional     */
+        geotiff_request_free    /* free         */
     },
     {
         /* blob_cls */
@@ -235,10 +449,330 @@ void *geotiff_file_create(const char __attribute__((unused)) * name,
     return NULL;
 }
 
+/* Number of the last open of a file in memory */
+static uint64_t geotiff_memory_generation_g = 0;
+
+/* Helper function to identify a file in the chunk cache. Opens of the same
+ * unmodified file get the same identity, whichever path they go through; a
+ * file rewritten in place, even within the same second, gets another one. A
+ * file in memory is known by its name, address and size, and by a number of
+ * its own, since other bytes may later be opened at the same address. */
+static void geotiff_get_file_id(const char *name, const void *buffer, size_t buffer_size,
+                                geotiff_file_id_t *id)
+{
+    struct stat st;
+
+    memset(id, 0, sizeof(geotiff_file_id_t));
+    if (buffer) {
+        id->size = (uint64_t) buffer_size;
+        id->mtime = (uint64_t) (uintptr_t) buffer;
+        id->generation = __atomic_add_fetch(&geotiff_memory_generation_g, 1, __ATOMIC_RELAXED);
+    } else if (stat(name, &st) == 0) {
+        id->dev = (uint64_t) st.st_dev;
+        id->ino = (uint64_t) st.st_ino;
+        id->size = (uint64_t) st.st_size;
+        id->mtime = (uint64_t) st.st_mtime;
+        id->ctime = (uint64_t) st.st_ctime;
+#if defined(__APPLE__)
+        id->mtime_nsec = (uint64_t) st.st_mtimespec.tv_nsec;
+#elif !defined(_WIN32)
+        id->mtime_nsec = (uint64_t) st.st_mtim.tv_nsec;
+#endif
+    }
+
+    /* No inode numbers (e.g. on Windows): fall back to a hash of the path */
+    if (id->ino == 0) {
+        uint64_t h = 14695981039346656037ULL;
+
+        for (; *name; name++) {
+            h ^= (unsigned char) *name;
+            h *= 1099511628211ULL;
+        }
+        id->ino = h;
+    }
+}
+
+/* Helper function to append a directory to the file's index */
+static herr_t geotiff_add_ifd(geotiff_file_t *file, uint32_t *alloc, TIFF *tiff,
+                              geotiff_image_t *image)
+{
+    uint32_t subfile_type = 0;
+
+    if (file->nifds == *alloc) {
+        uint32_t new_alloc = *alloc ? 2 * *alloc : 8;
+        geotiff_ifd_t *ifds;
+
+        if (!(ifds = (geotiff_ifd_t *) realloc(file->ifds, new_alloc * sizeof(geotiff_ifd_t))))
+            return -1;
+        file->ifds = ifds;
+        *alloc = new_alloc;
+    }
+
+    TIFFGetField(tiff, TIFFTAG_SUBFILETYPE, &subfile_type);
+    file->ifds[file->nifds].offset = TIFFCurrentDirOffset(tiff);
+    file->ifds[file->nifds].subfile_type = subfile_type;
+    file->ifds[file->nifds].is_raster = geotiff_get_image_info(tiff, image) == 0;
+    file->nifds++;
+
+    return 0;
+}
+
+/* Helper function to index every directory of the file once: the main chain
+ * in order, then the SubIFDs (where some writers keep overviews) of each.
+ * Datasets are then found, and handles moved to them, by offset. */
+static herr_t geotiff_index_ifds(geotiff_file_t *file)
+{
+    TIFF *tiff = file->tiff;
+    const geotiff_ifd_t *ifd;
+    geotiff_image_t image, first;
+    uint64_t *sub_offsets = NULL;
+    uint32_t alloc = 0, nsub = 0, sub_alloc = 0, npages = 0, i;
+    herr_t ret = -1;
+
+    file->ifds = NULL;
+    file->nifds = 0;
+    file->same_pages = 1;
+
+    do {
+        uint64_t *offsets = NULL;
+        uint16_t n = 0;
+
+        if (geotiff_add_ifd(file, &alloc, tiff, &image) < 0)
+            goto done;
+
+        /* Pages only stack when every one is laid out as the first */
+        ifd = &file->ifds[file->nifds - 1];
+        if (!(ifd->subfile_type & (FILETYPE_REDUCEDIMAGE | FILETYPE_MASK))) {
+            if (!ifd->is_raster)
+                file->same_pages = 0;
+            else if (npages++ == 0)
+                first = image;
+            else if (memcmp(&image, &first, sizeof(geotiff_image_t)) != 0)
+                file->same_pages = 0;
+        }
+
+        if (TIFFGetField(tiff, TIFFTAG_SUBIFD, &n, &offsets) && n > 0 && offsets) {
+            if (nsub + n > sub_alloc) {
+                uint64_t *grown;
+
+                sub_alloc = 2 * (nsub + n);
+                if (!(grown = (uint64_t *) realloc(sub_offsets, sub_alloc * sizeof(uint64_t))))
+                    goto done;
+                sub_offsets = grown;
+            }
+            memcpy(sub_offsets + nsub, offsets, n * sizeof(uint64_t));
+            nsub += n;
+        }
+    } while (TIFFReadDirectory(tiff));
+    file->nmain_ifds = file->nifds;
+
+    for (i = 0; i < nsub; i++)
+        if (TIFFSetSubDirectory(tiff, sub_offsets[i]) &&
+            geotiff_add_ifd(file, &alloc, tiff, &image) < 0)
+            goto done;
+
+    /* Leave the handle on the first directory, as TIFFOpen() did */
+    if (!TIFFSetSubDirectory(tiff, file->ifds[0].offset))
+        goto done;
+
+    ret = 0;
+
+done:
+    free(sub_offsets);
+
+    return ret;
+}
+
+/* Helper function to find the directories holding a dataset: "image" is the
+ * first directory, "overview_N" the Nth reduced-resolution one (in file order,
+ * which is finest first in COGs), "mask" the transparency mask of the image
+ * and "overview_N_mask" the Nth reduced-resolution mask, and "pages" every
+ * full-resolution page of a multi-page file, stacked. Returns -1 if there is
+ * no such dataset. */
+static herr_t geotiff_find_pages(const geotiff_file_t *file, const char *name, uint32_t **pages,
+                                 uint32_t *npages)
+{
+    unsigned long level;
+    uint32_t i, mask, n = 0;
+    char *end;
+
+    if (!(*pages = (uint32_t *) malloc(file->nmain_ifds * sizeof(uint32_t))))
+        return -1;
+
+    if (strcmp(name, "image") == 0) {
+        (*pages)[n++] = 0;
+    } else if (strcmp(name, "pages") == 0) {
+        for (i = 0; i < file->nmain_ifds; i++)
+            if (!(file->ifds[i].subfile_type & (FILETYPE_REDUCEDIMAGE | FILETYPE_MASK)))
+                (*pages)[n++] = i;
+        if (n < 2)
+            n = 0;
+    } else if (strcmp(name, "mask") == 0) {
+        for (i = 1; i < file->nifds; i++) {
+            if ((file->ifds[i].subfile_type & (FILETYPE_REDUCEDIMAGE | FILETYPE_MASK)) ==
+                FILETYPE_MASK) {
+                (*pages)[n++] = i;
+                break;
+            }
+        }
+    } else if (strncmp(name, "overview_", 9) == 0 && name[9] >= '1' && name[9] <= '9') {
+        level = strtoul(name + 9, &end, 10);
+        mask = strcmp(end, "_mask") == 0 ? FILETYPE_MASK : 0;
+        for (i = 1; (*end == '\0' || mask) && i < file->nifds; i++) {
+            uint32_t type = file->ifds[i].subfile_type;
+
+            if ((type & FILETYPE_REDUCEDIMAGE) && (type & FILETYPE_MASK) == mask &&
+                --level == 0) {
+                (*pages)[n++] = i;
+                break;
+            }
+        }
+    }
+
+    if (n == 0) {
+        free(*pages);
+        *pages = NULL;
+        return -1;
+    }
+    *npages = n;
+
+    return 0;
+}
+
+/* Helper function to read the raster layout of a dataset, checking that every
+ * page of a stack has the same one: from the sidecar index the file was
+ * opened from, or else through tiff, which is left on the first page */
+static herr_t geotiff_get_pages_info(const geotiff_file_t *file, TIFF *tiff,
+                                     const uint32_t *pages, uint32_t npages,
+                                     geotiff_image_t *image)
+{
+    const geotiff_image_t *indexed;
+    geotiff_image_t other;
+    uint32_t page;
+
+    if (file->index) {
+        for (page = 0; page < npages; page++) {
+            if (!(indexed = geotiff_index_image(file->index, pages[page])))
+                return -1;
+            if (page > 0 && memcmp(indexed, image, sizeof(geotiff_image_t)) != 0)
+                return -1;
+            *image = *indexed;
+        }
+        return 0;
+    }
+    if (!tiff)
+        return -1;
+
+    for (page = npages; page-- > 0;) {
+        if (!TIFFSetSubDirectory(tiff, file->ifds[pages[page]].offset))
+            return -1;
+        if (geotiff_get_image_info(tiff, page == npages - 1 ? image : &other) < 0)
+            return -1;
+        if (page < npages - 1 && memcmp(&other, image, sizeof(geotiff_image_t)) != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Asynchronous reads keep their files open until the decode tasks are done */
+static pthread_mutex_t geotiff_pending_mutex_g = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t geotiff_pending_cond_g = PTHREAD_COND_INITIALIZER;
+
+/* Helper function to wait until no asynchronous read is decoding from a file */
+static void geotiff_file_drain(geotiff_file_t *file)
+{
+    pthread_mutex_lock(&geotiff_pending_mutex_g);
+    while (file->pending > 0)
+        pthread_cond_wait(&geotiff_pending_cond_g, &geotiff_pending_mutex_g);
+    pthread_mutex_unlock(&geotiff_pending_mutex_g);
+}
+
+/* Helper function to parse the headers of a file: open its own TIFF handle
+ * and GeoTIFF handle, parse its GeoKeys and georeferencing tags, index its
+ * directories, list its datasets and set up the handle pool decoder threads
+ * share. H5Fopen() does this at once unless the file is opened lazily, when
+ * the first access that needs any of it does instead. A file whose headers
+ * fail to parse is left without them, and every such access then fails.
+ *
+ * With sidecar indexes on, the headers are read from the file's index instead
+ * when it is up to date, and no TIFF handle is opened until a chunk has to be
+ * decoded; otherwise they are parsed as usual and the index written. */
+static herr_t geotiff_file_load(geotiff_file_t *file)
+{
+    if (file->loaded != 0)
+        return file->loaded > 0 ? 0 : -1;
+    file->loaded = -1;
+
+    if (file->use_index && geotiff_index_load(file) == 0) {
+        if (geotiff_links_init(file) < 0)
+            goto error;
+        if (!(file->handles = geotiff_handles_create(file->filename, file->storage, NULL)))
+            goto error;
+        file->loaded = 1;
+        return 0;
+    }
+
+    file->tiff = geotiff_tiff_open(file->filename, file->storage);
+    if (!file->tiff)
+        return -1;
+
+    file->gtif = GTIFNew(file->tiff);
+    if (!file->gtif)
+        goto error;
+
+    /* GeoKeys and georeferencing tags of the first directory, before
+     * indexing moves the handle to the other ones */
+    if (geotiff_parse_geotiff_tags(file) < 0)
+        goto error;
+
+    /* Datasets live in other directories than the first, e.g. overviews */
+    if (geotiff_index_ifds(file) < 0)
+        goto error;
+
+    /* What the root group holds, for tools to discover */
+    if (geotiff_links_init(file) < 0)
+        goto error;
+
+    /* Next time, skip all of the above. An index that cannot be written (e.g.
+     * in a read-only directory) is no reason to fail the open. */
+    if (file->use_index)
+        geotiff_index_save(file);
+
+    /* Decoder threads share the file through a pool of TIFF handles */
+    file->handles = geotiff_handles_create(file->filename, file->storage, file->tiff);
+    if (!file->handles)
+        goto error;
+
+    file->loaded = 1;
+
+    return 0;
+
+error:
+    geotiff_index_close(file->index);
+    file->index = NULL;
+    geotiff_links_free(file);
+    free(file->ifds);
+    file->ifds = NULL;
+    file->nifds = 0;
+    file->nmain_ifds = 0;
+    geotiff_coords_free(file);
+    geotiff_meta_free(&file->meta);
+    if (file->gtif)
+        GTIFFree(file->gtif);
+    file->gtif = NULL;
+    if (file->tiff)
+        TIFFClose(file->tiff);
+    file->tiff = NULL;
+
+    return -1;
+}
+
 void *geotiff_file_open(const char *name, unsigned flags, hid_t fapl_id,
                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
 {
     geotiff_file_t *file;
+    geotiff_info_t config, *info = NULL;
 
     /* We only support read-only access for GeoTIFF files */
     /* H5F_ACC_RDONLY is 0, so we need to check that no write flags are set */
@@ -246,29 +780,58 @@ void *geotiff_file_open(const char *name, unsigned flags, hid_t fapl_id,
         return NULL;
     }
 
-    file = (geotiff_file_t *) malloc(sizeof(geotiff_file_t));
+    /* Pick up the connector info string, e.g. "threads=8". The chunk cache is
+     * shared by the whole process, so the last file opened with a budget sets it. */
+    config.threads = GEOTIFF_DEFAULT_THREADS;
+    config.cache_mb = GEOTIFF_DEFAULT_CACHE_MB;
+    config.gap_kb = GEOTIFF_DEFAULT_GAP_KB;
+    config.io = GEOTIFF_IO_PREAD;
+    config.readahead_kb = GEOTIFF_DEFAULT_READAHEAD_KB;
+    config.lazy = GEOTIFF_DEFAULT_LAZY;
+    config.index = GEOTIFF_DEFAULT_INDEX;
+    config.buffer = NULL;
+    config.buffer_size = 0;
+    if (H5Pget_vol_info(fapl_id, (void **) &info) >= 0 && info) {
+        config = *info;
+        geotiff_cache_set_budget(info->cache_mb * 1024 * 1024);
+        geotiff_info_free(info);
+    }
+
+    /* Everything the headers fill in starts out empty, for a lazy open */
+    file = (geotiff_file_t *) calloc(1, sizeof(geotiff_file_t));
     if (!file)
         return NULL;
 
-    file->tiff = TIFFOpen(name, "r");
-    if (!file->tiff) {
+    file->filename = strdup(name);
+    if (!file->filename) {
         free(file);
         return NULL;
     }
-
-    file->gtif = GTIFNew(file->tiff);
-    if (!file->gtif) {
-        TIFFClose(file->tiff);
+    file->flags = flags;
+    file->plist_id = fapl_id;
+    file->threads = config.threads;
+    file->gap = (uint64_t) config.gap_kb * 1024;
+    /* A file in memory has no place for a sidecar */
+    file->use_index = config.index && config.io != GEOTIFF_IO_MEMORY;
+    geotiff_get_file_id(name, config.io == GEOTIFF_IO_MEMORY ? config.buffer : NULL,
+                        config.buffer_size, &file->id);
+
+    /* Every TIFF handle on the file reads through the same storage backend,
+     * counting what it reads in the file's statistics */
+    file->storage = geotiff_storage_open(name, &config, &file->stats);
+    if (!file->storage) {
+        free(file->filename);
         free(file);
         return NULL;
     }
 
-    file->filename = strdup(name);
-    file->flags = flags;
-    file->plist_id = fapl_id;
-
-    /* Parse GeoTIFF metadata */
-    geotiff_parse_geotiff_tags(file);
+    /* A lazy open only checks that the file is a TIFF at all */
+    if (config.lazy ? !geotiff_storage_is_tiff(file->storage) : geotiff_file_load(file) < 0) {
+        geotiff_storage_release(file->storage);
+        free(file->filename);
+        free(file);
+        return NULL;
+    }
 
     return file;
 }
@@ -298,252 +861,715 @@ herr_t geotiff_file_get(void *file, H5VL_file_get_args_t *args,
     return 0;
 }
 
+/* File optional operations: only getting the read statistics of the file and
+ * of the process (GEOTIFF_GET_STATS_OP_NAME) */
+herr_t geotiff_file_optional(void *file, H5VL_optional_args_t *args,
+                             hid_t __attribute__((unused)) dxpl_id,
+                             void __attribute__((unused)) * *req)
+{
+    const geotiff_file_t *f = (const geotiff_file_t *) file;
+    const geotiff_get_stats_args_t *stats_args;
+
+    if (!f || geotiff_get_stats_op_g < 0 || args->op_type != geotiff_get_stats_op_g ||
+        !args->args)
+        return -1;
+
+    stats_args = (const geotiff_get_stats_args_t *) args->args;
+    if (stats_args->file)
+        geotiff_stats_get(&f->stats, stats_args->file);
+    if (stats_args->global)
+        geotiff_stats_get(NULL, stats_args->global);
+
+    return 0;
+}
+
 herr_t geotiff_file_close(void *file, hid_t __attribute__((unused)) dxpl_id,
                           void __attribute__((unused)) * *req)
 {
     geotiff_file_t *f = (geotiff_file_t *) file;
 
     if (f) {
+        geotiff_file_drain(f);
         if (f->gtif)
             GTIFFree(f->gtif);
-        if (f->tiff)
+        /* The handle pool owns f->tiff, and the storage owns f->map */
+        if (f->handles)
+            geotiff_handles_destroy(f->handles);
+        else if (f->tiff)
             TIFFClose(f->tiff);
+        geotiff_storage_release(f->storage);
         if (f->filename)
             free(f->filename);
+        geotiff_index_close(f->index);
+        geotiff_links_free(f);
+        free(f->ifds);
+        geotiff_coords_free(f);
+        geotiff_meta_free(&f->meta);
         free(f);
     }
 
     return 0;
 }
 
-/* Dataset operations */
-void *geotiff_dataset_open(void *obj, const H5VL_loc_params_t __attribute__((unused)) * loc_params,
-                           const char *name, hid_t __attribute__((unused)) dapl_id,
-                           hid_t __attribute__((unused)) dxpl_id,
-                           void __attribute__((unused)) * *req)
+/* Helper function to get the whole file in memory, mapping it once. Returns
+ * NULL where the file cannot be mapped (or is read with O_DIRECT), and reads
+ * then go through libtiff. Called with the file's own handle locked. */
+static const unsigned char *geotiff_file_map(geotiff_file_t *file)
 {
-    geotiff_file_t *file = (geotiff_file_t *) obj;
-    geotiff_dataset_t *dset;
-    uint32_t width, height;
-    uint16_t samples_per_pixel, bits_per_sample, sample_format;
-    hsize_t dims[3];
+    if (!file->map)
+        file->map = geotiff_storage_map(file->storage, &file->map_size);
 
-    if (!file || !name)
-        return NULL;
+    return file->map;
+}
 
-    dset = (geotiff_dataset_t *) malloc(sizeof(geotiff_dataset_t));
-    if (!dset)
-        return NULL;
+/* Helper function to find where the tiles or strips of the current directory
+ * of tiff are stored, and whether they are stored byte for byte as libtiff
+ * would decode them. The tables belong to libtiff, and hold while tiff stays
+ * on the directory. */
+herr_t geotiff_get_chunk_table(TIFF *tiff, const geotiff_image_t *image,
+                               geotiff_chunk_table_t *table)
+{
+    uint16_t compression, fill_order, photometric = 0;
+    uint64_t *offsets = NULL, *counts = NULL;
+    uint32_t rows_per_strip;
 
-    dset->file = file;
-    dset->name = strdup(name);
-    dset->data = NULL;
-    dset->data_size = 0;
-    dset->is_image = 0;
+    if (image->is_tiled) {
+        if (!TIFFGetField(tiff, TIFFTAG_TILEOFFSETS, &offsets) ||
+            !TIFFGetField(tiff, TIFFTAG_TILEBYTECOUNTS, &counts))
+            return -1;
+        table->nchunks = TIFFNumberOfTiles(tiff);
+        table->rows = image->chunk_height;
+        table->row_bytes = TIFFTileRowSize64(tiff);
+    } else {
+        if (!TIFFGetField(tiff, TIFFTAG_STRIPOFFSETS, &offsets) ||
+            !TIFFGetField(tiff, TIFFTAG_STRIPBYTECOUNTS, &counts))
+            return -1;
+        table->nchunks = TIFFNumberOfStrips(tiff);
+        table->row_bytes = TIFFScanlineSize64(tiff);
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+        if (rows_per_strip == 0 || rows_per_strip > image->height)
+            rows_per_strip = image->height;
+        table->rows = rows_per_strip;
+    }
+    if (!offsets || !counts)
+        return -1;
+    table->offsets = offsets;
+    table->counts = counts;
 
-    if (strcmp(name, "image") == 0) {
-        dset->is_image = 1;
+    /* libtiff would unpack subsampled YCbCr and swap bytes of other-endian files */
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_FILLORDER, &fill_order);
+    TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+    if (compression != COMPRESSION_NONE || fill_order != FILLORDER_MSB2LSB ||
+        photometric == PHOTOMETRIC_YCBCR || (image->elem_size > 1 && TIFFIsByteSwapped(tiff)))
+        table->row_bytes = 0;
 
-        if (!TIFFGetField(file->tiff, TIFFTAG_IMAGEWIDTH, &width) ||
-            !TIFFGetField(file->tiff, TIFFTAG_IMAGELENGTH, &height)) {
-            free(dset->name);
-            free(dset);
-            return NULL;
-        }
+    return 0;
+}
 
-        /* Validate image dimensions */
-        if (width == 0 || height == 0 || width > 65535 || height > 65535) {
-            free(dset->name);
-            free(dset);
-            return NULL;
-        }
+/* Helper function to find where the tiles or strips of a directory are
+ * stored, in the sidecar index the file was opened from, or else through
+ * tiff, the file's own handle (locked), which is moved to the directory */
+static herr_t geotiff_find_chunk_table(const geotiff_file_t *file, TIFF *tiff, uint32_t ifd,
+                                       const geotiff_image_t *image,
+                                       geotiff_chunk_table_t *table)
+{
+    if (file->index)
+        return geotiff_index_chunks(file->index, ifd, table);
 
-        TIFFGetFieldDefaulted(file->tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
-        TIFFGetFieldDefaulted(file->tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
-        TIFFGetFieldDefaulted(file->tiff, TIFFTAG_SAMPLEFORMAT, &sample_format);
+    if (!tiff || (TIFFCurrentDirOffset(tiff) != file->ifds[ifd].offset &&
+                  !TIFFSetSubDirectory(tiff, file->ifds[ifd].offset)))
+        return -1;
 
-        dset->type_id = geotiff_get_hdf5_type_from_tiff(sample_format, bits_per_sample);
+    return geotiff_get_chunk_table(tiff, image, table);
+}
 
-        if (samples_per_pixel > 1) {
-            dims[0] = height;
-            dims[1] = width;
-            dims[2] = samples_per_pixel;
-            dset->space_id = H5Screate_simple(3, dims, NULL);
+/* Helper function to serve an uncompressed image straight from a mapping of
+ * the file. Chunks qualify when they are stored byte for byte as libtiff would
+ * decode them. A strip too large to be one chunk keeps the bands of scanlines
+ * it would be decoded in, each a slice of the strip, unless bands would span
+ * two strips (then it is decoded as usual). */
+static void geotiff_map_image(geotiff_dataset_t *dset, const geotiff_chunk_table_t *table)
+{
+    geotiff_image_t *image = &dset->image;
+    uint64_t *raw_offsets;
+    uint64_t row, within, chunk_bytes;
+    uint32_t rows_per_strip = table->rows, nplanes, strips_per_plane, chunks_per_plane;
+    uint32_t band_rows, nchunks, rows, strip, chunk;
+
+    nplanes = image->is_separate ? image->samples_per_pixel : 1;
+    if (table->row_bytes == 0 || table->nchunks == 0 || table->nchunks % nplanes != 0 ||
+        table->row_bytes * rows_per_strip > SIZE_MAX)
+        return;
+    strips_per_plane = table->nchunks / nplanes;
+
+    band_rows = rows_per_strip;
+    chunks_per_plane = strips_per_plane;
+    if (!image->is_tiled && image->by_scanline) {
+        band_rows = image->chunk_height;
+        if (rows_per_strip % band_rows != 0 && rows_per_strip < image->height)
+            return;
+        chunks_per_plane = (uint32_t) (((uint64_t) image->height + band_rows - 1) / band_rows);
+    }
+    nchunks = chunks_per_plane * nplanes;
+
+    if (!geotiff_file_map(dset->file))
+        return;
+    if (!(raw_offsets = (uint64_t *) malloc(nchunks * sizeof(uint64_t))))
+        return;
+
+    /* Every chunk must be stored whole inside the file */
+    for (chunk = 0; chunk < nchunks; chunk++) {
+        row = (uint64_t) (chunk % chunks_per_plane) * band_rows;
+        strip = (chunk / chunks_per_plane) * strips_per_plane;
+        within = 0;
+        rows = band_rows;
+        if (!image->is_tiled) {
+            strip += (uint32_t) (row / rows_per_strip);
+            within = (row % rows_per_strip) * table->row_bytes;
+            if (row + rows > image->height)
+                rows = (uint32_t) (image->height - row);
         } else {
-            dims[0] = height;
-            dims[1] = width;
-            dset->space_id = H5Screate_simple(2, dims, NULL);
+            strip += chunk % chunks_per_plane;
         }
+        chunk_bytes = (uint64_t) rows * table->row_bytes;
 
-        if (dset->space_id < 0) {
-            free(dset->name);
-            free(dset);
-            return NULL;
+        if (strip >= table->nchunks || table->counts[strip] < within + chunk_bytes ||
+            table->offsets[strip] > dset->file->map_size ||
+            dset->file->map_size - table->offsets[strip] < within + chunk_bytes) {
+            free(raw_offsets);
+            return;
         }
+        raw_offsets[chunk] = table->offsets[strip] + within;
+    }
 
-        if (geotiff_read_image_data(file, dset) < 0) {
-            H5Sclose(dset->space_id);
-            free(dset->name);
-            free(dset);
-            return NULL;
-        }
+    /* Nothing is decoded, so bands need not be read in order either */
+    if (!image->is_tiled) {
+        image->by_scanline = 0;
+        image->chunk_height = band_rows;
+        image->chunk_size = (size_t) (table->row_bytes * band_rows);
+        image->chunks_down = chunks_per_plane;
+        image->chunks_per_plane = chunks_per_plane;
     }
 
-    return dset;
+    dset->raw_offsets = raw_offsets;
 }
 
-herr_t geotiff_dataset_read(size_t __attribute__((unused)) count, void *dset[],
-                            hid_t __attribute__((unused)) mem_type_id[],
-                            hid_t __attribute__((unused)) mem_space_id[],
-                            hid_t __attribute__((unused)) file_space_id[],
-                            hid_t __attribute__((unused)) dxpl_id, void *buf[],
-                            void __attribute__((unused)) * *req)
+/* Helper function to set up a coordinate variable as a dataset: 1-D along
+ * the columns (x) or rows (y) of the image, or 2-D over both (lon, lat), of
+ * doubles computed when read */
+static herr_t geotiff_open_coords(geotiff_dataset_t *dset, geotiff_coord_t coord)
 {
-    const geotiff_dataset_t *d = (const geotiff_dataset_t *) dset[0];
+    const geotiff_transform_t *transform = &dset->file->coords.transform;
 
-    if (!d || !d->data || !buf[0])
-        return -1;
+    dset->is_image = 0;
+    dset->coord = coord;
+    dset->type_id = H5T_NATIVE_DOUBLE;
+
+    dset->ndims = geotiff_coords_ndims(coord);
+    if (coord == GEOTIFF_COORD_X) {
+        dset->dims[0] = transform->width;
+    } else if (coord == GEOTIFF_COORD_Y) {
+        dset->dims[0] = transform->height;
+    } else {
+        dset->dims[0] = transform->height;
+        dset->dims[1] = transform->width;
+    }
 
-    memcpy(buf[0], d->data, d->data_size);
+    if ((dset->space_id = H5Screate_simple(dset->ndims, dset->dims, NULL)) < 0)
+        return -1;
+    if ((dset->dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0)
+        return -1;
 
     return 0;
 }
 
-// cppcheck-suppress constParameterCallback
-herr_t geotiff_dataset_get(void *dset, H5VL_dataset_get_args_t *args,
-                           hid_t __attribute__((unused)) dxpl_id,
-                           void __attribute__((unused)) * *req)
+/* Helper function to find the file an object is in, and the object a path
+ * names from it: the object itself for a NULL path or ".", else a path from
+ * the root group (only an absolute one from a dataset, which has no members) */
+static herr_t geotiff_resolve_path(void *obj, H5I_type_t obj_type, const char *path,
+                                   geotiff_file_t **file, uint64_t *id)
 {
-    const geotiff_dataset_t *d = (const geotiff_dataset_t *) dset;
+    const geotiff_dataset_t *dset = NULL;
 
-    switch (args->op_type) {
-        case H5VL_DATASET_GET_SPACE:
-            args->args.get_space.space_id = d->space_id;
+    switch (obj_type) {
+        case H5I_FILE:
+            *file = (geotiff_file_t *) obj;
             break;
-        case H5VL_DATASET_GET_TYPE:
-            args->args.get_type.type_id = d->type_id;
+        case H5I_GROUP:
+            *file = ((geotiff_group_t *) obj)->file;
+            break;
+        case H5I_DATASET:
+            dset = (const geotiff_dataset_t *) obj;
+            *file = dset->file;
             break;
         default:
             return -1;
     }
+    /* Finding anything in a file opened lazily parses its headers first */
+    if (!*file || geotiff_file_load(*file) < 0)
+        return -1;
 
-    return 0;
+    if (!path || strcmp(path, ".") == 0) {
+        if (!dset) {
+            *id = GEOTIFF_ROOT_ID;
+            return 0;
+        }
+        return geotiff_links_lookup(*file, dset->name, id);
+    }
+    if (dset && *path != '/')
+        return -1;
+
+    return geotiff_links_lookup(*file, path, id);
 }
 
-herr_t geotiff_dataset_close(void *dset, hid_t __attribute__((unused)) dxpl_id,
-                             void __attribute__((unused)) * *req)
+/* Helper function to find the object a location names: the object itself, a
+ * path from it, the nth link of a group, or an object token */
+static herr_t geotiff_resolve_loc(void *obj, const H5VL_loc_params_t *loc_params,
+                                  geotiff_file_t **file, uint64_t *id)
 {
-    geotiff_dataset_t *d = (geotiff_dataset_t *) dset;
-
-    if (d) {
-        if (d->name)
-            free(d->name);
-        if (d->data)
-            free(d->data);
-        free(d);
+    const H5VL_loc_by_idx_t *by_idx = &loc_params->loc_data.loc_by_idx;
+    uint64_t group;
+
+    switch (loc_params->type) {
+        case H5VL_OBJECT_BY_SELF:
+            return geotiff_resolve_path(obj, loc_params->obj_type, NULL, file, id);
+        case H5VL_OBJECT_BY_NAME:
+            return geotiff_resolve_path(obj, loc_params->obj_type,
+                                        loc_params->loc_data.loc_by_name.name, file, id);
+        case H5VL_OBJECT_BY_IDX:
+            if (geotiff_resolve_path(obj, loc_params->obj_type, by_idx->name, file, &group) < 0 ||
+                group != GEOTIFF_ROOT_ID)
+                return -1;
+            return geotiff_links_get(*file, by_idx->idx_type, by_idx->order, by_idx->n, id);
+        case H5VL_OBJECT_BY_TOKEN:
+            if (geotiff_resolve_path(obj, loc_params->obj_type, NULL, file, id) < 0)
+                return -1;
+            return geotiff_links_token_id(*file, loc_params->loc_data.loc_by_token.token, id);
+        default:
+            return -1;
     }
-
-    return 0;
 }
 
-/* Group operations */
-void *geotiff_group_open(void *obj, const H5VL_loc_params_t __attribute__((unused)) * loc_params,
-                         const char *name, hid_t __attribute__((unused)) gapl_id,
-                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
-{
-    geotiff_file_t *file = (geotiff_file_t *) obj;
-    geotiff_group_t *grp;
-
-    if (!file || !name)
+/* Dataset operations */
+void *geotiff_dataset_open(void *obj, const H5VL_loc_params_t *loc_params, const char *name,
+                           hid_t __attribute__((unused)) dapl_id,
+                           hid_t __attribute__((unused)) dxpl_id,
+                           void __attribute__((unused)) * *req)
+{
+    geotiff_file_t *file = NULL;
+    geotiff_dataset_t *dset;
+    const geotiff_image_t *image;
+    geotiff_chunk_table_t table;
+    TIFF *tiff;
+    hsize_t extent[GEOTIFF_NAXES], chunk_extent[GEOTIFF_NAXES];
+    char path[GEOTIFF_LINK_NAME_LEN + 8], *base = NULL;
+    uint64_t id;
+    size_t len;
+    int band_first = 0, coord, d;
+
+    if (!obj || !loc_params || !name)
         return NULL;
 
-    if (strcmp(name, "/") != 0)
+    /* Only the datasets of the root group's namespace open, by the name
+     * listed there */
+    if (geotiff_resolve_path(obj, loc_params->obj_type, name, &file, &id) < 0 ||
+        id == GEOTIFF_ROOT_ID)
         return NULL;
+    geotiff_links_path(file, id, path, sizeof(path));
+    name = path + 1;
 
-    grp = (geotiff_group_t *) malloc(sizeof(geotiff_group_t));
-    if (!grp)
+    dset = (geotiff_dataset_t *) calloc(1, sizeof(geotiff_dataset_t));
+    if (!dset)
         return NULL;
 
-    grp->file = file;
-    grp->name = strdup(name);
+    dset->file = file;
+    dset->space_id = H5I_INVALID_HID;
+    dset->dcpl_id = H5I_INVALID_HID;
+    dset->is_image = 1;
+    image = &dset->image;
+
+    if (!(dset->name = strdup(name)))
+        goto error;
+
+    /* "x" and "y", or "lon" and "lat", are computed from the geotransform */
+    if ((coord = geotiff_coords_find(file, name)) >= 0) {
+        if (geotiff_open_coords(dset, (geotiff_coord_t) coord) < 0)
+            goto error;
+        return dset;
+    }
 
-    return grp;
+    /* "image", one of its overviews, or the stack of all pages, each also
+     * readable band-sequentially as "<name>_bsq" */
+    if (!(base = strdup(name)))
+        goto error;
+    len = strlen(base);
+    if (len > 4 && strcmp(base + len - 4, "_bsq") == 0) {
+        base[len - 4] = '\0';
+        band_first = 1;
+    }
+    if (geotiff_find_pages(file, base, &dset->pages, &dset->npages) < 0)
+        goto error;
+
+    /* Only the raster layout is read here; pixels are decoded on demand in
+     * geotiff_dataset_read(). Other threads may be reading from the file. A
+     * file opened from its sidecar index needs no TIFF handle for it. */
+    geotiff_handles_lock(file->handles);
+    tiff = file->index ? NULL : geotiff_handles_own(file->handles);
+    if (geotiff_get_pages_info(file, tiff, dset->pages, dset->npages, &dset->image) < 0) {
+        geotiff_handles_unlock(file->handles);
+        goto error;
+    }
+
+    /* Uncompressed chunks of a single image need no decoding at all */
+    if (dset->npages == 1 &&
+        geotiff_find_chunk_table(file, tiff, dset->pages[0], image, &table) == 0)
+        geotiff_map_image(dset, &table);
+    geotiff_handles_unlock(file->handles);
+
+    dset->type_id = geotiff_get_hdf5_type_from_tiff(image->sample_format, image->bits_per_sample);
+
+    /* [page,] y, x [, band], or [page,] [band,] y, x band-sequentially: a
+     * stack has a page dimension, and a pixel of several samples a band
+     * dimension */
+    extent[GEOTIFF_AXIS_PAGE] = dset->npages;
+    extent[GEOTIFF_AXIS_Y] = image->height;
+    extent[GEOTIFF_AXIS_X] = image->width;
+    extent[GEOTIFF_AXIS_BAND] = image->samples_per_pixel;
+    if (dset->npages > 1)
+        dset->axes[dset->ndims++] = GEOTIFF_AXIS_PAGE;
+    if (image->samples_per_pixel > 1 && band_first)
+        dset->axes[dset->ndims++] = GEOTIFF_AXIS_BAND;
+    dset->axes[dset->ndims++] = GEOTIFF_AXIS_Y;
+    dset->axes[dset->ndims++] = GEOTIFF_AXIS_X;
+    if (image->samples_per_pixel > 1 && !band_first)
+        dset->axes[dset->ndims++] = GEOTIFF_AXIS_BAND;
+
+    /* Each tile or strip of a page (and band plane) is one HDF5 chunk; a tile
+     * wider or taller than the image is the only chunk along that dimension */
+    chunk_extent[GEOTIFF_AXIS_PAGE] = 1;
+    chunk_extent[GEOTIFF_AXIS_Y] =
+        image->chunk_height < image->height ? image->chunk_height : image->height;
+    chunk_extent[GEOTIFF_AXIS_X] =
+        image->chunk_width < image->width ? image->chunk_width : image->width;
+    chunk_extent[GEOTIFF_AXIS_BAND] = image->is_separate ? 1 : image->samples_per_pixel;
+
+    for (d = 0; d < dset->ndims; d++) {
+        dset->dims[d] = extent[dset->axes[d]];
+        dset->chunk_dims[d] = chunk_extent[dset->axes[d]];
+    }
+
+    if ((dset->space_id = H5Screate_simple(dset->ndims, dset->dims, NULL)) < 0)
+        goto error;
+    if ((dset->dcpl_id = H5Pcreate(H5P_DATASET_CREATE)) < 0 ||
+        H5Pset_chunk(dset->dcpl_id, dset->ndims, dset->chunk_dims) < 0)
+        goto error;
+
+    free(base);
+
+    return dset;
+
+error:
+    free(base);
+    geotiff_dataset_close(dset, H5P_DEFAULT, NULL);
+
+    return NULL;
 }
 
-herr_t geotiff_group_get(void __attribute__((unused)) * obj,
-                         H5VL_group_get_args_t __attribute__((unused)) * args,
-                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+herr_t geotiff_dataset_read(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[],
+                            hid_t file_space_id[], hid_t __attribute__((unused)) dxpl_id,
+                            void *buf[], void **req)
+{
+    geotiff_dataset_t **dsets = (geotiff_dataset_t **) dset;
+    hid_t *ids;
+    void **ptrs = NULL;
+    size_t nimages = 0, i;
+    herr_t ret = -1;
+
+    /* All image datasets of a multi-dataset read are decoded in one pass, in
+     * the background when there is a request to hand back */
+    for (i = 0; i < count; i++)
+        if (dsets[i] && !dsets[i]->is_image)
+            break;
+    if (i == count)
+        return geotiff_read_image_data(count, dsets, mem_type_id, mem_space_id, file_space_id, buf,
+                                       req);
+
+    /* Coordinate variables are computed right away, and the images among
+     * the datasets read as above */
+    if (req)
+        *req = NULL;
+    if (!(ids = (hid_t *) malloc(count * 3 * sizeof(hid_t))))
+        return -1;
+    if (!(ptrs = (void **) malloc(count * 2 * sizeof(void *))))
+        goto done;
+
+    for (i = 0; i < count; i++) {
+        if (dsets[i] && !dsets[i]->is_image) {
+            if (geotiff_read_coords_data(dsets[i], mem_type_id[i], mem_space_id[i],
+                                         file_space_id[i], buf[i]) < 0)
+                goto done;
+            continue;
+        }
+        ptrs[nimages] = dsets[i];
+        ptrs[count + nimages] = buf[i];
+        ids[nimages] = mem_type_id[i];
+        ids[count + nimages] = mem_space_id[i];
+        ids[2 * count + nimages] = file_space_id[i];
+        nimages++;
+    }
+
+    if (nimages > 0 &&
+        geotiff_read_image_data(nimages, (geotiff_dataset_t **) ptrs, ids, ids + count,
+                                ids + 2 * count, ptrs + count, req) < 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    free(ptrs);
+    free(ids);
+
+    return ret;
+}
+
+/* Helper function to find the file offset and stored size of every chunk of
+ * every page, once. HDF5 chunks are TIFF tiles or strips except in images
+ * streamed by scanline, whose strips span many chunks. The index is only
+ * published once complete, and never changes after. */
+static herr_t geotiff_load_chunk_index(geotiff_dataset_t *dset)
 {
+    const geotiff_image_t *image = &dset->image;
+    geotiff_file_t *file = dset->file;
+    geotiff_chunk_table_t table;
+    uint32_t nchunks, page, chunk;
+    const uint64_t *offsets, *counts;
+    uint64_t *stored_offsets = NULL, *stored_sizes = NULL;
+    hsize_t nstored = 0;
+    TIFF *tiff;
+
+    if (!dset->is_image || image->by_scanline)
+        return -1;
+
+    geotiff_handles_lock(file->handles);
+    if (dset->stored_sizes)
+        goto done;
+    tiff = file->index ? NULL : geotiff_handles_own(file->handles);
+
+    nchunks = image->chunks_per_plane * (image->is_separate ? image->samples_per_pixel : 1);
+    if (!(stored_offsets = (uint64_t *) malloc((size_t) dset->npages * nchunks *
+                                               sizeof(uint64_t))) ||
+        !(stored_sizes = (uint64_t *) malloc((size_t) dset->npages * nchunks * sizeof(uint64_t))))
+        goto error;
+
+    for (page = 0; page < dset->npages; page++) {
+        if (geotiff_find_chunk_table(file, tiff, dset->pages[page], image, &table) < 0 ||
+            table.nchunks != nchunks)
+            goto error;
+        offsets = table.offsets;
+        counts = table.counts;
+
+        /* Sparse files (e.g. GDAL's SPARSE_OK) leave empty chunks unwritten */
+        for (chunk = 0; chunk < nchunks; chunk++) {
+            size_t i = (size_t) page * nchunks + chunk;
+
+            stored_offsets[i] = counts[chunk] ? offsets[chunk] : 0;
+            stored_sizes[i] = counts[chunk];
+            if (counts[chunk])
+                nstored++;
+        }
+    }
+
+    dset->stored_offsets = stored_offsets;
+    dset->nstored = nstored;
+    dset->stored_sizes = stored_sizes;
+
+done:
+    geotiff_handles_unlock(file->handles);
+
     return 0;
+
+error:
+    geotiff_handles_unlock(file->handles);
+    free(stored_offsets);
+    free(stored_sizes);
+
+    return -1;
 }
 
-herr_t geotiff_group_close(void *grp, hid_t __attribute__((unused)) dxpl_id,
-                           void __attribute__((unused)) * *req)
+/* Helper function to get the position in the chunk index of the chunk at
+ * grid coordinates grid[] (chunk offsets divided by the chunk extents) */
+static size_t geotiff_chunk_index_pos(const geotiff_dataset_t *dset, const hsize_t *grid)
 {
-    geotiff_group_t *g = (geotiff_group_t *) grp;
+    const geotiff_image_t *image = &dset->image;
+    hsize_t c[GEOTIFF_NAXES] = {0, 0, 0, 0};
+    uint32_t nplanes = image->is_separate ? image->samples_per_pixel : 1;
+    int d;
+
+    for (d = 0; d < dset->ndims; d++)
+        c[dset->axes[d]] = grid[d];
+
+    /* A chunk of an interleaved image holds every band */
+    return ((size_t) c[GEOTIFF_AXIS_PAGE] * nplanes +
+            (size_t) (image->is_separate ? c[GEOTIFF_AXIS_BAND] : 0)) *
+               image->chunks_per_plane +
+           (size_t) c[GEOTIFF_AXIS_Y] * image->chunks_across + (size_t) c[GEOTIFF_AXIS_X];
+}
 
-    if (g) {
-        if (g->name)
-            free(g->name);
-        free(g);
+/* Helper function to find the chunk whose first element is at offset[].
+ * Returns -1 if offset[] is not the corner of a chunk. */
+static herr_t geotiff_find_chunk(const geotiff_dataset_t *dset, const hsize_t *offset,
+                                 size_t *pos)
+{
+    hsize_t grid[GEOTIFF_NAXES];
+    int d;
+
+    if (!offset)
+        return -1;
+    for (d = 0; d < dset->ndims; d++) {
+        if (offset[d] >= dset->dims[d] || offset[d] % dset->chunk_dims[d] != 0)
+            return -1;
+        grid[d] = offset[d] / dset->chunk_dims[d];
     }
+    *pos = geotiff_chunk_index_pos(dset, grid);
 
     return 0;
 }
 
-/* Attribute operations */
-void *geotiff_attr_open(void *obj, const H5VL_loc_params_t __attribute__((unused)) * loc_params,
-                        const char *name, hid_t __attribute__((unused)) aapl_id,
-                        hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+/* Helper function to find the nth chunk with data, counting in row-major
+ * order of the chunk grid as the native chunk index does, and its offset.
+ * Returns -1 if there are not that many. */
+static herr_t geotiff_find_nth_chunk(const geotiff_dataset_t *dset, hsize_t n, size_t *pos,
+                                     hsize_t *offset)
 {
-    geotiff_file_t *file = (geotiff_file_t *) obj;
-    geotiff_attr_t *attr;
+    hsize_t grid[GEOTIFF_NAXES], ngrid[GEOTIFF_NAXES], total = 1, rank, i;
+    int d;
 
-    if (!file || !name)
-        return NULL;
+    if (n >= dset->nstored)
+        return -1;
 
-    attr = (geotiff_attr_t *) malloc(sizeof(geotiff_attr_t));
-    if (!attr)
-        return NULL;
+    for (d = 0; d < dset->ndims; d++) {
+        ngrid[d] = (dset->dims[d] + dset->chunk_dims[d] - 1) / dset->chunk_dims[d];
+        total *= ngrid[d];
+    }
 
-    attr->file = file;
-    attr->name = strdup(name);
-    attr->data = NULL;
-    attr->data_size = 0;
-    attr->type_id = H5T_NATIVE_CHAR;
-    attr->space_id = H5Screate(H5S_SCALAR);
+    /* Without sparse chunks the nth chunk is the nth in the grid; otherwise
+     * the grid is walked, skipping the empty ones */
+    for (i = dset->nstored == total ? n : 0, rank = 0; i < total; i++) {
+        hsize_t rest = i;
 
-    return attr;
+        for (d = dset->ndims - 1; d >= 0; d--) {
+            grid[d] = rest % ngrid[d];
+            rest /= ngrid[d];
+        }
+        *pos = geotiff_chunk_index_pos(dset, grid);
+        if (dset->nstored == total || (dset->stored_sizes[*pos] && rank++ == n))
+            break;
+    }
+    if (i == total)
+        return -1;
+
+    if (offset)
+        for (d = 0; d < dset->ndims; d++)
+            offset[d] = grid[d] * dset->chunk_dims[d];
+
+    return 0;
 }
 
-// cppcheck-suppress constParameterCallback
-herr_t geotiff_attr_read(void *attr, hid_t __attribute__((unused)) mem_type_id, void *buf,
-                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+/* Helper function to add up the stored sizes of every chunk */
+static herr_t geotiff_get_storage_size(geotiff_dataset_t *dset, hsize_t *size)
 {
-    const geotiff_attr_t *a = (const geotiff_attr_t *) attr;
+    size_t i, n;
 
-    if (!a || !buf)
+    if (!size || geotiff_load_chunk_index(dset) < 0)
         return -1;
 
-    if (a->data && a->data_size > 0) {
-        memcpy(buf, a->data, a->data_size);
-    }
+    n = (size_t) dset->npages * dset->image.chunks_per_plane *
+        (dset->image.is_separate ? dset->image.samples_per_pixel : 1);
+    *size = 0;
+    for (i = 0; i < n; i++)
+        *size += dset->stored_sizes[i];
 
     return 0;
 }
 
+/* Helper function to copy the bytes of a chunk as stored in the file, i.e.
+ * still compressed with the image's TIFF compression */
+static herr_t geotiff_read_raw_chunk(geotiff_dataset_t *dset, size_t pos, void *buf)
+{
+    const geotiff_image_t *image = &dset->image;
+    geotiff_file_t *file = dset->file;
+    uint64_t offset = dset->stored_offsets[pos], size = dset->stored_sizes[pos];
+    uint32_t nchunks, page, chunk;
+    const unsigned char *map;
+    herr_t ret = -1;
+    TIFF *tiff;
+
+    if (size == 0 || !buf)
+        return -1;
+
+    /* Straight from the file mapping, or through libtiff where there is none */
+    geotiff_handles_lock(file->handles);
+    if ((map = geotiff_file_map(file)) && offset <= file->map_size &&
+        file->map_size - offset >= size) {
+        geotiff_handles_unlock(file->handles);
+        memcpy(buf, map + offset, (size_t) size);
+        return 0;
+    }
+
+    nchunks = image->chunks_per_plane * (image->is_separate ? image->samples_per_pixel : 1);
+    page = (uint32_t) (pos / nchunks);
+    chunk = (uint32_t) (pos % nchunks);
+    if (!(tiff = geotiff_handles_own(file->handles)))
+        goto done;
+    if (TIFFCurrentDirOffset(tiff) != file->ifds[dset->pages[page]].offset &&
+        !TIFFSetSubDirectory(tiff, file->ifds[dset->pages[page]].offset))
+        goto done;
+    if (image->is_tiled) {
+        if (TIFFReadRawTile(tiff, chunk, buf, (tmsize_t) size) != (tmsize_t) size)
+            goto done;
+    } else {
+        if (TIFFReadRawStrip(tiff, chunk, buf, (tmsize_t) size) != (tmsize_t) size)
+            goto done;
+    }
+    ret = 0;
+
+done:
+    geotiff_handles_unlock(file->handles);
+
+    return ret;
+}
+
 // cppcheck-suppress constParameterCallback
-herr_t geotiff_attr_get(void *obj, H5VL_attr_get_args_t *args,
-                        hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+herr_t geotiff_dataset_get(void *dset, H5VL_dataset_get_args_t *args,
+                           hid_t __attribute__((unused)) dxpl_id,
+                           void __attribute__((unused)) * *req)
 {
-    const geotiff_attr_t *a = (const geotiff_attr_t *) obj;
+    const geotiff_dataset_t *d = (const geotiff_dataset_t *) dset;
 
+    /* The caller owns (and closes) the returned IDs, so hand out copies */
     switch (args->op_type) {
-        case H5VL_ATTR_GET_SPACE:
-            args->args.get_space.space_id = a->space_id;
+        case H5VL_DATASET_GET_SPACE:
+            if ((args->args.get_space.space_id = H5Scopy(d->space_id)) < 0)
+                return -1;
             break;
-        case H5VL_ATTR_GET_TYPE:
-            args->args.get_type.type_id = a->type_id;
+        case H5VL_DATASET_GET_TYPE:
+            if ((args->args.get_type.type_id = H5Tcopy(d->type_id)) < 0)
+                return -1;
+            break;
+        case H5VL_DATASET_GET_DCPL:
+            if ((args->args.get_dcpl.dcpl_id = H5Pcopy(d->dcpl_id)) < 0)
+                return -1;
+            break;
+        case H5VL_DATASET_GET_STORAGE_SIZE:
+            /* Coordinate variables are never stored */
+            if (!d->is_image) {
+                *args->args.get_storage_size.storage_size = 0;
+                break;
+            }
+            if (geotiff_get_storage_size((geotiff_dataset_t *) dset,
+                                         args->args.get_storage_size.storage_size) < 0)
+                return -1;
             break;
         default:
             return -1;
@@ -552,107 +1578,2479 @@ herr_t geotiff_attr_get(void *obj, H5VL_attr_get_args_t *args,
     return 0;
 }
 
-herr_t geotiff_attr_close(void *attr, hid_t __attribute__((unused)) dxpl_id,
-                          void __attribute__((unused)) * *req)
+/* Chunk queries and direct chunk reads (H5Dget_num_chunks(),
+ * H5Dget_chunk_info(), H5Dget_chunk_info_by_coord(),
+ * H5Dget_chunk_storage_size(), H5Dread_chunk()) over the TIFF tiles or strips.
+ * Chunks are reported with their TIFF file offsets and stored sizes, a filter
+ * mask of 0, and read as stored: still compressed, byte order and predictor
+ * as in the file. The native connector ignores the selection passed to the
+ * first two, and so does this one. */
+herr_t geotiff_dataset_optional(void *obj, H5VL_optional_args_t *args,
+                                hid_t __attribute__((unused)) dxpl_id,
+                                void __attribute__((unused)) * *req)
 {
-    geotiff_attr_t *a = (geotiff_attr_t *) attr;
+    geotiff_dataset_t *dset = (geotiff_dataset_t *) obj;
+    H5VL_native_dataset_optional_args_t *opt_args =
+        (H5VL_native_dataset_optional_args_t *) args->args;
+    size_t pos;
 
-    if (a) {
-        if (a->name)
-            free(a->name);
-        if (a->data)
-            free(a->data);
-        free(a);
+    if (geotiff_load_chunk_index(dset) < 0)
+        return -1;
+
+    switch (args->op_type) {
+        case H5VL_NATIVE_DATASET_GET_NUM_CHUNKS:
+            *opt_args->get_num_chunks.nchunks = dset->nstored;
+            break;
+
+        case H5VL_NATIVE_DATASET_GET_CHUNK_INFO_BY_IDX: {
+            H5VL_native_dataset_get_chunk_info_by_idx_t *info = &opt_args->get_chunk_info_by_idx;
+
+            if (geotiff_find_nth_chunk(dset, info->chk_index, &pos, info->offset) < 0)
+                return -1;
+            if (info->filter_mask)
+                *info->filter_mask = 0;
+            if (info->addr)
+                *info->addr = (haddr_t) dset->stored_offsets[pos];
+            if (info->size)
+                *info->size = dset->stored_sizes[pos];
+            break;
+        }
+
+        case H5VL_NATIVE_DATASET_GET_CHUNK_INFO_BY_COORD: {
+            H5VL_native_dataset_get_chunk_info_by_coord_t *info =
+                &opt_args->get_chunk_info_by_coord;
+
+            if (geotiff_find_chunk(dset, info->offset, &pos) < 0)
+                return -1;
+            if (info->filter_mask)
+                *info->filter_mask = 0;
+            if (info->addr)
+                *info->addr = dset->stored_sizes[pos] ? (haddr_t) dset->stored_offsets[pos]
+                                                      : HADDR_UNDEF;
+            if (info->size)
+                *info->size = dset->stored_sizes[pos];
+            break;
+        }
+
+        case H5VL_NATIVE_DATASET_GET_CHUNK_STORAGE_SIZE:
+            if (geotiff_find_chunk(dset, opt_args->get_chunk_storage_size.offset, &pos) < 0)
+                return -1;
+            *opt_args->get_chunk_storage_size.size = dset->stored_sizes[pos];
+            break;
+
+        case H5VL_NATIVE_DATASET_CHUNK_READ:
+            /* The buffer must hold H5Dget_chunk_storage_size() bytes */
+            if (geotiff_find_chunk(dset, opt_args->chunk_read.offset, &pos) < 0 ||
+                geotiff_read_raw_chunk(dset, pos, opt_args->chunk_read.buf) < 0)
+                return -1;
+            opt_args->chunk_read.filters = 0;
+            break;
+
+        default:
+            return -1;
     }
 
     return 0;
 }
 
-/* Helper function to read image data from TIFF */
-herr_t geotiff_read_image_data(geotiff_file_t *file, geotiff_dataset_t *dset)
+herr_t geotiff_dataset_close(void *dset, hid_t __attribute__((unused)) dxpl_id,
+                             void __attribute__((unused)) * *req)
 {
-    uint32_t width, height;
-    uint16_t samples_per_pixel, bits_per_sample;
-    tsize_t scanline_size;
-    uint32_t row;
-    unsigned char *image_data;
+    geotiff_dataset_t *d = (geotiff_dataset_t *) dset;
 
-    if (!file || !file->tiff || !dset) {
-        return -1;
+    if (d) {
+        /* Asynchronous reads of the dataset may still be copying out of it */
+        if (d->is_image && d->file)
+            geotiff_file_drain(d->file);
+        if (d->name)
+            free(d->name);
+        if (d->space_id >= 0)
+            H5Sclose(d->space_id);
+        if (d->dcpl_id >= 0)
+            H5Pclose(d->dcpl_id);
+        free(d->raw_offsets);
+        free(d->stored_offsets);
+        free(d->stored_sizes);
+        free(d->pages);
+        free(d);
     }
 
-    if (!TIFFGetField(file->tiff, TIFFTAG_IMAGEWIDTH, &width) ||
-        !TIFFGetField(file->tiff, TIFFTAG_IMAGELENGTH, &height)) {
-        return -1;
+    return 0;
+}
+
+/* Group operations: the root group is the only one */
+void *geotiff_group_open(void *obj, const H5VL_loc_params_t *loc_params, const char *name,
+                         hid_t __attribute__((unused)) gapl_id,
+                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    geotiff_file_t *file = NULL;
+    geotiff_group_t *grp;
+    uint64_t id;
+
+    if (!obj || !loc_params || !name)
+        return NULL;
+
+    if (geotiff_resolve_path(obj, loc_params->obj_type, name, &file, &id) < 0 ||
+        id != GEOTIFF_ROOT_ID)
+        return NULL;
+
+    grp = (geotiff_group_t *) malloc(sizeof(geotiff_group_t));
+    if (!grp)
+        return NULL;
+
+    grp->file = file;
+    grp->name = strdup("/");
+
+    return grp;
+}
+
+// cppcheck-suppress constParameterCallback
+herr_t geotiff_group_get(void *obj, H5VL_group_get_args_t *args,
+                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    geotiff_file_t *file = NULL;
+    H5G_info_t *ginfo;
+    uint64_t id;
+
+    /* The caller owns (and closes) the returned IDs, so hand out copies */
+    switch (args->op_type) {
+        case H5VL_GROUP_GET_GCPL:
+            if ((args->args.get_gcpl.gcpl_id = H5Pcreate(H5P_GROUP_CREATE)) < 0)
+                return -1;
+            break;
+        case H5VL_GROUP_GET_INFO:
+            /* The links of the root group, held compactly in memory, without
+             * creation order */
+            if (geotiff_resolve_loc(obj, &args->args.get_info.loc_params, &file, &id) < 0 ||
+                id != GEOTIFF_ROOT_ID)
+                return -1;
+            ginfo = args->args.get_info.ginfo;
+            ginfo->storage_type = H5G_STORAGE_TYPE_COMPACT;
+            ginfo->nlinks = file->nlinks;
+            ginfo->max_corder = 0;
+            ginfo->mounted = 0;
+            break;
+        default:
+            return -1;
     }
 
-    /* Validate reasonable image dimensions */
-    if (width == 0 || height == 0 || width > 65535 || height > 65535) {
-        return -1;
+    return 0;
+}
+
+herr_t geotiff_group_close(void *grp, hid_t __attribute__((unused)) dxpl_id,
+                           void __attribute__((unused)) * *req)
+{
+    geotiff_group_t *g = (geotiff_group_t *) grp;
+
+    if (g) {
+        if (g->name)
+            free(g->name);
+        free(g);
     }
 
-    TIFFGetFieldDefaulted(file->tiff, TIFFTAG_SAMPLESPERPIXEL, &samples_per_pixel);
-    TIFFGetFieldDefaulted(file->tiff, TIFFTAG_BITSPERSAMPLE, &bits_per_sample);
+    return 0;
+}
 
-    scanline_size = TIFFScanlineSize(file->tiff);
-    if (scanline_size <= 0) {
-        return -1;
+/* Helper function to open an object of a file as the connector's object for
+ * it, setting its type */
+static void *geotiff_open_object(geotiff_file_t *file, uint64_t id, H5I_type_t *type)
+{
+    H5VL_loc_params_t loc_params;
+    char path[GEOTIFF_LINK_NAME_LEN + 8];
+
+    loc_params.obj_type = H5I_FILE;
+    loc_params.type = H5VL_OBJECT_BY_SELF;
+    geotiff_links_path(file, id, path, sizeof(path));
+
+    *type = id == GEOTIFF_ROOT_ID ? H5I_GROUP : H5I_DATASET;
+    if (*type == H5I_GROUP)
+        return geotiff_group_open(file, &loc_params, path, H5P_DEFAULT, H5P_DEFAULT, NULL);
+
+    return geotiff_dataset_open(file, &loc_params, path, H5P_DEFAULT, H5P_DEFAULT, NULL);
+}
+
+/* Helper function to open an object of a file and register an ID for it, as
+ * the native connector does for the object passed to iteration callbacks.
+ * The caller releases it with H5Idec_ref(). */
+static hid_t geotiff_register_object(geotiff_file_t *file, uint64_t id)
+{
+    H5I_type_t type;
+    hid_t obj_id;
+    void *obj;
+
+    if (!(obj = geotiff_open_object(file, id, &type)))
+        return H5I_INVALID_HID;
+
+    if ((obj_id = H5VLwrap_register(obj, type)) < 0) {
+        if (type == H5I_GROUP)
+            geotiff_group_close(obj, H5P_DEFAULT, NULL);
+        else
+            geotiff_dataset_close(obj, H5P_DEFAULT, NULL);
     }
 
-    /* Validate reasonable data size to prevent memory issues */
-    size_t total_size = (size_t) height * (size_t) scanline_size;
-    if (total_size > 100 * 1024 * 1024) { /* 100MB limit */
+    return obj_id;
+}
+
+/* Helper function to get the attribute catalog of an object: the GeoTIFF
+ * metadata of the root group, or a coordinate variable's. Returns NULL for
+ * objects without attributes. */
+static const geotiff_meta_t *geotiff_object_meta(const geotiff_file_t *file, uint64_t id)
+{
+    int coord;
+
+    if (id == GEOTIFF_ROOT_ID)
+        return &file->meta;
+    if ((id & 1) || file->links[GEOTIFF_ID_LINK(id)].is_raster)
+        return NULL;
+    if ((coord = geotiff_coords_find(file, file->links[GEOTIFF_ID_LINK(id)].name)) < 0)
+        return NULL;
+
+    return &file->coords.meta[coord];
+}
+
+/* Helper function to describe an object of a file as H5Oget_info3() does.
+ * Objects are never modified, and have no times. */
+static void geotiff_get_object_info(const geotiff_file_t *file, uint64_t id, unsigned fields,
+                                    H5O_info2_t *oinfo)
+{
+    const geotiff_meta_t *meta = geotiff_object_meta(file, id);
+
+    memset(oinfo, 0, sizeof(H5O_info2_t));
+    oinfo->fileno = (unsigned long) (file->id.dev ^ file->id.ino);
+    geotiff_links_token(id, &oinfo->token);
+    oinfo->type = id == GEOTIFF_ROOT_ID ? H5O_TYPE_GROUP : H5O_TYPE_DATASET;
+    oinfo->rc = 1;
+    if ((fields & H5O_INFO_NUM_ATTRS) && meta)
+        oinfo->num_attrs = meta->nentries;
+}
+
+/* Link operations: every link is a hard link from the root group to one of
+ * its datasets. The "<name>_bsq" views resolve like links, but are not
+ * listed. */
+// cppcheck-suppress constParameterCallback
+herr_t geotiff_link_get(void *obj, const H5VL_loc_params_t *loc_params, H5VL_link_get_args_t *args,
+                        hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    geotiff_file_t *file = NULL;
+    H5L_info2_t *linfo;
+    char path[GEOTIFF_LINK_NAME_LEN + 8];
+    size_t len;
+    uint64_t id;
+
+    if (!obj || !loc_params || geotiff_resolve_loc(obj, loc_params, &file, &id) < 0 ||
+        id == GEOTIFF_ROOT_ID)
         return -1;
+
+    switch (args->op_type) {
+        case H5VL_LINK_GET_INFO:
+            linfo = args->args.get_info.linfo;
+            memset(linfo, 0, sizeof(H5L_info2_t));
+            linfo->type = H5L_TYPE_HARD;
+            linfo->corder_valid = 0;
+            linfo->cset = H5T_CSET_ASCII;
+            geotiff_links_token(id, &linfo->u.token);
+            break;
+        case H5VL_LINK_GET_NAME:
+            len = geotiff_links_path(file, id, path, sizeof(path)) - 1;
+            if (args->args.get_name.name && args->args.get_name.name_size > 0) {
+                size_t ncopy = len < args->args.get_name.name_size
+                                   ? len
+                                   : args->args.get_name.name_size - 1;
+                memcpy(args->args.get_name.name, path + 1, ncopy);
+                args->args.get_name.name[ncopy] = '\0';
+            }
+            if (args->args.get_name.name_len)
+                *args->args.get_name.name_len = len;
+            break;
+        default:
+            /* There are no soft or external links to get the value of */
+            return -1;
     }
 
-    dset->data_size = total_size;
-    dset->data = malloc(dset->data_size);
+    return 0;
+}
 
-    if (!dset->data)
+/* Link specific operations: checking whether a link exists, and iterating
+ * over (or visiting, which is the same with no subgroups) the links of the
+ * root group in name order. Iteration stops at, and returns, the first
+ * nonzero value a callback returns. */
+herr_t geotiff_link_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                             H5VL_link_specific_args_t *args,
+                             hid_t __attribute__((unused)) dxpl_id,
+                             void __attribute__((unused)) * *req)
+{
+    H5VL_link_iterate_args_t *iter;
+    geotiff_file_t *file = NULL;
+    H5L_info2_t linfo;
+    hsize_t n;
+    uint64_t id, link;
+    hid_t group_id;
+    herr_t ret = 0;
+
+    if (!obj || !loc_params)
         return -1;
 
-    image_data = (unsigned char *) dset->data;
+    switch (args->op_type) {
+        case H5VL_LINK_EXISTS:
+            *args->args.exists.exists = geotiff_resolve_loc(obj, loc_params, &file, &id) >= 0;
+            return 0;
+
+        case H5VL_LINK_ITER:
+            iter = &args->args.iterate;
+            if (geotiff_resolve_loc(obj, loc_params, &file, &id) < 0 || id != GEOTIFF_ROOT_ID)
+                return -1;
+            n = iter->idx_p ? *iter->idx_p : 0;
+            if (iter->idx_type != H5_INDEX_NAME || n > file->nlinks)
+                return -1;
+            if (n == file->nlinks)
+                return 0;
+
+            if ((group_id = geotiff_register_object(file, GEOTIFF_ROOT_ID)) < 0)
+                return -1;
+            memset(&linfo, 0, sizeof(linfo));
+            linfo.type = H5L_TYPE_HARD;
+            linfo.cset = H5T_CSET_ASCII;
+            while (ret == 0 && n < file->nlinks) {
+                if (geotiff_links_get(file, iter->idx_type, iter->order, n++, &link) < 0) {
+                    ret = -1;
+                    break;
+                }
+                geotiff_links_token(link, &linfo.u.token);
+                ret = iter->op(group_id, file->links[GEOTIFF_ID_LINK(link)].name, &linfo,
+                               iter->op_data);
+            }
+            if (iter->idx_p)
+                *iter->idx_p = n;
+            H5Idec_ref(group_id);
+
+            return ret;
 
-    for (row = 0; row < height; row++) {
-        if (TIFFReadScanline(file->tiff, image_data + row * scanline_size, row, 0) < 0) {
-            free(dset->data);
-            dset->data = NULL;
-            dset->data_size = 0;
+        default:
             return -1;
-        }
     }
+}
 
-    return 0;
+/* Object operations */
+void *geotiff_object_open(void *obj, const H5VL_loc_params_t *loc_params, H5I_type_t *opened_type,
+                          hid_t __attribute__((unused)) dxpl_id,
+                          void __attribute__((unused)) * *req)
+{
+    geotiff_file_t *file = NULL;
+    uint64_t id;
+
+    if (!obj || !loc_params || !opened_type ||
+        geotiff_resolve_loc(obj, loc_params, &file, &id) < 0)
+        return NULL;
+
+    return geotiff_open_object(file, id, opened_type);
 }
 
-/* Helper function to parse GeoTIFF tags */
-herr_t geotiff_parse_geotiff_tags(geotiff_file_t *file)
+// cppcheck-suppress constParameterCallback
+herr_t geotiff_object_get(void *obj, const H5VL_loc_params_t *loc_params,
+                          H5VL_object_get_args_t *args, hid_t __attribute__((unused)) dxpl_id,
+                          void __attribute__((unused)) * *req)
 {
-    geocode_t model_type;
-    geocode_t pcs_code, gcs_code;
-    /* Optionally read tie points / pixel scale via TIFF tags in the future */
+    geotiff_file_t *file = NULL;
+    size_t len;
+    uint64_t id;
 
-    if (!file || !file->gtif)
+    if (!obj || !loc_params || geotiff_resolve_loc(obj, loc_params, &file, &id) < 0)
         return -1;
 
-    /* Get model type */
-    if (GTIFKeyGet(file->gtif, GTModelTypeGeoKey, &model_type, 0, 1)) {
-        printf("Model Type: %d\n", model_type);
+    switch (args->op_type) {
+        case H5VL_OBJECT_GET_FILE:
+            *args->args.get_file.file = file;
+            break;
+        case H5VL_OBJECT_GET_NAME:
+            len = geotiff_links_path(file, id, args->args.get_name.buf,
+                                     args->args.get_name.buf ? args->args.get_name.buf_size : 0);
+            if (args->args.get_name.name_len)
+                *args->args.get_name.name_len = len;
+            break;
+        case H5VL_OBJECT_GET_TYPE:
+            *args->args.get_type.obj_type =
+                id == GEOTIFF_ROOT_ID ? H5O_TYPE_GROUP : H5O_TYPE_DATASET;
+            break;
+        case H5VL_OBJECT_GET_INFO:
+            geotiff_get_object_info(file, id, args->args.get_info.fields,
+                                    args->args.get_info.oinfo);
+            break;
+        default:
+            return -1;
     }
 
-    /* Get PCS code */
-    if (GTIFKeyGet(file->gtif, ProjectedCSTypeGeoKey, &pcs_code, 0, 1)) {
-        printf("Projected CS: %d\n", pcs_code);
-    }
+    return 0;
+}
+
+/* Object specific operations: checking whether an object exists, looking up
+ * its token, and visiting an object and (for the root group) every dataset
+ * under it, in name order */
+herr_t geotiff_object_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                               H5VL_object_specific_args_t *args,
+                               hid_t __attribute__((unused)) dxpl_id,
+                               void __attribute__((unused)) * *req)
+{
+    H5VL_object_visit_args_t *visit;
+    geotiff_file_t *file = NULL;
+    H5O_info2_t oinfo;
+    uint64_t id, link;
+    hsize_t n;
+    hid_t obj_id;
+    herr_t ret;
+
+    if (!obj || !loc_params)
+        return -1;
+
+    switch (args->op_type) {
+        case H5VL_OBJECT_EXISTS:
+            *args->args.exists.exists = geotiff_resolve_loc(obj, loc_params, &file, &id) >= 0;
+            return 0;
+
+        case H5VL_OBJECT_LOOKUP:
+            if (geotiff_resolve_loc(obj, loc_params, &file, &id) < 0)
+                return -1;
+            geotiff_links_token(id, args->args.lookup.token_ptr);
+            return 0;
+
+        case H5VL_OBJECT_VISIT:
+            visit = &args->args.visit;
+            if (geotiff_resolve_loc(obj, loc_params, &file, &id) < 0 ||
+                visit->idx_type != H5_INDEX_NAME)
+                return -1;
+            if ((obj_id = geotiff_register_object(file, id)) < 0)
+                return -1;
+
+            geotiff_get_object_info(file, id, visit->fields, &oinfo);
+            ret = visit->op(obj_id, ".", &oinfo, visit->op_data);
+            for (n = 0; ret == 0 && id == GEOTIFF_ROOT_ID && n < file->nlinks; n++) {
+                if (geotiff_links_get(file, visit->idx_type, visit->order, n, &link) < 0) {
+                    ret = -1;
+                    break;
+                }
+                geotiff_get_object_info(file, link, visit->fields, &oinfo);
+                ret = visit->op(obj_id, file->links[GEOTIFF_ID_LINK(link)].name, &oinfo,
+                                visit->op_data);
+            }
+            H5Idec_ref(obj_id);
+
+            return ret;
 
-    /* Get GCS code */
-    if (GTIFKeyGet(file->gtif, GeographicTypeGeoKey, &gcs_code, 0, 1)) {
-        printf("Geographic CS: %d\n", gcs_code);
+        default:
+            return -1;
     }
+}
+
+/* Helper function to find the object an attribute location names, and its
+ * attribute catalog (NULL for objects without attributes). By index, the
+ * location names the object by path, and the index is the attribute's. */
+static herr_t geotiff_attr_location(void *obj, const H5VL_loc_params_t *loc_params,
+                                    geotiff_file_t **file, uint64_t *id,
+                                    const geotiff_meta_t **meta)
+{
+    const char *path = NULL;
 
-    /* Skipping citation retrieval for portability */
+    if (loc_params->type == H5VL_OBJECT_BY_NAME)
+        path = loc_params->loc_data.loc_by_name.name;
+    else if (loc_params->type == H5VL_OBJECT_BY_IDX)
+        path = loc_params->loc_data.loc_by_idx.name;
+    else if (loc_params->type != H5VL_OBJECT_BY_SELF)
+        return -1;
 
-    /* Skipping tie points and pixel scale retrieval here due to tag differences across platforms */
+    if ((loc_params->type != H5VL_OBJECT_BY_SELF && !path) ||
+        geotiff_resolve_path(obj, loc_params->obj_type, path, file, id) < 0)
+        return -1;
+    *meta = geotiff_object_meta(*file, *id);
+
+    return 0;
+}
+
+/* Helper function to find the catalog entry of an attribute, and the catalog
+ * it is in, given the object the location is relative to and the attribute's
+ * name (or, by index, its position). The root group's attributes are the
+ * file's GeoKeys and georeferencing tags, a coordinate variable's describe it
+ * as a dimension scale, and images have none. */
+static const geotiff_meta_entry_t *geotiff_find_attr(void *obj,
+                                                     const H5VL_loc_params_t *loc_params,
+                                                     const char *name, geotiff_file_t **file,
+                                                     const geotiff_meta_t **meta)
+{
+    uint64_t id;
+
+    if (geotiff_attr_location(obj, loc_params, file, &id, meta) < 0 || !*meta)
+        return NULL;
+
+    if (loc_params->type == H5VL_OBJECT_BY_IDX)
+        return geotiff_meta_get(*meta, loc_params->loc_data.loc_by_idx.idx_type,
+                                loc_params->loc_data.loc_by_idx.order,
+                                loc_params->loc_data.loc_by_idx.n);
+
+    return name ? geotiff_meta_find(*meta, name) : NULL;
+}
+
+/* Attribute operations: the attributes are entries of the file's metadata
+ * catalog, and opening or reading one does no TIFF I/O */
+void *geotiff_attr_open(void *obj, const H5VL_loc_params_t *loc_params, const char *name,
+                        hid_t __attribute__((unused)) aapl_id,
+                        hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    const geotiff_meta_entry_t *entry;
+    const geotiff_meta_t *meta = NULL;
+    geotiff_file_t *file = NULL;
+    geotiff_attr_t *attr;
+
+    if (!obj || !loc_params ||
+        !(entry = geotiff_find_attr(obj, loc_params, name, &file, &meta)))
+        return NULL;
+
+    attr = (geotiff_attr_t *) malloc(sizeof(geotiff_attr_t));
+    if (!attr)
+        return NULL;
+
+    attr->file = file;
+    attr->name = strdup(meta->pool + entry->name);
+    attr->data = meta->pool + entry->data;
+    attr->data_size = geotiff_meta_size(entry);
+    attr->type_id = geotiff_meta_type(entry);
+    attr->space_id = geotiff_meta_space(entry);
+    if (!attr->name || attr->type_id < 0 || attr->space_id < 0) {
+        geotiff_attr_close(attr, H5P_DEFAULT, NULL);
+        return NULL;
+    }
+
+    return attr;
+}
+
+// cppcheck-suppress constParameterCallback
+herr_t geotiff_attr_read(void *attr, hid_t mem_type_id, void *buf,
+                         hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    const geotiff_attr_t *a = (const geotiff_attr_t *) attr;
+    hssize_t nelmts;
+    size_t src_size, dst_size;
+    unsigned char *tconv;
+    htri_t same;
+    char *str;
+    herr_t ret = 0;
+
+    if (!a || !buf)
+        return -1;
+
+    if ((same = H5Tequal(a->type_id, mem_type_id)) < 0)
+        return -1;
+    if (same) {
+        memcpy(buf, a->data, a->data_size);
+        return 0;
+    }
+
+    /* A variable-length string gets a copy, which the caller frees with
+     * H5free_memory() */
+    if (H5Tget_class(mem_type_id) == H5T_STRING && H5Tis_variable_str(mem_type_id) > 0) {
+        if (H5Tget_class(a->type_id) != H5T_STRING)
+            return -1;
+        if (!(str = (char *) H5allocate_memory(a->data_size, 0)))
+            return -1;
+        memcpy(str, a->data, a->data_size);
+        *(char **) buf = str;
+        return 0;
+    }
+
+    /* Anything else goes through HDF5's conversions, in a buffer large enough
+     * for either type */
+    if ((nelmts = H5Sget_simple_extent_npoints(a->space_id)) < 0 ||
+        !(src_size = H5Tget_size(a->type_id)) || !(dst_size = H5Tget_size(mem_type_id)))
+        return -1;
+    if (!(tconv = (unsigned char *) malloc((size_t) nelmts *
+                                           (src_size > dst_size ? src_size : dst_size))))
+        return -1;
+    memcpy(tconv, a->data, a->data_size);
+    if (H5Tconvert(a->type_id, mem_type_id, (size_t) nelmts, tconv, NULL, H5P_DEFAULT) < 0)
+        ret = -1;
+    else
+        memcpy(buf, tconv, (size_t) nelmts * dst_size);
+    free(tconv);
+
+    return ret;
+}
+
+// cppcheck-suppress constParameterCallback
+herr_t geotiff_attr_get(void *obj, H5VL_attr_get_args_t *args,
+                        hid_t __attribute__((unused)) dxpl_id, void __attribute__((unused)) * *req)
+{
+    const geotiff_attr_t *a = (const geotiff_attr_t *) obj;
+    const geotiff_meta_entry_t *entry;
+    const geotiff_meta_t *meta = NULL;
+    geotiff_file_t *file = NULL;
+    H5A_info_t *ainfo;
+    const char *name;
+    size_t len;
+
+    /* The caller owns (and closes) the returned IDs, so hand out copies */
+    switch (args->op_type) {
+        case H5VL_ATTR_GET_ACPL:
+            if ((args->args.get_acpl.acpl_id = H5Pcreate(H5P_ATTRIBUTE_CREATE)) < 0)
+                return -1;
+            break;
+        case H5VL_ATTR_GET_SPACE:
+            if ((args->args.get_space.space_id = H5Scopy(a->space_id)) < 0)
+                return -1;
+            break;
+        case H5VL_ATTR_GET_TYPE:
+            if ((args->args.get_type.type_id = H5Tcopy(a->type_id)) < 0)
+                return -1;
+            break;
+        case H5VL_ATTR_GET_STORAGE_SIZE:
+            *args->args.get_storage_size.data_size = a->data_size;
+            break;
+        case H5VL_ATTR_GET_INFO:
+            ainfo = args->args.get_info.ainfo;
+            ainfo->corder_valid = 0;
+            ainfo->corder = 0;
+            ainfo->cset = H5T_CSET_ASCII;
+            if (args->args.get_info.loc_params.type == H5VL_OBJECT_BY_SELF)
+                ainfo->data_size = a->data_size;
+            else if ((entry = geotiff_find_attr(obj, &args->args.get_info.loc_params,
+                                                args->args.get_info.attr_name, &file,
+                                                &meta)))
+                ainfo->data_size = geotiff_meta_size(entry);
+            else
+                return -1;
+            break;
+        case H5VL_ATTR_GET_NAME:
+            if (args->args.get_name.loc_params.type == H5VL_OBJECT_BY_SELF)
+                name = a->name;
+            else if ((entry = geotiff_find_attr(obj, &args->args.get_name.loc_params, NULL,
+                                                &file, &meta)))
+                name = meta->pool + entry->name;
+            else
+                return -1;
+            len = strlen(name);
+            if (args->args.get_name.buf && args->args.get_name.buf_size > 0) {
+                size_t ncopy = len < args->args.get_name.buf_size
+                                   ? len
+                                   : args->args.get_name.buf_size - 1;
+                memcpy(args->args.get_name.buf, name, ncopy);
+                args->args.get_name.buf[ncopy] = '\0';
+            }
+            if (args->args.get_name.attr_name_len)
+                *args->args.get_name.attr_name_len = len;
+            break;
+        default:
+            return -1;
+    }
+
+    return 0;
+}
+
+/* Attribute specific operations: checking whether an attribute exists, and
+ * iterating over the attributes of an object, which stops at (and returns)
+ * the first nonzero value the callback returns */
+herr_t geotiff_attr_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                             H5VL_attr_specific_args_t *args,
+                             hid_t __attribute__((unused)) dxpl_id,
+                             void __attribute__((unused)) * *req)
+{
+    const geotiff_meta_entry_t *entry;
+    const geotiff_meta_t *meta = NULL;
+    H5VL_attr_iterate_args_t *iter;
+    geotiff_file_t *file = NULL;
+    H5A_info_t ainfo;
+    hsize_t n, nattrs;
+    uint64_t id;
+    hid_t obj_id;
+    herr_t ret = 0;
+
+    switch (args->op_type) {
+        case H5VL_ATTR_EXISTS:
+            *args->args.exists.exists =
+                geotiff_find_attr(obj, loc_params, args->args.exists.name, &file, &meta) != NULL;
+            return 0;
+
+        case H5VL_ATTR_ITER:
+            iter = &args->args.iterate;
+            if (geotiff_attr_location(obj, loc_params, &file, &id, &meta) < 0)
+                return -1;
+            n = iter->idx ? *iter->idx : 0;
+            nattrs = meta ? meta->nentries : 0;
+            if (n > nattrs)
+                return -1;
+            if (n == nattrs)
+                return 0;
+
+            if ((obj_id = geotiff_register_object(file, id)) < 0)
+                return -1;
+            memset(&ainfo, 0, sizeof(ainfo));
+            ainfo.cset = H5T_CSET_ASCII;
+            while (ret == 0 && n < nattrs) {
+                if (!(entry = geotiff_meta_get(meta, iter->idx_type, iter->order, n++))) {
+                    ret = -1;
+                    break;
+                }
+                ainfo.data_size = geotiff_meta_size(entry);
+                ret = iter->op(obj_id, meta->pool + entry->name, &ainfo, iter->op_data);
+            }
+            if (iter->idx)
+                *iter->idx = n;
+            H5Idec_ref(obj_id);
+
+            return ret;
+
+        default:
+            return -1;
+    }
+}
+
+herr_t geotiff_attr_close(void *attr, hid_t __attribute__((unused)) dxpl_id,
+                          void __attribute__((unused)) * *req)
+{
+    geotiff_attr_t *a = (geotiff_attr_t *) attr;
+
+    /* The data belongs to the file's metadata catalog */
+    if (a) {
+        if (a->name)
+            free(a->name);
+        if (a->type_id >= 0)
+            H5Tclose(a->type_id);
+        if (a->space_id >= 0)
+            H5Sclose(a->space_id);
+        free(a);
+    }
+
+    return 0;
+}
+
+/* Helper function to read the raster layout of the current TIFF directory */
+herr_t geotiff_get_image_info(TIFF *tiff, geotiff_image_t *image)
+{
+    uint16_t planar_config;
+    uint32_t rows_per_strip;
+    uint64_t chunk_size, scanline_size;
+
+    if (!tiff || !image)
+        return -1;
+
+    memset(image, 0, sizeof(geotiff_image_t));
+
+    if (!TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &image->width) ||
+        !TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &image->height)) {
+        return -1;
+    }
+
+    /* Validate image dimensions */
+    if (image->width == 0 || image->height == 0) {
+        return -1;
+    }
+
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &image->samples_per_pixel);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &image->bits_per_sample);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &image->sample_format);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar_config);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &image->compression);
+
+    /* Samples are exposed as whole bytes */
+    if (image->bits_per_sample != 8 && image->bits_per_sample != 16 &&
+        image->bits_per_sample != 32 && image->bits_per_sample != 64) {
+        return -1;
+    }
+
+    image->elem_size = image->bits_per_sample / 8;
+    image->is_tiled = TIFFIsTiled(tiff);
+    image->is_separate = image->samples_per_pixel > 1 && planar_config == PLANARCONFIG_SEPARATE;
+
+    if (image->is_tiled) {
+        /* Tiles are numbered row-major across the image, and the ones on the
+         * right and bottom edges are padded out to the full tile size */
+        if (!TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &image->chunk_width) ||
+            !TIFFGetField(tiff, TIFFTAG_TILELENGTH, &image->chunk_height))
+            return -1;
+        if (image->chunk_width == 0 || image->chunk_height == 0)
+            return -1;
+
+        chunk_size = TIFFTileSize64(tiff);
+        image->chunks_across = (uint32_t) (((uint64_t) image->width + image->chunk_width - 1) /
+                                           image->chunk_width);
+    } else {
+        TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rows_per_strip);
+        if (rows_per_strip == 0 || rows_per_strip > image->height)
+            rows_per_strip = image->height;
+
+        scanline_size = TIFFScanlineSize64(tiff);
+        if (scanline_size == 0)
+            return -1;
+
+        /* A strip too large to hold decoded (e.g. a whole image stored as one
+         * strip) is streamed a band of scanlines at a time instead */
+        if ((uint64_t) rows_per_strip * scanline_size > GEOTIFF_MAX_CHUNK_BYTES) {
+            image->by_scanline = 1;
+            rows_per_strip = (uint32_t) (GEOTIFF_MAX_CHUNK_BYTES / scanline_size);
+            if (rows_per_strip == 0)
+                rows_per_strip = 1;
+        }
+
+        chunk_size = (uint64_t) rows_per_strip * scanline_size;
+        image->chunk_width = image->width;
+        image->chunk_height = rows_per_strip;
+        image->chunks_across = 1;
+    }
+
+    if (chunk_size == 0 || chunk_size > SIZE_MAX)
+        return -1;
+
+    image->chunk_size = (size_t) chunk_size;
+    image->chunks_down = (uint32_t) (((uint64_t) image->height + image->chunk_height - 1) /
+                                     image->chunk_height);
+
+    /* libtiff numbers the chunks of separate planes one plane after another */
+    if ((uint64_t) image->chunks_across * image->chunks_down *
+            (image->is_separate ? image->samples_per_pixel : 1) > UINT32_MAX)
+        return -1;
+    image->chunks_per_plane = image->chunks_across * image->chunks_down;
+
+    return 0;
+}
+
+/* Helper function to describe a selection as a single rectangular block.
+ * Returns 1 and fills start/count if it is one, 0 if not, -1 on error. */
+static int geotiff_get_select_block(hid_t space_id, int ndims, hsize_t *start, hsize_t *count)
+{
+    hsize_t stride[H5S_MAX_RANK], nblocks[H5S_MAX_RANK], block[H5S_MAX_RANK];
+    H5S_sel_type sel_type;
+    int i;
+
+    if ((sel_type = H5Sget_select_type(space_id)) < 0)
+        return -1;
+
+    if (sel_type == H5S_SEL_ALL) {
+        if (H5Sget_simple_extent_dims(space_id, count, NULL) < 0)
+            return -1;
+        for (i = 0; i < ndims; i++)
+            start[i] = 0;
+        return 1;
+    }
+
+    if (sel_type != H5S_SEL_HYPERSLABS || H5Sis_regular_hyperslab(space_id) <= 0)
+        return 0;
+
+    if (H5Sget_regular_hyperslab(space_id, start, stride, nblocks, block) < 0)
+        return -1;
+
+    /* Abutting blocks (stride == block) merge into one */
+    for (i = 0; i < ndims; i++) {
+        if (nblocks[i] == 1)
+            count[i] = block[i];
+        else if (stride[i] == block[i])
+            count[i] = nblocks[i] * block[i];
+        else
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Helper function to check whether a memory selection is one dense run of
+ * elements. Returns 1 and the element offset of the run if so, 0 if not,
+ * -1 on error. */
+static int geotiff_get_dense_offset(hid_t space_id, hsize_t *offset)
+{
+    hsize_t dims[H5S_MAX_RANK], start[H5S_MAX_RANK], count[H5S_MAX_RANK];
+    int ndims, partial, i, ret;
+
+    if ((ndims = H5Sget_simple_extent_ndims(space_id)) < 0)
+        return -1;
+    if (H5Sget_simple_extent_dims(space_id, dims, NULL) < 0)
+        return -1;
+    if ((ret = geotiff_get_select_block(space_id, ndims, start, count)) <= 0)
+        return ret;
+
+    /* Dense if every dimension inside the outermost partial one is full and
+     * every dimension outside it has a count of one */
+    for (partial = ndims - 1; partial > 0; partial--)
+        if (count[partial] != dims[partial])
+            break;
+    for (i = 0; i < partial; i++)
+        if (count[i] != 1)
+            return 0;
+
+    *offset = 0;
+    for (i = 0; i < ndims; i++)
+        *offset = *offset * dims[i] + start[i];
+
+    return 1;
+}
+
+/* How samples are copied from a decoded chunk to the read buffer */
+typedef struct geotiff_conv_t {
+    geotiff_convert_func_t func; /* Conversion to the memory type, or NULL to copy as stored */
+    size_t src_size;             /* Bytes per sample in the chunk */
+    size_t dst_size;             /* Bytes per sample in the read buffer */
+} geotiff_conv_t;
+
+/* Helper function to copy n samples, converting them on the way */
+static void geotiff_convert_run(const geotiff_conv_t *conv, unsigned char *dst,
+                                const unsigned char *src, size_t n)
+{
+    if (conv->func)
+        conv->func(dst, src, n);
+    else
+        memcpy(dst, src, n * conv->src_size);
+}
+
+/* Helper function to copy n samples that lie src_stride samples apart in a
+ * decoded chunk to dst_stride samples apart in the read buffer */
+static void geotiff_copy_strided(unsigned char *dst, size_t dst_stride, const unsigned char *src,
+                                 size_t src_stride, size_t n, const geotiff_conv_t *conv)
+{
+    size_t i;
+
+    if (src_stride == 1 && dst_stride == 1) {
+        geotiff_convert_run(conv, dst, src, n);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        geotiff_convert_run(conv, dst, src, 1);
+        dst += dst_stride * conv->dst_size;
+        src += src_stride * conv->src_size;
+    }
+}
+
+/* Helper function to decode one tile, strip or band of scanlines of the image
+ * in the directory at ifd_offset, first moving the handle there if needed */
+static herr_t geotiff_decode_chunk(TIFF *tiff, const geotiff_image_t *image, uint64_t ifd_offset,
+                                   uint32_t chunk, unsigned char *chunk_buf)
+{
+    tmsize_t nread;
+
+    if (TIFFCurrentDirOffset(tiff) != ifd_offset && !TIFFSetSubDirectory(tiff, ifd_offset))
+        return -1;
+
+    if (image->by_scanline) {
+        /* Rows of one strip must be decoded in order; the chunk loop walks
+         * them top to bottom, so libtiff restarts a strip at most once */
+        size_t scanline_size = image->chunk_size / image->chunk_height;
+        uint16_t plane = (uint16_t) (chunk / image->chunks_per_plane);
+        uint32_t row = (chunk % image->chunks_per_plane) * image->chunk_height;
+        uint32_t end = row + image->chunk_height;
+
+        if (end > image->height)
+            end = image->height;
+        for (; row < end; row++, chunk_buf += scanline_size)
+            if (TIFFReadScanline(tiff, chunk_buf, row, plane) < 0)
+                return -1;
+
+        return 0;
+    }
+
+    if (image->is_tiled)
+        nread = TIFFReadEncodedTile(tiff, chunk, chunk_buf, (tmsize_t) image->chunk_size);
+    else
+        nread = TIFFReadEncodedStrip(tiff, chunk, chunk_buf, (tmsize_t) image->chunk_size);
+
+    if (nread < 0)
+        return -1;
+
+    return 0;
+}
+
+/* Helper function to copy a rows x cols matrix of samples that is contiguous
+ * along cols in a decoded chunk to the read buffer, where it is contiguous
+ * along rows. Converted samples go through scratch space for rows * cols
+ * source samples. */
+static void geotiff_copy_transposed(unsigned char *dst, size_t dst_stride,
+                                    const unsigned char *src, size_t src_stride, size_t rows,
+                                    size_t cols, geotiff_transpose_func_t transpose,
+                                    unsigned char *scratch, const geotiff_conv_t *conv)
+{
+    size_t j;
+
+    if (!conv->func) {
+        transpose(dst, dst_stride, src, src_stride, rows, cols);
+        return;
+    }
+
+    transpose(scratch, rows, src, src_stride, rows, cols);
+    for (j = 0; j < cols; j++)
+        conv->func(dst + j * dst_stride * conv->dst_size, scratch + j * rows * conv->src_size,
+                   rows);
+}
+
+/* Part of a dataset covered by one decoded chunk, and where its elements lie
+ * in the decoded buffer */
+typedef struct geotiff_region_t {
+    hsize_t start[GEOTIFF_NAXES]; /* First element in each dimension */
+    hsize_t count[GEOTIFF_NAXES]; /* Elements in each dimension, clipped to the image */
+    size_t stride[GEOTIFF_NAXES]; /* Samples between neighbours in each dimension */
+    int dense;                    /* Elements are contiguous in both dataset and chunk order */
+} geotiff_region_t;
+
+/* Helper function to get the region of a dataset covered by one chunk of one
+ * of its pages */
+static void geotiff_get_chunk_region(const geotiff_dataset_t *dset, uint32_t page, uint32_t chunk,
+                                     geotiff_region_t *region)
+{
+    const geotiff_image_t *image = &dset->image;
+    hsize_t start[GEOTIFF_NAXES], count[GEOTIFF_NAXES];
+    size_t stride[GEOTIFF_NAXES], expect = 1;
+    uint32_t plane = chunk / image->chunks_per_plane, spp;
+    int d, partial = 0;
+
+    /* A chunk of a separate plane holds one band; an interleaved one all */
+    chunk %= image->chunks_per_plane;
+    spp = image->is_separate ? 1 : image->samples_per_pixel;
+
+    start[GEOTIFF_AXIS_PAGE] = page;
+    count[GEOTIFF_AXIS_PAGE] = 1;
+    stride[GEOTIFF_AXIS_PAGE] = 0;
+    start[GEOTIFF_AXIS_Y] = (hsize_t) (chunk / image->chunks_across) * image->chunk_height;
+    count[GEOTIFF_AXIS_Y] = image->chunk_height;
+    stride[GEOTIFF_AXIS_Y] = (size_t) image->chunk_width * spp;
+    start[GEOTIFF_AXIS_X] = (hsize_t) (chunk % image->chunks_across) * image->chunk_width;
+    count[GEOTIFF_AXIS_X] = image->chunk_width;
+    stride[GEOTIFF_AXIS_X] = spp;
+    start[GEOTIFF_AXIS_BAND] = plane;
+    count[GEOTIFF_AXIS_BAND] = spp;
+    stride[GEOTIFF_AXIS_BAND] = 1;
+
+    /* Edge chunks are clipped to the image */
+    if (start[GEOTIFF_AXIS_Y] + count[GEOTIFF_AXIS_Y] > image->height)
+        count[GEOTIFF_AXIS_Y] = image->height - start[GEOTIFF_AXIS_Y];
+    if (start[GEOTIFF_AXIS_X] + count[GEOTIFF_AXIS_X] > image->width)
+        count[GEOTIFF_AXIS_X] = image->width - start[GEOTIFF_AXIS_X];
+
+    for (d = 0; d < dset->ndims; d++) {
+        region->start[d] = start[dset->axes[d]];
+        region->count[d] = count[dset->axes[d]];
+        region->stride[d] = stride[dset->axes[d]];
+    }
+
+    /* The chunk is one run of the dataset, stored in the dataset's order (as
+     * a strip of an interleaved image is), when every dimension inside the
+     * outermost one it spans several elements of is whole, and strides are
+     * those of a dense array */
+    region->dense = 1;
+    for (d = 0; d < dset->ndims; d++) {
+        if (partial && region->count[d] != dset->dims[d])
+            region->dense = 0;
+        if (region->count[d] > 1)
+            partial = 1;
+    }
+    for (d = dset->ndims - 1; d >= 0; d--) {
+        if (region->count[d] > 1 && region->stride[d] != expect)
+            region->dense = 0;
+        expect *= (size_t) region->count[d];
+    }
+}
+
+/* One dataset's share of a read */
+typedef struct geotiff_read_t {
+    geotiff_dataset_t *dset;             /* Dataset being read */
+    hid_t file_space;                    /* File selection */
+    hid_t mem_space;                     /* Memory selection */
+    hid_t block_space;                   /* Dataspace standing in for H5S_BLOCK, if any */
+    geotiff_conv_t conv;                 /* Conversion to the memory type */
+    int direct;                          /* Tasks copy decoded pixels straight into buf */
+    hsize_t block_start[GEOTIFF_NAXES];  /* File selection block (direct copies only) */
+    hsize_t block_count[GEOTIFF_NAXES];  /* File selection block size (direct copies only) */
+    hsize_t mem_offset;                  /* First memory element (direct copies only) */
+    unsigned char *buf;                  /* Caller's buffer */
+} geotiff_read_t;
+
+/* A chunk that one dataset of a read needs */
+typedef struct geotiff_need_t {
+    geotiff_read_t *rd; /* Dataset share needing the chunk */
+    uint32_t page;      /* Page of the dataset the chunk is in */
+    uint32_t chunk;     /* Tile or strip (band) index in that page */
+    geotiff_run_t *run; /* Merged range the chunk is read from (first need of a chunk only) */
+} geotiff_need_t;
+
+/* One distinct chunk of a batch: the datasets that need it, where its decoded
+ * pixels are, and who owns them */
+typedef struct geotiff_slot_t {
+    const geotiff_need_t *needs;  /* Needs of this chunk, all of the same image */
+    size_t nneeds;                /* Number of needs */
+    unsigned char *buf;           /* Private decode buffer, used with no cache */
+    size_t buf_size;              /* Size of buf */
+    const unsigned char *data;    /* Decoded pixels of the slot's chunk */
+    geotiff_cache_entry_t *entry; /* Cache entry holding data, if cached */
+    geotiff_run_t *run;           /* Merged range to decode the chunk from, if any */
+} geotiff_slot_t;
+
+/* State shared by the decode tasks of a read */
+typedef struct geotiff_plan_t {
+    geotiff_slot_t *slots; /* Slot of each distinct chunk of the current batch */
+    int use_cache;         /* Look chunks up in, and add them to, the chunk cache */
+    int background;        /* Tasks run in the background and drop each chunk once copied */
+    geotiff_read_t *reads; /* Each dataset's share of the read (background reads only) */
+    size_t nreads;         /* Number of shares */
+    uint64_t start;        /* When the read was issued (background reads only) */
+} geotiff_plan_t;
+
+/* An asynchronous read, handed to HDF5 as the request object. Every share of
+ * it is copied by the decode tasks, so nothing is left for the caller to do
+ * but wait. */
+typedef struct geotiff_request_t {
+    geotiff_plan_t plan;          /* Decode tasks' state, one slot per distinct chunk */
+    size_t nslots;                /* Number of slots */
+    geotiff_need_t *needs;        /* Chunks needed, grouped into the slots */
+    size_t nneeds;                /* Number of needs */
+    geotiff_batch_t *batch;       /* Decode tasks running in the pool */
+    H5VL_request_notify_t notify; /* Callback to call on completion, if any */
+    void *notify_ctx;             /* Its context */
+    int cancelled;                /* The read was cancelled before it started */
+} geotiff_request_t;
+
+/* Helper function to copy the part of the file selection block that falls in
+ * a decoded chunk into the dense memory run */
+static void geotiff_copy_block(const geotiff_read_t *rd, uint32_t page, uint32_t chunk,
+                               const unsigned char *chunk_buf)
+{
+    const geotiff_dataset_t *dset = rd->dset;
+    geotiff_region_t region;
+    hsize_t n[GEOTIFF_NAXES], idx[GEOTIFF_NAXES];
+    size_t sstride[GEOTIFF_NAXES], dstride[GEOTIFF_NAXES], src_off = 0, dst_off, span = 1;
+    size_t src_size = rd->conv.src_size, dst_size = rd->conv.dst_size;
+    geotiff_transpose_func_t transpose = NULL;
+    unsigned char *scratch = NULL;
+    int ndims = 0, outer = 1, d;
+
+    geotiff_get_chunk_region(dset, page, chunk, &region);
+    dst_off = (size_t) rd->mem_offset;
+
+    /* Intersect the block with the chunk, dropping dimensions of one element */
+    for (d = dset->ndims - 1; d >= 0; d--) {
+        hsize_t lo = region.start[d] > rd->block_start[d] ? region.start[d] : rd->block_start[d];
+        hsize_t hi = region.start[d] + region.count[d];
+
+        if (hi > rd->block_start[d] + rd->block_count[d])
+            hi = rd->block_start[d] + rd->block_count[d];
+        if (hi <= lo)
+            return;
+
+        src_off += (size_t) (lo - region.start[d]) * region.stride[d];
+        dst_off += (size_t) (lo - rd->block_start[d]) * span;
+        if (hi - lo > 1) {
+            n[ndims] = hi - lo;
+            sstride[ndims] = region.stride[d];
+            dstride[ndims] = span;
+            ndims++;
+        }
+        span *= (size_t) rd->block_count[d];
+    }
+
+    /* n[0] is the innermost dimension from here on. Merge dimensions that
+     * continue the one inside them on both sides, so runs are as long as can be. */
+    for (d = 1; d < ndims; d++) {
+        if (sstride[d] == n[0] * sstride[0] && dstride[d] == n[0] * dstride[0]) {
+            int e;
+
+            n[0] *= n[d];
+            for (e = d; e < ndims - 1; e++) {
+                n[e] = n[e + 1];
+                sstride[e] = sstride[e + 1];
+                dstride[e] = dstride[e + 1];
+            }
+            ndims--;
+            d--;
+        } else {
+            break;
+        }
+    }
+    if (ndims == 0) {
+        n[0] = 1;
+        sstride[0] = dstride[0] = 1;
+        ndims = 1;
+    }
+
+    /* Interleaved samples read in band-sequential order: the band dimension,
+     * contiguous in the chunk, is transposed with the innermost one a row of
+     * pixels at a time rather than gathered one band after another */
+    if (ndims > 1 && sstride[0] > 1 && dstride[0] == 1 &&
+        (transpose = geotiff_get_transpose(src_size))) {
+        for (d = 1; d < ndims; d++)
+            if (sstride[d] == 1)
+                break;
+        if (d < ndims && rd->conv.func &&
+            !(scratch = (unsigned char *) malloc((size_t) (n[0] * n[d]) * src_size)))
+            d = ndims;
+        if (d < ndims) {
+            hsize_t tn = n[1];
+            size_t ts = sstride[1], td = dstride[1];
+
+            n[1] = n[d];
+            sstride[1] = sstride[d];
+            dstride[1] = dstride[d];
+            n[d] = tn;
+            sstride[d] = ts;
+            dstride[d] = td;
+            outer = 2;
+        } else {
+            transpose = NULL;
+        }
+    }
+
+    /* Walk the outer dimensions, copying one inner run (or matrix) at a time */
+    memset(idx, 0, sizeof(idx));
+    for (;;) {
+        if (transpose)
+            geotiff_copy_transposed(rd->buf + dst_off * dst_size, dstride[1],
+                                    chunk_buf + src_off * src_size, sstride[0], (size_t) n[0],
+                                    (size_t) n[1], transpose, scratch, &rd->conv);
+        else
+            geotiff_copy_strided(rd->buf + dst_off * dst_size, dstride[0],
+                                 chunk_buf + src_off * src_size, sstride[0], (size_t) n[0],
+                                 &rd->conv);
+
+        for (d = outer; d < ndims; d++) {
+            src_off += sstride[d];
+            dst_off += dstride[d];
+            if (++idx[d] < n[d])
+                break;
+            src_off -= (size_t) n[d] * sstride[d];
+            dst_off -= (size_t) n[d] * dstride[d];
+            idx[d] = 0;
+        }
+        if (d >= ndims)
+            break;
+    }
+
+    free(scratch);
+}
+
+/* Pool task: find one chunk of a batch in the chunk cache, or decode it on a
+ * TIFF handle of its own, and copy it out to every dataset needing it when
+ * that needs no HDF5 calls (which must stay on the calling thread) */
+static herr_t geotiff_read_chunk_task(void *ctx, size_t task)
+{
+    const geotiff_plan_t *plan = (const geotiff_plan_t *) ctx;
+    geotiff_slot_t *slot = &plan->slots[task];
+    const geotiff_dataset_t *dset = slot->needs[0].rd->dset;
+    const geotiff_image_t *image = &dset->image;
+    uint32_t page = slot->needs[0].page, chunk = slot->needs[0].chunk;
+    uint32_t ifd = dset->pages[page];
+    geotiff_handles_t *handles = dset->file->handles;
+    geotiff_stats_t *stats = &dset->file->stats;
+    geotiff_cache_key_t key;
+    unsigned char *decoded = NULL;
+    TIFF *tiff;
+    herr_t status;
+    uint64_t start;
+    size_t i;
+
+    /* Uncompressed chunks are used in place in the file mapping */
+    if (dset->raw_offsets) {
+        slot->data = dset->file->map + dset->raw_offsets[chunk];
+        geotiff_count(stats, GEOTIFF_COUNTER_CHUNKS_MAPPED, 1);
+        goto copy;
+    }
+
+    if (plan->use_cache) {
+        key.file = dset->file->id;
+        key.ifd = ifd;
+        key.chunk = chunk;
+        if ((slot->entry = geotiff_cache_get(&key))) {
+            slot->data = geotiff_cache_data(slot->entry);
+            geotiff_count(stats, GEOTIFF_COUNTER_CACHE_HITS, 1);
+            goto copy;
+        }
+        geotiff_count(stats, GEOTIFF_COUNTER_CACHE_MISSES, 1);
+
+        /* Decode into a buffer the cache can take over */
+        decoded = (unsigned char *) malloc(image->chunk_size);
+    }
+    if (!decoded) {
+        if (slot->buf_size < image->chunk_size) {
+            free(slot->buf);
+            slot->buf_size = 0;
+            if (!(slot->buf = (unsigned char *) malloc(image->chunk_size)))
+                return -1;
+            slot->buf_size = image->chunk_size;
+        }
+        decoded = slot->buf;
+    }
+
+    if (!(tiff = geotiff_handles_acquire(handles))) {
+        status = -1;
+    } else {
+        /* The first chunk of a merged range reads all of it; libtiff then
+         * reads each chunk's bytes out of memory */
+        if (slot->run && geotiff_run_load(slot->run, tiff) >= 0) {
+            geotiff_tiff_stage(tiff, slot->run);
+            geotiff_count(stats, GEOTIFF_COUNTER_CHUNKS_MERGED, 1);
+        }
+        start = geotiff_now_ns();
+        status = geotiff_decode_chunk(tiff, image, dset->file->ifds[ifd].offset, chunk, decoded);
+        if (status >= 0)
+            geotiff_count_decode(stats, image->compression, image->chunk_size,
+                                 geotiff_now_ns() - start);
+        geotiff_tiff_stage(tiff, NULL);
+        geotiff_handles_release(handles, tiff);
+    }
+
+    if (decoded != slot->buf) {
+        if (status < 0) {
+            free(decoded);
+            return -1;
+        }
+        /* Another thread may have cached the chunk meanwhile; use its copy */
+        if (!(slot->entry = geotiff_cache_put(&key, decoded, image->chunk_size)))
+            return -1;
+        decoded = (unsigned char *) geotiff_cache_data(slot->entry);
+    }
+    if (status < 0)
+        return -1;
+    slot->data = decoded;
+
+copy:
+    geotiff_run_release(slot->run);
+    slot->run = NULL;
+
+    start = geotiff_now_ns();
+    for (i = 0; i < slot->nneeds; i++)
+        if (slot->needs[i].rd->direct)
+            geotiff_copy_block(slot->needs[i].rd, page, chunk, slot->data);
+    geotiff_count(stats, GEOTIFF_COUNTER_CONVERT_NS, geotiff_now_ns() - start);
+
+    /* Nobody scatters a background read's chunks later, so let go of them */
+    if (plan->background) {
+        geotiff_cache_release(slot->entry);
+        slot->entry = NULL;
+        slot->data = NULL;
+        free(slot->buf);
+        slot->buf = NULL;
+        slot->buf_size = 0;
+    }
+
+    return 0;
+}
+
+/* Helper function to scatter the part of an arbitrary file selection that
+ * falls in one decoded chunk to the matching elements of the memory selection */
+static herr_t geotiff_scatter_chunk(const geotiff_dataset_t *dset, hid_t file_space,
+                                    hid_t mem_space, const geotiff_region_t *region,
+                                    const unsigned char *chunk_buf, const geotiff_conv_t *conv,
+                                    unsigned char *buf)
+{
+    hsize_t file_off[GEOTIFF_SEQ_LIST_LEN], mem_off[GEOTIFF_SEQ_LIST_LEN];
+    size_t file_len[GEOTIFF_SEQ_LIST_LEN], mem_len[GEOTIFF_SEQ_LIST_LEN];
+    size_t nfile = 0, nmem = 0, ifile = 0, imem = 0, nbytes;
+    hid_t chunk_file = H5I_INVALID_HID, box = H5I_INVALID_HID, chunk_mem = H5I_INVALID_HID;
+    hid_t file_iter = H5I_INVALID_HID, mem_iter = H5I_INVALID_HID;
+    size_t src_size = conv->src_size, dst_size = conv->dst_size;
+    int inner = dset->ndims - 1;
+    size_t nelmts = 1;
+    herr_t ret = -1;
+    int d;
+
+    for (d = 0; d < dset->ndims; d++)
+        nelmts *= (size_t) region->count[d];
+
+    /* File elements inside this chunk, and the memory elements they map to */
+    if ((chunk_file = H5Scopy(file_space)) < 0)
+        goto done;
+    if (H5Sselect_hyperslab(chunk_file, H5S_SELECT_AND, region->start, NULL, region->count,
+                            NULL) < 0)
+        goto done;
+    if ((box = H5Scopy(file_space)) < 0)
+        goto done;
+    if (H5Sselect_hyperslab(box, H5S_SELECT_SET, region->start, NULL, region->count, NULL) < 0)
+        goto done;
+    if ((chunk_mem = H5Sselect_project_intersection(file_space, mem_space, box)) < 0)
+        goto done;
+
+    if ((file_iter = H5Ssel_iter_create(chunk_file, src_size, 0)) < 0)
+        goto done;
+    if ((mem_iter = H5Ssel_iter_create(chunk_mem, dst_size, 0)) < 0)
+        goto done;
+
+    for (;;) {
+        hsize_t elem, coord;
+        size_t src_off = 0, run, n;
+
+        if (ifile == nfile) {
+            if (H5Ssel_iter_get_seq_list(file_iter, GEOTIFF_SEQ_LIST_LEN, SIZE_MAX, &nfile,
+                                         &nbytes, file_off, file_len) < 0)
+                goto done;
+            if (nfile == 0)
+                break;
+            ifile = 0;
+        }
+        if (imem == nmem) {
+            if (H5Ssel_iter_get_seq_list(mem_iter, GEOTIFF_SEQ_LIST_LEN, SIZE_MAX, &nmem, &nbytes,
+                                         mem_off, mem_len) < 0)
+                goto done;
+            if (nmem == 0)
+                goto done;
+            imem = 0;
+        }
+
+        /* Locate the file sequence's first element inside the decoded chunk */
+        elem = file_off[ifile] / src_size;
+        coord = elem % dset->dims[inner];
+        run = (size_t) (region->start[inner] + region->count[inner] - coord);
+        for (d = inner; d >= 0; d--) {
+            coord = elem % dset->dims[d];
+            elem /= dset->dims[d];
+            src_off += (size_t) (coord - region->start[d]) * region->stride[d];
+        }
+
+        /* A sequence stays in step with the chunk to the end of its innermost
+         * row, or to the end of the chunk if that is dense. Sequence lengths
+         * are in bytes of each side's own sample size. */
+        if (region->dense)
+            run = nelmts - src_off;
+        n = file_len[ifile] / src_size;
+        if (n > mem_len[imem] / dst_size)
+            n = mem_len[imem] / dst_size;
+        if (n > run)
+            n = run;
+
+        geotiff_copy_strided(buf + mem_off[imem], 1, chunk_buf + src_off * src_size,
+                             region->dense ? 1 : region->stride[inner], n, conv);
+
+        file_off[ifile] += n * src_size;
+        file_len[ifile] -= n * src_size;
+        if (file_len[ifile] == 0)
+            ifile++;
+        mem_off[imem] += n * dst_size;
+        mem_len[imem] -= n * dst_size;
+        if (mem_len[imem] == 0)
+            imem++;
+    }
+
+    ret = 0;
+
+done:
+    if (mem_iter >= 0)
+        H5Ssel_iter_close(mem_iter);
+    if (file_iter >= 0)
+        H5Ssel_iter_close(file_iter);
+    if (chunk_mem >= 0)
+        H5Sclose(chunk_mem);
+    if (box >= 0)
+        H5Sclose(box);
+    if (chunk_file >= 0)
+        H5Sclose(chunk_file);
+
+    return ret;
+}
+
+/* Helper function to choose how samples reach the memory type. Returns 1 if
+ * the connector converts them itself, 0 if H5Tconvert() has to, -1 on error. */
+static int geotiff_get_conv(const geotiff_image_t *image, hid_t mem_type_id, geotiff_conv_t *conv)
+{
+    size_t mem_size;
+    int src, dst;
+
+    if ((mem_size = H5Tget_size(mem_type_id)) == 0)
+        return -1;
+
+    conv->func = NULL;
+    conv->src_size = image->elem_size;
+    conv->dst_size = mem_size;
+
+    src = geotiff_get_tiff_ntype(image->sample_format, image->bits_per_sample);
+    if (src < 0) {
+        /* Samples with no native counterpart are only copied as stored */
+        return mem_size == image->elem_size ? 1 : -1;
+    }
+
+    if ((dst = geotiff_get_mem_ntype(mem_type_id)) < 0)
+        return 0;
+
+    conv->func = geotiff_get_convert((geotiff_ntype_t) src, (geotiff_ntype_t) dst);
+
+    return 1;
+}
+
+/* Helper function to set up one dataset's share of a read, and add the chunks
+ * (tiles or strips of each page) its file selection intersects to the needs
+ * array */
+static herr_t geotiff_read_prepare(geotiff_read_t *rd, hid_t mem_space_id, hid_t file_space_id,
+                                   geotiff_need_t **needs, size_t *nneeds, size_t *alloc)
+{
+    const geotiff_dataset_t *dset = rd->dset;
+    const geotiff_image_t *image = &dset->image;
+    hsize_t lo[H5S_MAX_RANK], hi[H5S_MAX_RANK], end[GEOTIFF_NAXES];
+    hsize_t alo[GEOTIFF_NAXES], ahi[GEOTIFF_NAXES];
+    geotiff_region_t region;
+    hssize_t npoints;
+    size_t n[GEOTIFF_NAXES], ncand, i;
+    int is_block, is_dense, d;
+
+    /* H5S_ALL selects the whole dataset in the file, and mirrors the file
+     * selection in memory */
+    rd->file_space = (file_space_id == H5S_ALL) ? dset->space_id : file_space_id;
+    rd->mem_space = (mem_space_id == H5S_ALL) ? rd->file_space : mem_space_id;
+
+    if ((npoints = H5Sget_select_npoints(rd->file_space)) < 0)
+        return -1;
+    if (npoints == 0)
+        return 0;
+
+    if (H5Sget_simple_extent_ndims(rd->file_space) != dset->ndims)
+        return -1;
+    if (H5Sget_select_bounds(rd->file_space, lo, hi) < 0)
+        return -1;
+
+#ifdef H5S_BLOCK
+    /* H5S_BLOCK is a contiguous buffer holding exactly the selected elements */
+    if (mem_space_id == H5S_BLOCK) {
+        hsize_t nelmts = (hsize_t) npoints;
+
+        if ((rd->mem_space = rd->block_space = H5Screate_simple(1, &nelmts, NULL)) < 0)
+            return -1;
+    }
+#endif
+
+    /* A single block copied into a dense run of memory needs no dataspace
+     * bookkeeping per chunk, so the decoder threads can copy it themselves */
+    if ((is_block = geotiff_get_select_block(rd->file_space, dset->ndims, rd->block_start,
+                                             rd->block_count)) < 0)
+        return -1;
+    if ((is_dense = geotiff_get_dense_offset(rd->mem_space, &rd->mem_offset)) < 0)
+        return -1;
+    rd->direct = is_block && is_dense;
+
+    /* Bounds of the selection along each axis; axes the dataset does not
+     * have are a single element */
+    memset(alo, 0, sizeof(alo));
+    memset(ahi, 0, sizeof(ahi));
+    for (d = 0; d < dset->ndims; d++) {
+        alo[dset->axes[d]] = lo[d];
+        ahi[dset->axes[d]] = hi[d];
+    }
+
+    /* Only the planes of selected bands are read when bands are separate */
+    if (!image->is_separate) {
+        alo[GEOTIFF_AXIS_BAND] = 0;
+        ahi[GEOTIFF_AXIS_BAND] = 0;
+    }
+
+    /* Make room for every chunk of the selection's bounding box */
+    alo[GEOTIFF_AXIS_Y] /= image->chunk_height;
+    ahi[GEOTIFF_AXIS_Y] /= image->chunk_height;
+    alo[GEOTIFF_AXIS_X] /= image->chunk_width;
+    ahi[GEOTIFF_AXIS_X] /= image->chunk_width;
+    for (d = 0, ncand = 1; d < GEOTIFF_NAXES; d++) {
+        n[d] = (size_t) (ahi[d] - alo[d] + 1);
+        ncand *= n[d];
+    }
+    if (*nneeds + ncand > *alloc) {
+        size_t new_alloc = 2 * (*alloc) > *nneeds + ncand ? 2 * (*alloc) : *nneeds + ncand;
+        geotiff_need_t *grown;
+
+        if (!(grown = (geotiff_need_t *) realloc(*needs, new_alloc * sizeof(geotiff_need_t))))
+            return -1;
+        *needs = grown;
+        *alloc = new_alloc;
+    }
+
+    /* Collect the chunks that intersect the file selection. Pages and band
+     * planes outside the selection are never visited, so they are not read. */
+    for (i = 0; i < ncand; i++) {
+        uint32_t idx[GEOTIFF_NAXES], chunk;
+        size_t rest = i;
+
+        for (d = GEOTIFF_NAXES - 1; d >= 0; d--) {
+            idx[d] = (uint32_t) (alo[d] + rest % n[d]);
+            rest /= n[d];
+        }
+        chunk = idx[GEOTIFF_AXIS_BAND] * image->chunks_per_plane +
+                idx[GEOTIFF_AXIS_Y] * image->chunks_across + idx[GEOTIFF_AXIS_X];
+
+        if (!is_block) {
+            htri_t hit;
+
+            geotiff_get_chunk_region(dset, idx[GEOTIFF_AXIS_PAGE], chunk, &region);
+            for (d = 0; d < dset->ndims; d++)
+                end[d] = region.start[d] + region.count[d] - 1;
+            if ((hit = H5Sselect_intersect_block(rd->file_space, region.start, end)) < 0)
+                return -1;
+            if (!hit)
+                continue;
+        }
+
+        (*needs)[*nneeds].rd = rd;
+        (*needs)[*nneeds].page = idx[GEOTIFF_AXIS_PAGE];
+        (*needs)[*nneeds].chunk = chunk;
+        (*needs)[*nneeds].run = NULL;
+        (*nneeds)++;
+    }
+
+    return 0;
+}
+
+/* Helper function to get the directory a needed chunk is decoded from */
+static uint32_t geotiff_need_ifd(const geotiff_need_t *need)
+{
+    return need->rd->dset->pages[need->page];
+}
+
+/* Helper function to order needs by image, then chunk, so that every dataset
+ * needing the same chunk of the same image is served by one decode */
+static int geotiff_need_cmp(const void *a, const void *b)
+{
+    const geotiff_need_t *na = (const geotiff_need_t *) a, *nb = (const geotiff_need_t *) b;
+    const geotiff_file_id_t *fa = &na->rd->dset->file->id, *fb = &nb->rd->dset->file->id;
+    uint32_t ia = geotiff_need_ifd(na), ib = geotiff_need_ifd(nb);
+
+    if (fa->dev != fb->dev)
+        return fa->dev < fb->dev ? -1 : 1;
+    if (fa->ino != fb->ino)
+        return fa->ino < fb->ino ? -1 : 1;
+    if (fa->size != fb->size)
+        return fa->size < fb->size ? -1 : 1;
+    if (fa->mtime != fb->mtime)
+        return fa->mtime < fb->mtime ? -1 : 1;
+    if (fa->mtime_nsec != fb->mtime_nsec)
+        return fa->mtime_nsec < fb->mtime_nsec ? -1 : 1;
+    if (fa->ctime != fb->ctime)
+        return fa->ctime < fb->ctime ? -1 : 1;
+    if (fa->generation != fb->generation)
+        return fa->generation < fb->generation ? -1 : 1;
+    if (ia != ib)
+        return ia < ib ? -1 : 1;
+    if (na->chunk != nb->chunk)
+        return na->chunk < nb->chunk ? -1 : 1;
+    if (na->rd != nb->rd)
+        return na->rd < nb->rd ? -1 : 1;
+    return 0;
+}
+
+/* Helper function to check whether two needs are for the same chunk */
+static int geotiff_need_same_chunk(const geotiff_need_t *a, const geotiff_need_t *b)
+{
+    return a->chunk == b->chunk && geotiff_need_ifd(a) == geotiff_need_ifd(b) &&
+           !memcmp(&a->rd->dset->file->id, &b->rd->dset->file->id, sizeof(geotiff_file_id_t));
+}
+
+/* Helper function to hand the cache entries of a batch back */
+static void geotiff_release_slots(geotiff_slot_t *slots, size_t nslots)
+{
+    size_t i;
+
+    for (i = 0; i < nslots; i++) {
+        geotiff_cache_release(slots[i].entry);
+        geotiff_run_release(slots[i].run);
+        slots[i].entry = NULL;
+        slots[i].data = NULL;
+        slots[i].run = NULL;
+    }
+}
+
+/* Chunk stored in one range of a file, while planning which to read at once */
+typedef struct geotiff_extent_t {
+    const geotiff_file_t *file; /* File the chunk is in */
+    uint64_t offset;            /* File offset of its stored bytes */
+    uint64_t size;              /* Number of stored bytes */
+    geotiff_need_t *need;       /* First need of the chunk */
+} geotiff_extent_t;
+
+static int geotiff_extent_cmp(const void *a, const void *b)
+{
+    const geotiff_extent_t *ea = (const geotiff_extent_t *) a, *eb = (const geotiff_extent_t *) b;
+
+    if (ea->file != eb->file)
+        return (uintptr_t) ea->file < (uintptr_t) eb->file ? -1 : 1;
+    if (ea->offset != eb->offset)
+        return ea->offset < eb->offset ? -1 : 1;
+    return 0;
+}
+
+/* Helper function to plan the file reads of a read: the stored ranges of the
+ * chunks libtiff would read one at a time are sorted by file offset, and
+ * ranges at most the file's gap apart are merged into one read, which the
+ * tasks decoding them share. The kernel is asked to fetch every merged range
+ * ahead of the decoders. Chunks left out (mapped, streamed by scanline, in
+ * a file held in memory, or with nothing near them) are read by libtiff as
+ * before. Makes TIFF calls on the files' own handles, so must run on the
+ * calling thread. */
+static void geotiff_plan_runs(geotiff_need_t *needs, size_t nneeds)
+{
+    geotiff_extent_t *extents;
+    geotiff_chunk_table_t table;
+    TIFF *tiff;
+    size_t nextents = 0, i, j, k;
+
+    if (!(extents = (geotiff_extent_t *) malloc(nneeds * sizeof(geotiff_extent_t))))
+        return;
+
+    for (i = 0; i < nneeds; i++) {
+        const geotiff_dataset_t *dset = needs[i].rd->dset;
+        geotiff_file_t *file = dset->file;
+        uint64_t ifd_offset = file->ifds[geotiff_need_ifd(&needs[i])].offset;
+        geotiff_extent_t *e = &extents[nextents];
+
+        if (i > 0 && geotiff_need_same_chunk(&needs[i - 1], &needs[i]))
+            continue;
+        if (dset->raw_offsets || dset->image.by_scanline || geotiff_storage_resident(file->storage))
+            continue;
+
+        /* Chunk queries may have loaded the offsets of every chunk already,
+         * and the sidecar index has them all */
+        tiff = geotiff_handles_lock(file->handles);
+        if (dset->stored_sizes) {
+            size_t pos = (size_t) needs[i].page * dset->image.chunks_per_plane *
+                             (dset->image.is_separate ? dset->image.samples_per_pixel : 1) +
+                         needs[i].chunk;
+
+            e->offset = dset->stored_offsets[pos];
+            e->size = dset->stored_sizes[pos];
+        } else if (file->index) {
+            e->size = 0;
+            if (geotiff_index_chunks(file->index, geotiff_need_ifd(&needs[i]), &table) == 0 &&
+                needs[i].chunk < table.nchunks) {
+                e->offset = table.offsets[needs[i].chunk];
+                e->size = table.counts[needs[i].chunk];
+            }
+        } else if ((tiff = geotiff_handles_own(file->handles)) &&
+                   (TIFFCurrentDirOffset(tiff) == ifd_offset ||
+                    TIFFSetSubDirectory(tiff, ifd_offset))) {
+            e->offset = TIFFGetStrileOffset(tiff, needs[i].chunk);
+            e->size = TIFFGetStrileByteCount(tiff, needs[i].chunk);
+        } else {
+            e->size = 0;
+        }
+        geotiff_handles_unlock(file->handles);
+        if (e->size == 0 || e->size > GEOTIFF_MAX_RUN_BYTES)
+            continue;
+        e->file = file;
+        e->need = &needs[i];
+        nextents++;
+    }
+
+    qsort(extents, nextents, sizeof(geotiff_extent_t), geotiff_extent_cmp);
+
+    for (i = 0; i < nextents; i = j) {
+        uint64_t start = extents[i].offset, end = start + extents[i].size;
+        geotiff_run_t *run;
+
+        for (j = i + 1; j < nextents; j++) {
+            uint64_t next_end = extents[j].offset + extents[j].size;
+
+            if (extents[j].file != extents[i].file ||
+                extents[j].offset > end + extents[i].file->gap)
+                break;
+            if (next_end > end) {
+                if (next_end - start > GEOTIFF_MAX_RUN_BYTES)
+                    break;
+                end = next_end;
+            }
+        }
+        if (j - i < 2 || !(run = geotiff_run_create(start, (size_t) (end - start),
+                                                    (unsigned) (j - i))))
+            continue;
+
+        for (k = i; k < j; k++)
+            extents[k].need->run = run;
+        geotiff_storage_willneed(extents[i].file->storage, start, end - start);
+    }
+
+    free(extents);
+}
+
+/* Helper function to drop the merged ranges of the needs from next on, whose
+ * chunks will not be decoded */
+static void geotiff_release_runs(geotiff_need_t *needs, size_t nneeds, size_t next)
+{
+    for (; next < nneeds; next++) {
+        geotiff_run_release(needs[next].run);
+        needs[next].run = NULL;
+    }
+}
+
+/* Helper function to set up every dataset's share of a read, and collect the
+ * chunks their file selections intersect in needs, ordered so that the needs
+ * of each distinct chunk are adjacent. Also counts the distinct chunks, and
+ * how many threads may decode them. */
+static herr_t geotiff_read_collect(size_t count, geotiff_read_t *reads,
+                                   const hid_t mem_space_id[], const hid_t file_space_id[],
+                                   geotiff_need_t **needs, size_t *nneeds, size_t *ndistinct,
+                                   unsigned *threads)
+{
+    size_t nalloc = 0, i;
+
+    *needs = NULL;
+    *nneeds = *ndistinct = 0;
+    *threads = 1;
+
+    for (i = 0; i < count; i++) {
+        if (geotiff_read_prepare(&reads[i], mem_space_id[i], file_space_id[i], needs, nneeds,
+                                 &nalloc) < 0)
+            return -1;
+
+        if (reads[i].dset->file->threads > *threads)
+            *threads = reads[i].dset->file->threads;
+    }
+
+    if (*nneeds == 0)
+        return 0;
+
+    qsort(*needs, *nneeds, sizeof(geotiff_need_t), geotiff_need_cmp);
+    for (i = 0; i < *nneeds; i++)
+        if (i == 0 || !geotiff_need_same_chunk(&(*needs)[i - 1], &(*needs)[i]))
+            (*ndistinct)++;
+
+    /* Bands of one oversized strip have to be decoded in order on one handle */
+    for (i = 0; i < *nneeds; i++)
+        if ((*needs)[i].rd->dset->image.by_scanline)
+            *threads = 1;
+
+    return 0;
+}
+
+/* Helper function to group the needs of each of the next (up to) nslots
+ * distinct chunks into a slot, which takes over the chunk's merged range,
+ * returning how many slots were filled */
+static size_t geotiff_fill_slots(geotiff_slot_t *slots, size_t nslots, geotiff_need_t *needs,
+                                 size_t nneeds, size_t *next)
+{
+    size_t nbatch = 0;
+
+    while (nbatch < nslots && *next < nneeds) {
+        geotiff_slot_t *slot = &slots[nbatch++];
+
+        slot->needs = &needs[*next];
+        slot->run = needs[*next].run;
+        needs[*next].run = NULL;
+        slot->nneeds = 1;
+        while (++(*next) < nneeds && geotiff_need_same_chunk(&needs[*next - 1], &needs[*next]))
+            slot->nneeds++;
+    }
+
+    return nbatch;
+}
+
+/* Helper function to decode the chunks collected by geotiff_read_collect(),
+ * a batch at a time across the decoder threads, straight into the memory
+ * selection of each buffer */
+static herr_t geotiff_read_chunks(geotiff_need_t *needs, size_t nneeds, size_t ndistinct,
+                                  unsigned threads)
+{
+    geotiff_plan_t plan;
+    geotiff_pool_t *pool = NULL;
+    size_t nslots, next = 0, i, j;
+    geotiff_region_t region;
+    herr_t ret = -1;
+
+    memset(&plan, 0, sizeof(plan));
+
+    geotiff_plan_runs(needs, nneeds);
+
+    if (threads > 1)
+        pool = geotiff_pool_get(threads - 1);
+
+    /* A couple of chunks per thread keeps the threads busy while the working
+     * set stays independent of the image size */
+    nslots = threads > 1 ? 2 * (size_t) threads : 1;
+    if (nslots > ndistinct)
+        nslots = ndistinct;
+    if (!(plan.slots = (geotiff_slot_t *) calloc(nslots, sizeof(geotiff_slot_t))))
+        goto done;
+    plan.use_cache = geotiff_cache_enabled();
+
+    while (next < nneeds) {
+        size_t nbatch = geotiff_fill_slots(plan.slots, nslots, needs, nneeds, &next);
+
+        if (geotiff_pool_run(pool, nbatch, threads - 1, geotiff_read_chunk_task, &plan) < 0)
+            goto done;
+
+        /* Arbitrary selections are mapped with HDF5 calls on this thread */
+        for (i = 0; i < nbatch; i++) {
+            const geotiff_slot_t *slot = &plan.slots[i];
+
+            for (j = 0; j < slot->nneeds; j++) {
+                const geotiff_read_t *rd = slot->needs[j].rd;
+                uint64_t start = geotiff_now_ns();
+
+                if (rd->direct)
+                    continue;
+                geotiff_get_chunk_region(rd->dset, slot->needs[j].page, slot->needs[j].chunk,
+                                         &region);
+                if (geotiff_scatter_chunk(rd->dset, rd->file_space, rd->mem_space, &region,
+                                          slot->data, &rd->conv, rd->buf) < 0)
+                    goto done;
+                geotiff_count(&rd->dset->file->stats, GEOTIFF_COUNTER_CONVERT_NS,
+                              geotiff_now_ns() - start);
+            }
+        }
+
+        geotiff_release_slots(plan.slots, nbatch);
+    }
+
+    ret = 0;
+
+done:
+    if (plan.slots) {
+        geotiff_release_slots(plan.slots, nslots);
+        for (i = 0; i < nslots; i++)
+            free(plan.slots[i].buf);
+        free(plan.slots);
+    }
+    geotiff_release_runs(needs, nneeds, next);
+
+    return ret;
+}
+
+/* Helper function to read selections of one or more image datasets in one
+ * pass. The chunks (tiles or strips) that intersect any file selection are
+ * decoded once each, even when several datasets of the same image need them,
+ * converted as conv says on the way. */
+static herr_t geotiff_read_selections(size_t count, geotiff_read_t *reads,
+                                      const hid_t mem_space_id[], const hid_t file_space_id[])
+{
+    geotiff_need_t *needs = NULL;
+    size_t nneeds, ndistinct;
+    unsigned threads;
+    herr_t ret = -1;
+
+    if (geotiff_read_collect(count, reads, mem_space_id, file_space_id, &needs, &nneeds,
+                             &ndistinct, &threads) < 0)
+        goto done;
+
+    ret = nneeds > 0 ? geotiff_read_chunks(needs, nneeds, ndistinct, threads) : 0;
+
+done:
+    free(needs);
+
+    return ret;
+}
+
+/* Helper function to count a read issued at start, now complete, against a
+ * file */
+static void geotiff_count_read(geotiff_file_t *file, uint64_t start)
+{
+    geotiff_count(&file->stats, GEOTIFF_COUNTER_READS, 1);
+    geotiff_count(&file->stats, GEOTIFF_COUNTER_READ_NS, geotiff_now_ns() - start);
+}
+
+/* Pool done callback of an asynchronous read, called on the thread that
+ * finished its last chunk, or with a negative status on one where it failed
+ * to start or was cancelled: the read no longer uses its files */
+static void geotiff_read_done(void *ctx, herr_t status)
+{
+    const geotiff_plan_t *plan = (const geotiff_plan_t *) ctx;
+    size_t i, j;
+
+    /* Count a read that succeeded once for each file it read from, as
+     * synchronous reads are, before the files can be closed */
+    for (i = 0; i < plan->nreads && status >= 0; i++) {
+        for (j = 0; j < i; j++)
+            if (plan->reads[j].dset->file == plan->reads[i].dset->file)
+                break;
+        if (j == i)
+            geotiff_count_read(plan->reads[i].dset->file, plan->start);
+    }
+
+    pthread_mutex_lock(&geotiff_pending_mutex_g);
+    for (i = 0; i < plan->nreads; i++)
+        plan->reads[i].dset->file->pending--;
+    pthread_cond_broadcast(&geotiff_pending_cond_g);
+    pthread_mutex_unlock(&geotiff_pending_mutex_g);
+}
+
+/* Helper function to free an asynchronous read once its tasks are done */
+static void geotiff_request_destroy(geotiff_request_t *request)
+{
+    size_t i;
+
+    geotiff_batch_free(request->batch);
+    for (i = 0; i < request->plan.nreads; i++)
+        if (request->plan.reads[i].block_space >= 0)
+            H5Sclose(request->plan.reads[i].block_space);
+    if (request->plan.slots) {
+        geotiff_release_slots(request->plan.slots, request->nslots);
+        for (i = 0; i < request->nslots; i++)
+            free(request->plan.slots[i].buf);
+        free(request->plan.slots);
+    }
+    geotiff_release_runs(request->needs, request->nneeds, 0);
+    free(request->needs);
+    free(request->plan.reads);
+    free(request);
+}
+
+/* Helper function to start reading selections in the background, when every
+ * share of the read can be copied by the decode tasks. The HDF5 calls that
+ * set the read up are made here, on the calling thread; the request returned
+ * in *req then needs none. Reads that do need HDF5 calls per chunk (arbitrary
+ * selections) are done before returning, leaving *req NULL, which HDF5 takes
+ * to mean the operation has already completed. Takes ownership of reads. */
+static herr_t geotiff_read_selections_async(size_t count, geotiff_read_t *reads,
+                                            const hid_t mem_space_id[],
+                                            const hid_t file_space_id[], uint64_t start,
+                                            void **req)
+{
+    geotiff_request_t *request;
+    geotiff_pool_t *pool;
+    size_t ndistinct, nneeds, next = 0, i;
+    unsigned threads;
+    herr_t ret = -1;
+
+    if (!(request = (geotiff_request_t *) calloc(1, sizeof(geotiff_request_t)))) {
+        free(reads);
+        return -1;
+    }
+    request->plan.reads = reads;
+    request->plan.nreads = count;
+    request->plan.start = start;
+
+    if (geotiff_read_collect(count, reads, mem_space_id, file_space_id, &request->needs,
+                             &request->nneeds, &ndistinct, &threads) < 0)
+        goto done;
+    nneeds = request->nneeds;
+    if (nneeds == 0) {
+        ret = 0;
+        goto done;
+    }
+
+    for (i = 0; i < count; i++)
+        if (!reads[i].direct)
+            break;
+    if (i < count) {
+        ret = geotiff_read_chunks(request->needs, nneeds, ndistinct, threads);
+        goto done;
+    }
+
+    /* The decode tasks never touch the dataspaces */
+    for (i = 0; i < count; i++) {
+        if (reads[i].block_space >= 0)
+            H5Sclose(reads[i].block_space);
+        reads[i].block_space = H5I_INVALID_HID;
+    }
+
+    /* Every distinct chunk gets a slot of its own; each task lets go of its
+     * chunk once copied, so only the chunks being decoded are held */
+    geotiff_plan_runs(request->needs, nneeds);
+    if (!(request->plan.slots = (geotiff_slot_t *) calloc(ndistinct, sizeof(geotiff_slot_t))))
+        goto done;
+    request->nslots = geotiff_fill_slots(request->plan.slots, ndistinct, request->needs, nneeds,
+                                         &next);
+    request->plan.use_cache = geotiff_cache_enabled();
+    request->plan.background = 1;
+
+    pthread_mutex_lock(&geotiff_pending_mutex_g);
+    for (i = 0; i < count; i++)
+        reads[i].dset->file->pending++;
+    pthread_mutex_unlock(&geotiff_pending_mutex_g);
+
+    /* All of the decoding happens on pool threads, so the calling thread
+     * returns at once */
+    pool = geotiff_pool_get(threads);
+    if (!(request->batch = geotiff_pool_start(pool, request->nslots, threads,
+                                              geotiff_read_chunk_task, geotiff_read_done,
+                                              &request->plan))) {
+        geotiff_read_done(&request->plan, -1);
+        goto done;
+    }
+
+    *req = request;
+    return 0;
+
+done:
+    geotiff_request_destroy(request);
+
+    return ret;
+}
+
+/* Request operations: wait for, be notified of, or cancel an asynchronous
+ * read. The notify callback is HDF5's, so it is only ever called from the
+ * threads calling into the connector, never from a pool thread. */
+
+/* Helper function to get the final status of a finished read, calling its
+ * notify callback the first time */
+static H5VL_request_status_t geotiff_request_finished(geotiff_request_t *request)
+{
+    H5VL_request_status_t status;
+    H5VL_request_notify_t notify = request->notify;
+
+    if (request->cancelled)
+        status = H5VL_REQUEST_STATUS_CANCELED;
+    else if (geotiff_batch_status(request->batch) < 0)
+        status = H5VL_REQUEST_STATUS_FAIL;
+    else
+        status = H5VL_REQUEST_STATUS_SUCCEED;
+
+    if (notify) {
+        request->notify = NULL;
+        notify(request->notify_ctx, status);
+    }
+
+    return status;
+}
+
+herr_t geotiff_request_wait(void *req, uint64_t timeout, H5VL_request_status_t *status)
+{
+    geotiff_request_t *request = (geotiff_request_t *) req;
+
+    if (!request || !status)
+        return -1;
+
+    if (geotiff_batch_wait(request->batch, timeout))
+        *status = geotiff_request_finished(request);
+    else
+        *status = H5VL_REQUEST_STATUS_IN_PROGRESS;
+
+    return 0;
+}
+
+herr_t geotiff_request_notify(void *req, H5VL_request_notify_t cb, void *ctx)
+{
+    geotiff_request_t *request = (geotiff_request_t *) req;
+
+    if (!request)
+        return -1;
+
+    request->notify = cb;
+    request->notify_ctx = ctx;
+
+    /* A read that has already finished is reported at once; any other on the
+     * next wait that sees it finish */
+    if (cb && geotiff_batch_wait(request->batch, 0))
+        geotiff_request_finished(request);
+
+    return 0;
+}
+
+herr_t geotiff_request_cancel(void *req, H5VL_request_status_t *status)
+{
+    geotiff_request_t *request = (geotiff_request_t *) req;
+
+    if (!request || !status)
+        return -1;
+
+    /* Only a read no pool thread has started on can be cancelled; one that
+     * is running must be waited for, as it is writing to the caller's buffer */
+    if (geotiff_batch_cancel(request->batch)) {
+        request->cancelled = 1;
+        *status = geotiff_request_finished(request);
+    } else if (geotiff_batch_wait(request->batch, 0)) {
+        *status = geotiff_request_finished(request);
+    } else {
+        *status = H5VL_REQUEST_STATUS_CANT_CANCEL;
+    }
+
+    return 0;
+}
+
+herr_t geotiff_request_free(void *req)
+{
+    if (!req)
+        return -1;
+
+    /* Waits for the decode tasks first, should the read still be running */
+    geotiff_request_destroy((geotiff_request_t *) req);
+
+    return 0;
+}
+
+/* Source of H5Dscatter(): one buffer holding every converted element */
+typedef struct geotiff_scatter_src_t {
+    const void *buf; /* Converted elements */
+    size_t size;     /* Size of buf in bytes */
+} geotiff_scatter_src_t;
+
+static herr_t geotiff_scatter_src_cb(const void **src_buf, size_t *src_buf_bytes_used,
+                                     void *op_data)
+{
+    const geotiff_scatter_src_t *src = (const geotiff_scatter_src_t *) op_data;
+
+    *src_buf = src->buf;
+    *src_buf_bytes_used = src->size;
+
+    return 0;
+}
+
+/* Helper function to read into a memory type the connector does not convert
+ * itself (e.g. other-endian or compound types): read the selection as stored
+ * into a dense buffer, convert it there with H5Tconvert(), then scatter it to
+ * the memory selection */
+static herr_t geotiff_read_converted(geotiff_dataset_t *dset, hid_t mem_type_id,
+                                     hid_t mem_space_id, hid_t file_space_id, void *buf)
+{
+    geotiff_read_t rd;
+    geotiff_scatter_src_t src;
+    hid_t file_space, mem_space, dense_space = H5I_INVALID_HID;
+    hssize_t npoints;
+    hsize_t nelmts;
+    size_t mem_size, elem_size = dset->image.elem_size;
+    unsigned char *tbuf = NULL;
+    uint64_t start;
+    herr_t ret = -1;
+
+    file_space = (file_space_id == H5S_ALL) ? dset->space_id : file_space_id;
+    mem_space = (mem_space_id == H5S_ALL) ? file_space : mem_space_id;
+
+    if ((mem_size = H5Tget_size(mem_type_id)) == 0)
+        return -1;
+    if ((npoints = H5Sget_select_npoints(file_space)) < 0)
+        return -1;
+    if (npoints == 0)
+        return 0;
+
+    nelmts = (hsize_t) npoints;
+    if (!(tbuf = (unsigned char *) malloc((size_t) nelmts *
+                                          (mem_size > elem_size ? mem_size : elem_size))))
+        return -1;
+    if ((dense_space = H5Screate_simple(1, &nelmts, NULL)) < 0)
+        goto done;
+
+    memset(&rd, 0, sizeof(rd));
+    rd.dset = dset;
+    rd.block_space = H5I_INVALID_HID;
+    rd.conv.src_size = rd.conv.dst_size = elem_size;
+    rd.buf = tbuf;
+    if (geotiff_read_selections(1, &rd, &dense_space, &file_space_id) < 0)
+        goto done;
+    start = geotiff_now_ns();
+    if (H5Tconvert(dset->type_id, mem_type_id, (size_t) nelmts, tbuf, NULL, H5P_DEFAULT) < 0)
+        goto done;
+
+#ifdef H5S_BLOCK
+    if (mem_space_id == H5S_BLOCK) {
+        memcpy(buf, tbuf, (size_t) nelmts * mem_size);
+        geotiff_count(&dset->file->stats, GEOTIFF_COUNTER_CONVERT_NS, geotiff_now_ns() - start);
+        ret = 0;
+        goto done;
+    }
+#endif
+
+    src.buf = tbuf;
+    src.size = (size_t) nelmts * mem_size;
+    if (H5Dscatter(geotiff_scatter_src_cb, &src, mem_type_id, mem_space, buf) < 0)
+        goto done;
+    geotiff_count(&dset->file->stats, GEOTIFF_COUNTER_CONVERT_NS, geotiff_now_ns() - start);
+
+    ret = 0;
+
+done:
+    if (dense_space >= 0)
+        H5Sclose(dense_space);
+    free(tbuf);
+
+    return ret;
+}
+
+/* Helper function to read a selection of a coordinate variable. Values are
+ * computed for the selected elements only, a run of a row at a time, and
+ * converted to the memory type on the way out. */
+herr_t geotiff_read_coords_data(geotiff_dataset_t *dset, hid_t mem_type_id, hid_t mem_space_id,
+                                hid_t file_space_id, void *buf)
+{
+    const geotiff_transform_t *transform;
+    geotiff_scatter_src_t src;
+    geotiff_convert_func_t convert = NULL;
+    hid_t file_space, mem_space, iter = H5I_INVALID_HID;
+    hsize_t off[GEOTIFF_SEQ_LIST_LEN], start[2], count[2], nelmts, width, offset;
+    size_t len[GEOTIFF_SEQ_LIST_LEN], nseq, nbytes, mem_size, i, run, pos = 0;
+    hssize_t npoints;
+    double *values = NULL;
+    unsigned char *out = NULL;
+    int ntype, dense;
+    herr_t ret = -1;
+
+    if (!dset || dset->is_image || !dset->file || !buf)
+        return -1;
+    transform = &dset->file->coords.transform;
+
+    file_space = (file_space_id == H5S_ALL) ? dset->space_id : file_space_id;
+    mem_space = (mem_space_id == H5S_ALL) ? file_space : mem_space_id;
+
+    if ((mem_size = H5Tget_size(mem_type_id)) == 0)
+        return -1;
+    if ((npoints = H5Sget_select_npoints(file_space)) < 0)
+        return -1;
+    if (npoints == 0)
+        return 0;
+    nelmts = (hsize_t) npoints;
+
+    if (!(values = (double *) malloc((size_t) nelmts * sizeof(double))))
+        return -1;
+
+    /* Walk the selection in the order H5Dscatter() fills the memory
+     * selection, with offsets counted in elements; a sequence may run over
+     * several rows of a 2-D variable */
+    width = dset->dims[dset->ndims - 1];
+    if ((iter = H5Ssel_iter_create(file_space, 1, 0)) < 0)
+        goto done;
+    for (;;) {
+        if (H5Ssel_iter_get_seq_list(iter, GEOTIFF_SEQ_LIST_LEN, SIZE_MAX, &nseq, &nbytes, off,
+                                     len) < 0)
+            goto done;
+        if (nseq == 0)
+            break;
+        for (i = 0; i < nseq; i++) {
+            while (len[i] > 0) {
+                start[0] = off[i] / width;
+                start[1] = off[i] % width;
+                run = len[i];
+                if (dset->ndims == 1)
+                    start[0] = off[i];
+                else if (run > width - start[1])
+                    run = (size_t) (width - start[1]);
+                count[0] = dset->ndims == 1 ? run : 1;
+                count[1] = run;
+                if (pos + run > nelmts)
+                    goto done;
+                geotiff_coords_fill(transform, dset->coord, start, count, values + pos);
+                pos += run;
+                off[i] += run;
+                len[i] -= run;
+            }
+        }
+    }
+
+    /* Native numbers are converted by the connector, anything else by HDF5 */
+    if ((ntype = geotiff_get_mem_ntype(mem_type_id)) >= 0) {
+        convert = geotiff_get_convert(GEOTIFF_F64, (geotiff_ntype_t) ntype);
+    } else if (mem_size > sizeof(double)) {
+        double *grown = (double *) realloc(values, (size_t) nelmts * mem_size);
+
+        if (!grown)
+            goto done;
+        values = grown;
+    }
+    if (convert) {
+        if (!(out = (unsigned char *) malloc((size_t) nelmts * mem_size)))
+            goto done;
+        convert(out, values, (size_t) nelmts);
+    } else {
+        if (ntype < 0 && H5Tconvert(H5T_NATIVE_DOUBLE, mem_type_id, (size_t) nelmts, values,
+                                    NULL, H5P_DEFAULT) < 0)
+            goto done;
+        out = (unsigned char *) values;
+        values = NULL;
+    }
+
+#ifdef H5S_BLOCK
+    if (mem_space_id == H5S_BLOCK) {
+        memcpy(buf, out, (size_t) nelmts * mem_size);
+        ret = 0;
+        goto done;
+    }
+#endif
+    if ((dense = geotiff_get_dense_offset(mem_space, &offset)) < 0)
+        goto done;
+    if (dense) {
+        memcpy((unsigned char *) buf + offset * mem_size, out, (size_t) nelmts * mem_size);
+        ret = 0;
+        goto done;
+    }
+
+    src.buf = out;
+    src.size = (size_t) nelmts * mem_size;
+    if (H5Dscatter(geotiff_scatter_src_cb, &src, mem_type_id, mem_space, buf) < 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (iter >= 0)
+        H5Ssel_iter_close(iter);
+    free(values);
+    free(out);
+
+    return ret;
+}
+
+/* Helper function to read selections of count image datasets, each as its
+ * own mem_type_id. Native integer and floating point memory types are
+ * converted while pixels are copied out of each chunk, so every sample is
+ * touched once, and all such datasets share one decode pass; any other type
+ * HDF5 can convert to goes through H5Tconvert(). When req is not NULL, the
+ * decode pass may run in the background, with *req set to its request. */
+herr_t geotiff_read_image_data(size_t count, geotiff_dataset_t *dset[], const hid_t mem_type_id[],
+                               const hid_t mem_space_id[], const hid_t file_space_id[],
+                               void *buf[], void **req)
+{
+    geotiff_read_t *reads;
+    hid_t *mem_spaces = NULL, *file_spaces = NULL;
+    size_t nreads = 0, i, j;
+    uint64_t start = geotiff_now_ns();
+    herr_t ret = -1;
+    int native;
+
+    if (req)
+        *req = NULL;
+
+    if (!(reads = (geotiff_read_t *) calloc(count, sizeof(geotiff_read_t))) ||
+        !(mem_spaces = (hid_t *) malloc(count * sizeof(hid_t))) ||
+        !(file_spaces = (hid_t *) malloc(count * sizeof(hid_t))))
+        goto done;
+
+    for (i = 0; i < count; i++) {
+        geotiff_read_t *rd = &reads[nreads];
+
+        if (!dset[i] || !dset[i]->is_image || !dset[i]->file || !dset[i]->file->handles ||
+            !buf[i])
+            goto done;
+
+        rd->dset = dset[i];
+        rd->block_space = H5I_INVALID_HID;
+        rd->buf = (unsigned char *) buf[i];
+        if ((native = geotiff_get_conv(&dset[i]->image, mem_type_id[i], &rd->conv)) < 0)
+            goto done;
+
+        if (native) {
+            mem_spaces[nreads] = mem_space_id[i];
+            file_spaces[nreads] = file_space_id[i];
+            nreads++;
+        } else if (geotiff_read_converted(dset[i], mem_type_id[i], mem_space_id[i],
+                                          file_space_id[i], buf[i]) < 0) {
+            goto done;
+        }
+    }
+
+    if (req && nreads > 0) {
+        ret = geotiff_read_selections_async(nreads, reads, mem_spaces, file_spaces, start, req);
+        reads = NULL;
+        goto done;
+    }
+    ret = geotiff_read_selections(nreads, reads, mem_spaces, file_spaces);
+
+done:
+    /* A read left running in the background is counted once it completes */
+    if (ret >= 0 && !(req && *req)) {
+        for (i = 0; i < count; i++) {
+            for (j = 0; j < i; j++)
+                if (dset[j]->file == dset[i]->file)
+                    break;
+            if (j == i)
+                geotiff_count_read(dset[i]->file, start);
+        }
+    }
+
+    if (reads) {
+        for (i = 0; i < nreads; i++)
+            if (reads[i].block_space >= 0)
+                H5Sclose(reads[i].block_space);
+        free(reads);
+    }
+    free(file_spaces);
+    free(mem_spaces);
+
+    return ret;
+}
+
+/* Helper function to parse the GeoKeys, ModelTiepoint, ModelPixelScale,
+ * ModelTransformation and GDAL_METADATA/GDAL_NODATA tags of the file's
+ * current (first) directory into its metadata catalog, and set up the
+ * coordinate variables of the image from them */
+herr_t geotiff_parse_geotiff_tags(geotiff_file_t *file)
+{
+    uint32_t width, height;
+
+    if (!file || !file->tiff || !file->gtif)
+        return -1;
+
+    if (!TIFFGetField(file->tiff, TIFFTAG_IMAGEWIDTH, &width) ||
+        !TIFFGetField(file->tiff, TIFFTAG_IMAGELENGTH, &height))
+        return -1;
+    if (geotiff_meta_load(&file->meta, file->tiff, file->gtif) < 0)
+        return -1;
+    if (geotiff_coords_init(file, width, height) < 0) {
+        geotiff_meta_free(&file->meta);
+        return -1;
+    }
 
     return 0;
 }
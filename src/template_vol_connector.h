@@ -36,24 +36,342 @@
 #define GEOTIFF_VOL_CONNECTOR_VALUE ((H5VL_class_value_t) 12203)
 #define GEOTIFF_VOL_CONNECTOR_NAME "geotiff_vol_connector"
 
+/* Default number of threads decoding one read (1 = the calling thread only) */
+#define GEOTIFF_DEFAULT_THREADS 1
+#define GEOTIFF_MAX_THREADS 256
+
+/* Default byte budget of the decoded chunk cache, in MiB (0 disables it) */
+#define GEOTIFF_DEFAULT_CACHE_MB 256
+
+/* Default gap, in KiB, up to which the stored bytes of chunks one read needs
+ * are merged into one file read */
+#define GEOTIFF_DEFAULT_GAP_KB 64
+
+/* Default size, in KiB, of the reads that small reads of a file are rounded
+ * up to and then served from (0 reads exactly what libtiff asks for) */
+#define GEOTIFF_DEFAULT_READAHEAD_KB 0
+
+/* Default open mode: 0 reads a file's directories and GeoKeys in H5Fopen(),
+ * 1 defers that to the first access that needs them */
+#define GEOTIFF_DEFAULT_LAZY 0
+
+/* Default use of sidecar indexes: 0 never, 1 read a file's headers from
+ * "<file>" GEOTIFF_INDEX_SUFFIX when it is up to date, and write it when not */
+#define GEOTIFF_DEFAULT_INDEX 0
+#define GEOTIFF_INDEX_SUFFIX ".gvi"
+
+/* Largest strip decoded in one piece; bigger strips are read by scanline */
+#define GEOTIFF_MAX_CHUNK_BYTES ((uint64_t) 64 * 1024 * 1024)
+
+/* Storage backends a file can be read from */
+typedef enum geotiff_io_t {
+    GEOTIFF_IO_PREAD,  /* pread() on the file (the default) */
+    GEOTIFF_IO_MMAP,   /* A read-only mapping of the whole file */
+    GEOTIFF_IO_DIRECT, /* pread() on the file opened with O_DIRECT, bypassing the page cache */
+    GEOTIFF_IO_MEMORY, /* The file's bytes, already in memory */
+    GEOTIFF_NIO
+} geotiff_io_t;
+
+/* GeoTIFF VOL connector info, parsed from the connector info string, e.g.
+ * HDF5_VOL_CONNECTOR="geotiff_vol_connector threads=8;cache_mb=512;io=mmap" */
+typedef struct geotiff_info_t {
+    unsigned threads;    /* Threads decoding one read */
+    size_t cache_mb;     /* Byte budget of the process-wide chunk cache, in MiB */
+    size_t gap_kb;       /* Largest gap between chunks read in one go, in KiB */
+    geotiff_io_t io;     /* Storage backend */
+    size_t readahead_kb; /* Size small reads are rounded up to, in KiB (0 for none) */
+    const void *buffer;  /* With GEOTIFF_IO_MEMORY, the file's bytes, which the caller keeps
+                          * unchanged until every file opened on them is closed */
+    size_t buffer_size;  /* Size of buffer in bytes */
+    int lazy;            /* Parse the file's headers on first use rather than at open */
+    int index;           /* Keep the file's headers in a sidecar index (geotiff_index.c) */
+} geotiff_info_t;
+
+/* Identity of an open file, the same across opens of the same unchanged file
+ * on disk; every open of a file in memory gets one of its own */
+typedef struct geotiff_file_id_t {
+    uint64_t dev;        /* Device */
+    uint64_t ino;        /* Inode, or a hash of the path where there are none */
+    uint64_t size;       /* File size */
+    uint64_t mtime;      /* Modification time, or the address of a file in memory */
+    uint64_t mtime_nsec; /* Nanoseconds of the modification time, where known */
+    uint64_t ctime;      /* Status change time, which also changes on every write */
+    uint64_t generation; /* Number of the open of a file in memory, 0 on disk */
+} geotiff_file_id_t;
+
+/* Key of a decoded chunk in the process-wide cache (geotiff_cache.c) */
+typedef struct geotiff_cache_key_t {
+    geotiff_file_id_t file; /* File the chunk was decoded from */
+    uint32_t ifd;           /* Directory of the image */
+    uint32_t chunk;         /* Tile or strip (band) index */
+} geotiff_cache_key_t;
+
+typedef struct geotiff_cache_entry_t geotiff_cache_entry_t;
+
+/* Chunk cache counters */
+typedef struct geotiff_cache_stats_t {
+    uint64_t hits;      /* Lookups that found the chunk decoded */
+    uint64_t misses;    /* Lookups that had to decode the chunk */
+    uint64_t evictions; /* Chunks dropped to stay within the budget */
+    size_t entries;     /* Chunks currently cached */
+    size_t bytes;       /* Bytes currently cached */
+    size_t budget;      /* Byte budget */
+} geotiff_cache_stats_t;
+
+/* Counters of how reads were served, kept for each open file and for the
+ * process (geotiff_stats.c) */
+typedef enum geotiff_counter_t {
+    GEOTIFF_COUNTER_CHUNKS_DECODED, /* Chunks decoded by libtiff */
+    GEOTIFF_COUNTER_CHUNKS_MAPPED,  /* Uncompressed chunks used in place in the file mapping */
+    GEOTIFF_COUNTER_RANGES_READ,    /* Merged byte ranges read for several chunks at once */
+    GEOTIFF_COUNTER_CHUNKS_MERGED,  /* Chunks decoded from such a range */
+    GEOTIFF_COUNTER_CACHE_HITS,     /* Chunks found decoded in the chunk cache */
+    GEOTIFF_COUNTER_CACHE_MISSES,   /* Chunks looked up in the chunk cache and decoded */
+    GEOTIFF_COUNTER_BYTES_READ,     /* Bytes read from the file with pread() */
+    GEOTIFF_COUNTER_BYTES_DECODED,  /* Bytes of decoded chunks */
+    GEOTIFF_COUNTER_DECODE_NS,      /* Time spent decoding chunks, in nanoseconds */
+    GEOTIFF_COUNTER_CONVERT_NS,     /* Time spent converting samples into read buffers */
+    GEOTIFF_COUNTER_READS,          /* Dataset reads (H5Dread() calls and the like) */
+    GEOTIFF_COUNTER_READ_NS,        /* Wall time of those reads, up to their completion */
+    GEOTIFF_NCOUNTERS
+} geotiff_counter_t;
+
+/* Codecs decode time is broken down by */
+typedef enum geotiff_codec_t {
+    GEOTIFF_CODEC_NONE,
+    GEOTIFF_CODEC_LZW,
+    GEOTIFF_CODEC_DEFLATE,
+    GEOTIFF_CODEC_JPEG,
+    GEOTIFF_CODEC_PACKBITS,
+    GEOTIFF_CODEC_LZMA,
+    GEOTIFF_CODEC_ZSTD,
+    GEOTIFF_CODEC_WEBP,
+    GEOTIFF_CODEC_LERC,
+    GEOTIFF_CODEC_OTHER,
+    GEOTIFF_NCODECS
+} geotiff_codec_t;
+
+/* Read statistics of a file or of the process */
+typedef struct geotiff_stats_t {
+    uint64_t counters[GEOTIFF_NCOUNTERS];   /* Indexed by geotiff_counter_t */
+    uint64_t codec_chunks[GEOTIFF_NCODECS]; /* Chunks decoded, by codec */
+    uint64_t codec_ns[GEOTIFF_NCODECS];     /* Time spent decoding them, in nanoseconds */
+} geotiff_stats_t;
+
+/* File optional operation, registered by the connector under this name, that
+ * gets the read statistics of the file and of the process. Look its operation
+ * type up with H5VLfind_opt_operation(H5VL_SUBCLS_FILE, ...) and pass
+ * geotiff_get_stats_args_t to H5VLfile_optional_op(). */
+#define GEOTIFF_GET_STATS_OP_NAME "geotiff_vol_connector.get_stats"
+
+typedef struct geotiff_get_stats_args_t {
+    geotiff_stats_t *file;   /* Filled with the file's statistics, if not NULL */
+    geotiff_stats_t *global; /* Filled with the process's statistics, if not NULL */
+} geotiff_get_stats_args_t;
+
+/* Sample types converted between in the connector (geotiff_convert.c) */
+typedef enum geotiff_ntype_t {
+    GEOTIFF_U8,
+    GEOTIFF_I8,
+    GEOTIFF_U16,
+    GEOTIFF_I16,
+    GEOTIFF_U32,
+    GEOTIFF_I32,
+    GEOTIFF_U64,
+    GEOTIFF_I64,
+    GEOTIFF_F32,
+    GEOTIFF_F64,
+    GEOTIFF_NTYPES
+} geotiff_ntype_t;
+
+typedef void (*geotiff_convert_func_t)(void *dst, const void *src, size_t n);
+
+/* Transpose of a rows x cols matrix of samples (geotiff_transpose.c) */
+typedef void (*geotiff_transpose_func_t)(void *dst, size_t dst_stride, const void *src,
+                                         size_t src_stride, size_t rows, size_t cols);
+
+/* One TIFF directory (IFD) of a file, indexed once when the file is opened */
+typedef struct geotiff_ifd_t {
+    uint64_t offset;       /* File offset of the directory */
+    uint32_t subfile_type; /* TIFFTAG_SUBFILETYPE flags, e.g. FILETYPE_REDUCEDIMAGE */
+    int is_raster;         /* The connector can read the image (e.g. not 1-bit masks) */
+} geotiff_ifd_t;
+
+/* Where the tiles or strips of a directory are stored (geotiff_index.c) */
+typedef struct geotiff_chunk_table_t {
+    const uint64_t *offsets; /* File offset of each chunk */
+    const uint64_t *counts;  /* Stored size of each chunk, 0 if it was never written */
+    uint32_t nchunks;        /* Number of chunks, every band plane's included */
+    uint32_t rows;           /* Rows of a full chunk */
+    uint64_t row_bytes;      /* Bytes of a row of a chunk if chunks are stored as libtiff would
+                              * decode them (uncompressed, in native order), else 0 */
+} geotiff_chunk_table_t;
+
+typedef struct geotiff_index_t geotiff_index_t;
+
+/* Longest name of a dataset of the root group, with the terminator */
+#define GEOTIFF_LINK_NAME_LEN 32
+
+/* One dataset of a file's root group: an image, overview, mask, page stack or
+ * coordinate variable */
+typedef struct geotiff_link_t {
+    char name[GEOTIFF_LINK_NAME_LEN]; /* Name of the dataset, e.g. "overview_2" */
+    int is_raster;                    /* Read from directories, and also viewable as "<name>_bsq" */
+} geotiff_link_t;
+
+/* Objects of a file, numbered as in their object tokens: the root group, the
+ * dataset of each link in name order, and the band-sequential view of each */
+#define GEOTIFF_ROOT_ID ((uint64_t) 0)
+#define GEOTIFF_LINK_ID(i) (2 * ((uint64_t) (i) + 1))
+#define GEOTIFF_VIEW_ID(i) (GEOTIFF_LINK_ID(i) + 1)
+#define GEOTIFF_ID_LINK(id) ((uint32_t) ((id) / 2 - 1))
+
+/* Worker thread pool and per-file TIFF handle pool (geotiff_pool.c) */
+typedef struct geotiff_pool_t geotiff_pool_t;
+typedef struct geotiff_handles_t geotiff_handles_t;
+typedef struct geotiff_batch_t geotiff_batch_t;
+
+/* Storage a file's TIFF handles share, and byte range of a file read in one
+ * go for several chunks (geotiff_io.c) */
+typedef struct geotiff_storage_t geotiff_storage_t;
+typedef struct geotiff_run_t geotiff_run_t;
+typedef herr_t (*geotiff_task_func_t)(void *ctx, size_t task);
+typedef void (*geotiff_batch_done_func_t)(void *ctx, herr_t status);
+
+/* Types of georeferencing metadata values */
+typedef enum geotiff_meta_type_t {
+    GEOTIFF_META_SHORT,  /* Unsigned 16-bit integers */
+    GEOTIFF_META_DOUBLE, /* Doubles */
+    GEOTIFF_META_STRING  /* One NUL-terminated string */
+} geotiff_meta_type_t;
+
+/* One GeoKey or georeferencing tag, served as an attribute of the root group */
+typedef struct geotiff_meta_entry_t {
+    uint32_t name;            /* Offset of the name in the catalog's pool */
+    uint32_t data;            /* Offset of the values in the pool */
+    uint32_t count;           /* Number of values, or string size with the terminator */
+    geotiff_meta_type_t type; /* Type of the values */
+} geotiff_meta_entry_t;
+
+/* Catalog of a file's GeoKeys and georeferencing tags, parsed once when the
+ * file is opened and read-only afterwards (geotiff_meta.c) */
+typedef struct geotiff_meta_t {
+    geotiff_meta_entry_t *entries; /* Entries: GeoKeys in directory order, then tags */
+    uint32_t nentries;             /* Number of entries */
+    uint32_t *buckets;             /* Hash of names: entry index plus one, or 0 if empty */
+    uint32_t nbuckets;             /* Number of buckets (a power of two) */
+    uint32_t *by_name;             /* Entry indices in name order */
+    char *pool;                    /* Names and values of every entry */
+    size_t pool_size;              /* Bytes used in the pool */
+    uint32_t entries_cap;          /* Entries allocated, while building */
+    size_t pool_cap;               /* Pool bytes allocated, while building */
+} geotiff_meta_t;
+
+/* Coordinate variables computed from a file's geotransform (geotiff_coords.c) */
+typedef enum geotiff_coord_t {
+    GEOTIFF_COORD_X,   /* "x": model X of each column, if the transform is not rotated */
+    GEOTIFF_COORD_Y,   /* "y": model Y of each row, if the transform is not rotated */
+    GEOTIFF_COORD_LON, /* "lon": longitude of each pixel, if rotated and geographic */
+    GEOTIFF_COORD_LAT, /* "lat": latitude of each pixel, if rotated and geographic */
+    GEOTIFF_NCOORDS
+} geotiff_coord_t;
+
+/* Affine transform from raster (column, row) to model coordinates, ordered
+ * as GDAL orders it: X = gt[0] + col * gt[1] + row * gt[2] and
+ * Y = gt[3] + col * gt[4] + row * gt[5] */
+typedef struct geotiff_transform_t {
+    double gt[6];    /* Coefficients */
+    double center;   /* Raster offset of pixel centers: 0.5 (PixelIsArea) or 0 (PixelIsPoint) */
+    int geographic;  /* Model coordinates are longitudes and latitudes */
+    uint32_t width;  /* Columns of the image the transform is of */
+    uint32_t height; /* Rows of the same */
+} geotiff_transform_t;
+
+/* Coordinate variables of a file, set up when it is opened */
+typedef struct geotiff_coords_t {
+    geotiff_transform_t transform;        /* Geotransform of the image */
+    unsigned mask;                        /* Coordinate variables the file has, one bit each */
+    geotiff_meta_t meta[GEOTIFF_NCOORDS]; /* Attributes of each */
+} geotiff_coords_t;
+
 /* GeoTIFF VOL file object structure */
 typedef struct geotiff_file_t {
-    TIFF *tiff;         /* TIFF file handle */
-    GTIF *gtif;         /* GeoTIFF handle */
-    char *filename;     /* File name */
-    unsigned int flags; /* File access flags */
-    hid_t plist_id;     /* Property list ID */
+    TIFF *tiff;                 /* The file's own handle, used under geotiff_handles_lock() */
+    GTIF *gtif;                 /* GeoTIFF handle */
+    char *filename;             /* File name */
+    unsigned int flags;         /* File access flags */
+    hid_t plist_id;             /* Property list ID */
+    geotiff_handles_t *handles; /* TIFF handles for decoder threads */
+    geotiff_storage_t *storage; /* Storage every handle reads from */
+    unsigned threads;           /* Threads decoding one read */
+    uint64_t gap;               /* Largest gap between chunks read in one go, in bytes */
+    geotiff_file_id_t id;       /* Identity of the file in the chunk cache */
+    int loaded;                 /* Headers parsed (1), not yet (0), or failed to parse (-1) */
+    int use_index;              /* Read the headers from, or save them to, a sidecar index */
+    geotiff_index_t *index;     /* Sidecar index the headers were read from, if any */
+    const unsigned char *map;   /* Read-only mapping of the file, once mapped */
+    size_t map_size;            /* Size of the mapping */
+    geotiff_ifd_t *ifds;        /* Every directory: the main chain, then SubIFDs */
+    uint32_t nifds;             /* Number of directories */
+    uint32_t nmain_ifds;        /* Number of directories in the main chain */
+    int same_pages;             /* Every page of the main chain has the same layout */
+    geotiff_link_t *links;      /* Datasets of the root group, in name order */
+    uint32_t nlinks;            /* Number of links */
+    unsigned pending;           /* Asynchronous reads still decoding from the file */
+    geotiff_meta_t meta;        /* GeoKeys and georeferencing tags */
+    geotiff_coords_t coords;    /* Coordinate variables */
+    geotiff_stats_t stats;      /* Read statistics of the file */
 } geotiff_file_t;
 
+/* Raster layout of a TIFF image, read once when the dataset is opened */
+typedef struct geotiff_image_t {
+    uint32_t width;             /* Image width in pixels */
+    uint32_t height;            /* Image height in pixels */
+    uint16_t samples_per_pixel; /* Samples (bands) per pixel */
+    uint16_t bits_per_sample;   /* Bits per sample */
+    uint16_t sample_format;     /* TIFF sample format */
+    uint16_t compression;       /* TIFF compression scheme */
+    int is_tiled;               /* Chunks are tiles (1) or strips (0) */
+    int is_separate;            /* Each band is stored in chunks of its own (separate planes) */
+    int by_scanline;            /* Strips are streamed in bands of scanlines */
+    uint32_t chunk_width;       /* Tile width, or image width for strips */
+    uint32_t chunk_height;      /* Tile length, or rows per strip (or band) */
+    uint32_t chunks_across;     /* Number of chunks in one chunk row */
+    uint32_t chunks_down;       /* Number of chunk rows */
+    uint32_t chunks_per_plane;  /* Chunks of one band plane, or of all bands if interleaved */
+    size_t chunk_size;          /* Decoded size of a full chunk in bytes */
+    size_t elem_size;           /* Bytes per sample */
+} geotiff_image_t;
+
+/* Axes of a stack of images that the dimensions of a dataset are drawn from */
+typedef enum geotiff_axis_t {
+    GEOTIFF_AXIS_PAGE, /* Page (directory) of a multi-page stack */
+    GEOTIFF_AXIS_Y,    /* Image row */
+    GEOTIFF_AXIS_X,    /* Image column */
+    GEOTIFF_AXIS_BAND, /* Sample of a pixel */
+    GEOTIFF_NAXES
+} geotiff_axis_t;
+
 /* GeoTIFF VOL dataset object structure */
 typedef struct geotiff_dataset_t {
-    geotiff_file_t *file; /* Parent file */
-    char *name;           /* Dataset name */
-    hid_t type_id;        /* HDF5 datatype */
-    hid_t space_id;       /* HDF5 dataspace */
-    void *data;           /* Cached data */
-    size_t data_size;     /* Data size in bytes */
-    int is_image;         /* Is this an image dataset */
+    geotiff_file_t *file;               /* Parent file */
+    char *name;                         /* Dataset name */
+    hid_t type_id;                      /* HDF5 datatype */
+    hid_t space_id;                     /* HDF5 dataspace */
+    hid_t dcpl_id;                      /* Creation properties (chunk layout) */
+    geotiff_image_t image;              /* Raster layout of every page */
+    uint32_t *pages;                    /* Directory of each page (one unless a stack) */
+    uint32_t npages;                    /* Number of pages */
+    int ndims;                          /* Rank of the dataspace */
+    geotiff_axis_t axes[GEOTIFF_NAXES]; /* Axis of each dimension */
+    hsize_t dims[GEOTIFF_NAXES];        /* Extent of each dimension */
+    hsize_t chunk_dims[GEOTIFF_NAXES];  /* HDF5 chunk extent of each dimension */
+    uint64_t *raw_offsets;              /* File offset of each chunk, if mapped */
+    uint64_t *stored_offsets;           /* File offset of each chunk of each page, once queried */
+    uint64_t *stored_sizes;             /* Stored (compressed) size of the same, 0 if sparse */
+    hsize_t nstored;                    /* Number of chunks with data in the file */
+    int is_image;                       /* Image dataset (1) or coordinate variable (0) */
+    geotiff_coord_t coord;              /* Coordinate variable, if not an image */
 } geotiff_dataset_t;
 
 /* GeoTIFF VOL group object structure */
@@ -68,7 +386,7 @@ typedef struct geotiff_attr_t {
     char *name;           /* Attribute name */
     hid_t type_id;        /* HDF5 datatype */
     hid_t space_id;       /* HDF5 dataspace */
-    void *data;           /* Attribute data */
+    const void *data;     /* Attribute data, in the file's metadata catalog */
     size_t data_size;     /* Data size in bytes */
 } geotiff_attr_t;
 
@@ -76,11 +394,19 @@ typedef struct geotiff_attr_t {
 herr_t geotiff_init_connector(hid_t vipl_id);
 herr_t geotiff_term_connector(void);
 
+/* Connector info operations */
+void *geotiff_info_copy(const void *info);
+herr_t geotiff_info_cmp(int *cmp_value, const void *info1, const void *info2);
+herr_t geotiff_info_free(void *info);
+herr_t geotiff_info_to_str(const void *info, char **str);
+herr_t geotiff_info_from_str(const char *str, void **info);
+
 /* File operations */
 void *geotiff_file_create(const char *name, unsigned flags, hid_t fcpl_id, hid_t fapl_id,
                           hid_t dxpl_id, void **req);
 void *geotiff_file_open(const char *name, unsigned flags, hid_t fapl_id, hid_t dxpl_id, void **req);
 herr_t geotiff_file_get(void *file, H5VL_file_get_args_t *args, hid_t dxpl_id, void **req);
+herr_t geotiff_file_optional(void *file, H5VL_optional_args_t *args, hid_t dxpl_id, void **req);
 herr_t geotiff_file_close(void *file, hid_t dxpl_id, void **req);
 
 /* Dataset operations */
@@ -89,6 +415,7 @@ void *geotiff_dataset_open(void *obj, const H5VL_loc_params_t *loc_params, const
 herr_t geotiff_dataset_read(size_t count, void *dset[], hid_t mem_type_id[], hid_t mem_space_id[],
                             hid_t file_space_id[], hid_t dxpl_id, void *buf[], void **req);
 herr_t geotiff_dataset_get(void *dset, H5VL_dataset_get_args_t *args, hid_t dxpl_id, void **req);
+herr_t geotiff_dataset_optional(void *obj, H5VL_optional_args_t *args, hid_t dxpl_id, void **req);
 herr_t geotiff_dataset_close(void *dset, hid_t dxpl_id, void **req);
 
 /* Group operations */
@@ -97,16 +424,151 @@ void *geotiff_group_open(void *obj, const H5VL_loc_params_t *loc_params, const c
 herr_t geotiff_group_get(void *obj, H5VL_group_get_args_t *args, hid_t dxpl_id, void **req);
 herr_t geotiff_group_close(void *grp, hid_t dxpl_id, void **req);
 
+/* Link operations */
+herr_t geotiff_link_get(void *obj, const H5VL_loc_params_t *loc_params, H5VL_link_get_args_t *args,
+                        hid_t dxpl_id, void **req);
+herr_t geotiff_link_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                             H5VL_link_specific_args_t *args, hid_t dxpl_id, void **req);
+
+/* Object operations */
+void *geotiff_object_open(void *obj, const H5VL_loc_params_t *loc_params, H5I_type_t *opened_type,
+                          hid_t dxpl_id, void **req);
+herr_t geotiff_object_get(void *obj, const H5VL_loc_params_t *loc_params,
+                          H5VL_object_get_args_t *args, hid_t dxpl_id, void **req);
+herr_t geotiff_object_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                               H5VL_object_specific_args_t *args, hid_t dxpl_id, void **req);
+
 /* Attribute operations */
 void *geotiff_attr_open(void *obj, const H5VL_loc_params_t *loc_params, const char *name,
                         hid_t aapl_id, hid_t dxpl_id, void **req);
 herr_t geotiff_attr_read(void *attr, hid_t mem_type_id, void *buf, hid_t dxpl_id, void **req);
 herr_t geotiff_attr_get(void *obj, H5VL_attr_get_args_t *args, hid_t dxpl_id, void **req);
+herr_t geotiff_attr_specific(void *obj, const H5VL_loc_params_t *loc_params,
+                             H5VL_attr_specific_args_t *args, hid_t dxpl_id, void **req);
 herr_t geotiff_attr_close(void *attr, hid_t dxpl_id, void **req);
 
+/* Request operations */
+herr_t geotiff_request_wait(void *req, uint64_t timeout, H5VL_request_status_t *status);
+herr_t geotiff_request_notify(void *req, H5VL_request_notify_t cb, void *ctx);
+herr_t geotiff_request_cancel(void *req, H5VL_request_status_t *status);
+herr_t geotiff_request_free(void *req);
+
 /* Helper functions */
-herr_t geotiff_read_image_data(geotiff_file_t *file, geotiff_dataset_t *dset);
+herr_t geotiff_get_image_info(TIFF *tiff, geotiff_image_t *image);
+herr_t geotiff_get_chunk_table(TIFF *tiff, const geotiff_image_t *image,
+                               geotiff_chunk_table_t *table);
+herr_t geotiff_read_image_data(size_t count, geotiff_dataset_t *dset[], const hid_t mem_type_id[],
+                               const hid_t mem_space_id[], const hid_t file_space_id[],
+                               void *buf[], void **req);
+herr_t geotiff_read_coords_data(geotiff_dataset_t *dset, hid_t mem_type_id, hid_t mem_space_id,
+                                hid_t file_space_id, void *buf);
 herr_t geotiff_parse_geotiff_tags(geotiff_file_t *file);
 hid_t geotiff_get_hdf5_type_from_tiff(uint16_t sample_format, uint16_t bits_per_sample);
 
+/* Thread pool and TIFF handle pool */
+geotiff_pool_t *geotiff_pool_get(unsigned nworkers);
+herr_t geotiff_pool_run(geotiff_pool_t *pool, size_t ntasks, unsigned max_workers,
+                        geotiff_task_func_t func, void *ctx);
+geotiff_batch_t *geotiff_pool_start(geotiff_pool_t *pool, size_t ntasks, unsigned max_workers,
+                                    geotiff_task_func_t func, geotiff_batch_done_func_t done,
+                                    void *ctx);
+int geotiff_batch_wait(geotiff_batch_t *batch, uint64_t timeout);
+herr_t geotiff_batch_status(const geotiff_batch_t *batch);
+int geotiff_batch_cancel(geotiff_batch_t *batch);
+void geotiff_batch_free(geotiff_batch_t *batch);
+void geotiff_pool_shutdown(void);
+geotiff_handles_t *geotiff_handles_create(const char *filename, geotiff_storage_t *storage,
+                                          TIFF *tiff);
+TIFF *geotiff_handles_lock(geotiff_handles_t *handles);
+void geotiff_handles_unlock(geotiff_handles_t *handles);
+TIFF *geotiff_handles_own(geotiff_handles_t *handles);
+TIFF *geotiff_handles_acquire(geotiff_handles_t *handles);
+void geotiff_handles_release(geotiff_handles_t *handles, TIFF *tiff);
+void geotiff_handles_destroy(geotiff_handles_t *handles);
+
+/* Storage backends, TIFF client I/O and merged reads */
+geotiff_storage_t *geotiff_storage_open(const char *filename, const geotiff_info_t *info,
+                                        geotiff_stats_t *stats);
+void geotiff_storage_release(geotiff_storage_t *storage);
+const unsigned char *geotiff_storage_map(geotiff_storage_t *storage, size_t *size);
+int geotiff_storage_resident(const geotiff_storage_t *storage);
+int geotiff_storage_is_tiff(const geotiff_storage_t *storage);
+const char *geotiff_io_name(geotiff_io_t io);
+TIFF *geotiff_tiff_open(const char *filename, geotiff_storage_t *storage);
+void geotiff_tiff_stage(TIFF *tiff, const geotiff_run_t *run);
+void geotiff_storage_willneed(const geotiff_storage_t *storage, uint64_t offset, uint64_t size);
+geotiff_run_t *geotiff_run_create(uint64_t offset, size_t size, unsigned refs);
+herr_t geotiff_run_load(geotiff_run_t *run, TIFF *tiff);
+void geotiff_run_release(geotiff_run_t *run);
+
+/* Decoded chunk cache */
+int geotiff_cache_enabled(void);
+void geotiff_cache_set_budget(size_t bytes);
+geotiff_cache_entry_t *geotiff_cache_get(const geotiff_cache_key_t *key);
+geotiff_cache_entry_t *geotiff_cache_put(const geotiff_cache_key_t *key, unsigned char *data,
+                                         size_t size);
+const unsigned char *geotiff_cache_data(const geotiff_cache_entry_t *entry);
+void geotiff_cache_release(geotiff_cache_entry_t *entry);
+void geotiff_cache_get_stats(geotiff_cache_stats_t *stats);
+void geotiff_cache_clear(void);
+
+/* Sample type conversion */
+geotiff_convert_func_t geotiff_get_convert(geotiff_ntype_t src, geotiff_ntype_t dst);
+size_t geotiff_ntype_size(geotiff_ntype_t type);
+int geotiff_get_tiff_ntype(uint16_t sample_format, uint16_t bits_per_sample);
+int geotiff_get_mem_ntype(hid_t type_id);
+
+/* Sample transposition */
+geotiff_transpose_func_t geotiff_get_transpose(size_t size);
+
+/* Read statistics */
+void geotiff_count(geotiff_stats_t *stats, geotiff_counter_t counter, uint64_t n);
+void geotiff_count_decode(geotiff_stats_t *stats, uint16_t compression, uint64_t bytes,
+                          uint64_t ns);
+uint64_t geotiff_now_ns(void);
+void geotiff_stats_get(const geotiff_stats_t *stats, geotiff_stats_t *snapshot);
+void geotiff_stats_report(void);
+
+/* Georeferencing metadata catalog */
+herr_t geotiff_meta_load(geotiff_meta_t *meta, TIFF *tiff, GTIF *gtif);
+herr_t geotiff_meta_add(geotiff_meta_t *meta, const char *name, geotiff_meta_type_t type,
+                        const void *data, size_t count);
+herr_t geotiff_meta_index(geotiff_meta_t *meta);
+void geotiff_meta_free(geotiff_meta_t *meta);
+const geotiff_meta_entry_t *geotiff_meta_find(const geotiff_meta_t *meta, const char *name);
+const geotiff_meta_entry_t *geotiff_meta_get(const geotiff_meta_t *meta, H5_index_t idx_type,
+                                              H5_iter_order_t order, hsize_t n);
+size_t geotiff_meta_size(const geotiff_meta_entry_t *entry);
+hid_t geotiff_meta_type(const geotiff_meta_entry_t *entry);
+hid_t geotiff_meta_space(const geotiff_meta_entry_t *entry);
+
+/* Coordinate variables */
+herr_t geotiff_coords_init(geotiff_file_t *file, uint32_t width, uint32_t height);
+void geotiff_coords_free(geotiff_file_t *file);
+int geotiff_coords_find(const geotiff_file_t *file, const char *name);
+const char *geotiff_coords_name(geotiff_coord_t coord);
+int geotiff_coords_ndims(geotiff_coord_t coord);
+void geotiff_coords_fill(const geotiff_transform_t *transform, geotiff_coord_t coord,
+                         const hsize_t *start, const hsize_t *count, double *values);
+double geotiff_coords_value(const geotiff_transform_t *transform, geotiff_coord_t coord,
+                            const hsize_t *point);
+
+/* Namespace of the root group */
+herr_t geotiff_links_init(geotiff_file_t *file);
+void geotiff_links_free(geotiff_file_t *file);
+herr_t geotiff_links_lookup(const geotiff_file_t *file, const char *path, uint64_t *id);
+herr_t geotiff_links_get(const geotiff_file_t *file, H5_index_t idx_type, H5_iter_order_t order,
+                         hsize_t n, uint64_t *id);
+size_t geotiff_links_path(const geotiff_file_t *file, uint64_t id, char *buf, size_t size);
+void geotiff_links_token(uint64_t id, H5O_token_t *token);
+herr_t geotiff_links_token_id(const geotiff_file_t *file, const H5O_token_t *token, uint64_t *id);
+
+/* Sidecar index of a file's headers */
+herr_t geotiff_index_load(geotiff_file_t *file);
+herr_t geotiff_index_save(geotiff_file_t *file);
+void geotiff_index_close(geotiff_index_t *index);
+const geotiff_image_t *geotiff_index_image(const geotiff_index_t *index, uint32_t ifd);
+herr_t geotiff_index_chunks(const geotiff_index_t *index, uint32_t ifd,
+                            geotiff_chunk_table_t *table);
+
 #endif /* _geotiff_vol_connector_H */
@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Write the small TIFF files the tests read, besides sample.tif.
+
+Run from this directory with tifffile and numpy installed:
+
+    python3 make_fixtures.py
+"""
+
+import numpy as np
+import tifffile
+
+
+def overviews():
+    """64x48 tiled, deflate-compressed uint16 image whose pixel (y, x) is
+    y * 64 + x, followed by two reduced-resolution IFDs that take every 2nd
+    and every 4th pixel of it, as a cloud optimized GeoTIFF would, then an
+    8-bit transparency mask of the image that is 255 left of column 40."""
+    y, x = np.mgrid[0:48, 0:64]
+    image = (y * 64 + x).astype(np.uint16)
+    mask = np.where(x < 40, 255, 0).astype(np.uint8)
+
+    with tifffile.TiffWriter("overviews.tif") as tif:
+        tif.write(image, tile=(16, 16), compression="zlib", photometric="minisblack")
+        for level in (2, 4):
+            tif.write(image[::level, ::level], tile=(16, 16), compression="zlib",
+                      photometric="minisblack", subfiletype=1)
+        # tifffile only writes 1-bit masks, so the mask goes in as a page...
+        tif.write(mask, tile=(16, 16), compression="zlib", photometric="minisblack",
+                  subfiletype=2)
+
+    # ...whose NewSubfileType is then patched to FILETYPE_MASK
+    with tifffile.TiffFile("overviews.tif") as tif:
+        offset = tif.pages[3].tags["NewSubfileType"].valueoffset
+        byteorder = "little" if tif.byteorder == "<" else "big"
+    with open("overviews.tif", "r+b") as f:
+        f.seek(offset)
+        f.write((4).to_bytes(4, byteorder))
+
+
+def pages():
+    """Three 20x30 RGB pages, deflate-compressed in strips of 7 rows, whose
+    sample (page, y, x, band) is (page * 50 + y * 3 + x * 5 + band * 7) % 256,
+    followed by a reduced-resolution IFD that is not a page of the stack."""
+    p, y, x, b = np.mgrid[0:3, 0:20, 0:30, 0:3]
+    stack = ((p * 50 + y * 3 + x * 5 + b * 7) % 256).astype(np.uint8)
+
+    with tifffile.TiffWriter("pages.tif") as tif:
+        for page in stack:
+            tif.write(page, rowsperstrip=7, compression="zlib", photometric="rgb")
+        tif.write(stack[0, ::2, ::2], rowsperstrip=7, compression="zlib", photometric="rgb",
+                  subfiletype=1)
+
+
+def separate():
+    """40x24 tiled, deflate-compressed uint16 image of 4 bands stored as
+    separate planes, whose sample (band, y, x) is band * 1000 + y * 40 + x."""
+    b, y, x = np.mgrid[0:4, 0:24, 0:40]
+    planes = (b * 1000 + y * 40 + x).astype(np.uint16)
+
+    with tifffile.TiffWriter("separate.tif") as tif:
+        tif.write(planes, tile=(16, 16), compression="zlib", photometric="minisblack",
+                  planarconfig="separate")
+
+
+def georef():
+    """32x24 tiled, deflate-compressed float32 image whose pixel (y, x) is
+    y * 32 + x, georeferenced in WGS 84 with 0.5 degree pixels from (-10, 60)
+    and a nodata value of -9999, with GeoKeys of all three types."""
+    y, x = np.mgrid[0:24, 0:32]
+    image = (y * 32 + x).astype(np.float32)
+
+    # Key directory header, then (key, tag location, count, value or offset):
+    # GTModelTypeGeoKey = geographic, GTRasterTypeGeoKey = pixel is area,
+    # GTCitationGeoKey and GeogCitationGeoKey in the ASCII params,
+    # GeographicTypeGeoKey = EPSG:4326, GeogInvFlatteningGeoKey in the doubles
+    citation = "WGS 84|WGS 84 lat/lon|"
+    keys = [1, 1, 0, 6,
+            1024, 0, 1, 2,
+            1025, 0, 1, 1,
+            1026, 34737, 7, 0,
+            2048, 0, 1, 4326,
+            2049, 34737, 15, 7,
+            2059, 34736, 1, 0]
+    metadata = ('<GDALMetadata>\n  <Item name="AREA_OR_POINT">Area</Item>\n'
+                '</GDALMetadata>\n')
+
+    with tifffile.TiffWriter("georef.tif") as tif:
+        tif.write(image, tile=(16, 16), compression="zlib", photometric="minisblack",
+                  extratags=[(33550, "d", 3, (0.5, 0.5, 0.0), True),
+                             (33922, "d", 6, (0.0, 0.0, 0.0, -10.0, 60.0, 0.0), True),
+                             (34735, "H", len(keys), keys, True),
+                             (34736, "d", 1, (298.257223563,), True),
+                             (34737, "s", 0, citation, True),
+                             (42112, "s", 0, metadata, True),
+                             (42113, "s", 0, "-9999", True)])
+
+
+if __name__ == "__main__":
+    overviews()
+    pages()
+    separate()
+    georef()
@@ -8,16 +8,1660 @@
 #include <hdf5.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* Read the whole image, then a window of it, and compare the overlapping pixels */
+static int test_window_read(hid_t dset_id, hid_t type_id)
+{
+    hid_t space_id = H5I_INVALID_HID, mem_space_id = H5I_INVALID_HID;
+    hsize_t dims[3], start[3] = {0, 0, 0}, count[3];
+    unsigned char *full = NULL, *window = NULL;
+    size_t type_size = H5Tget_size(type_id), row_size, win_row_size;
+    hsize_t y;
+    int ndims, i, ret = -1;
+
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((ndims = H5Sget_simple_extent_ndims(space_id)) < 2 || ndims > 3)
+        goto done;
+    H5Sget_simple_extent_dims(space_id, dims, NULL);
+
+    /* Interior window, or the whole image if it is tiny */
+    for (i = 0; i < ndims; i++)
+        count[i] = dims[i];
+    for (i = 0; i < 2; i++) {
+        if (dims[i] > 2) {
+            start[i] = 1;
+            count[i] = dims[i] / 2;
+        }
+    }
+
+    row_size = (size_t) dims[1] * (ndims == 3 ? (size_t) dims[2] : 1) * type_size;
+    win_row_size = (size_t) count[1] * (ndims == 3 ? (size_t) dims[2] : 1) * type_size;
+    full = (unsigned char *) malloc((size_t) dims[0] * row_size);
+    window = (unsigned char *) malloc((size_t) count[0] * win_row_size);
+    if (!full || !window)
+        goto done;
+
+    if (H5Dread(dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, full) < 0)
+        goto done;
+
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+        goto done;
+    if ((mem_space_id = H5Screate_simple(ndims, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(dset_id, type_id, mem_space_id, space_id, H5P_DEFAULT, window) < 0)
+        goto done;
+
+    for (y = 0; y < count[0]; y++) {
+        const unsigned char *expected = full + (size_t) (start[0] + y) * row_size +
+                                        (size_t) start[1] * (win_row_size / count[1]);
+        if (memcmp(window + (size_t) y * win_row_size, expected, win_row_size) != 0)
+            goto done;
+    }
+
+    ret = 0;
+
+done:
+    free(window);
+    free(full);
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+
+    return ret;
+}
+
+/* Read the whole image as mem_type_id, and compare it with a read as stored
+ * converted by H5Tconvert() */
+static int test_converted_read(hid_t dset_id, hid_t type_id, hid_t mem_type_id)
+{
+    hid_t space_id = H5I_INVALID_HID;
+    unsigned char *expected = NULL, *actual = NULL;
+    size_t type_size = H5Tget_size(type_id), mem_size = H5Tget_size(mem_type_id);
+    hssize_t npoints;
+    int ret = -1;
+
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((npoints = H5Sget_simple_extent_npoints(space_id)) <= 0)
+        goto done;
+    expected = (unsigned char *) malloc((size_t) npoints *
+                                        (type_size > mem_size ? type_size : mem_size));
+    actual = (unsigned char *) malloc((size_t) npoints * mem_size);
+    if (!expected || !actual)
+        goto done;
+
+    if (H5Dread(dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, expected) < 0)
+        goto done;
+    if (H5Tconvert(type_id, mem_type_id, (size_t) npoints, expected, NULL, H5P_DEFAULT) < 0)
+        goto done;
+    if (H5Dread(dset_id, mem_type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, actual) < 0)
+        goto done;
+    if (memcmp(expected, actual, (size_t) npoints * mem_size) != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    free(actual);
+    free(expected);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+
+    return ret;
+}
+
+/* Read the whole image again, nreads times, through a file opened with the
+ * given connector info, and compare it with a read through dset_id */
+static int test_reopen_read(const char *filename, hid_t vol_id, hid_t dset_id, hid_t type_id,
+                            geotiff_info_t *info, int nreads)
+{
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, reopen_dset_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID;
+    unsigned char *expected = NULL, *actual = NULL;
+    hssize_t npoints;
+    size_t nbytes;
+    int i, ret = -1;
+
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((npoints = H5Sget_simple_extent_npoints(space_id)) <= 0)
+        goto done;
+    nbytes = (size_t) npoints * H5Tget_size(type_id);
+    expected = (unsigned char *) malloc(nbytes);
+    actual = (unsigned char *) malloc(nbytes);
+    if (!expected || !actual)
+        goto done;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, info) < 0)
+        goto done;
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((reopen_dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+
+    if (H5Dread(dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, expected) < 0)
+        goto done;
+    for (i = 0; i < nreads; i++) {
+        memset(actual, 0, nbytes);
+        if (H5Dread(reopen_dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, actual) < 0)
+            goto done;
+        if (memcmp(expected, actual, nbytes) != 0)
+            goto done;
+    }
+
+    ret = 0;
+
+done:
+    free(actual);
+    free(expected);
+    if (reopen_dset_id >= 0)
+        H5Dclose(reopen_dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+
+    return ret;
+}
+
+/* Read the whole image through a file opened with each storage backend in
+ * turn (the memory one on the file's bytes read into a buffer), with four
+ * threads, 64 KiB readahead and the chunk cache off, and compare each with
+ * dset_id */
+static int test_storage_read(const char *filename, hid_t vol_id, hid_t dset_id, hid_t type_id)
+{
+    static const char *const names[GEOTIFF_NIO] = {"pread", "mmap", "direct", "memory"};
+    geotiff_info_t info;
+    unsigned char *bytes = NULL;
+    FILE *fp;
+    long size;
+    int io, ret = -1;
+
+    if (!(fp = fopen(filename, "rb")))
+        return -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) > 0 &&
+        (bytes = (unsigned char *) malloc((size_t) size)) && fseek(fp, 0, SEEK_SET) == 0 &&
+        fread(bytes, 1, (size_t) size, fp) == (size_t) size)
+        ret = 0;
+    fclose(fp);
+
+    for (io = 0; ret == 0 && io < GEOTIFF_NIO; io++) {
+        info.threads = 4;
+        info.cache_mb = 0;
+        info.gap_kb = GEOTIFF_DEFAULT_GAP_KB;
+        info.io = (geotiff_io_t) io;
+        info.readahead_kb = 64;
+        info.buffer = io == GEOTIFF_IO_MEMORY ? bytes : NULL;
+        info.buffer_size = io == GEOTIFF_IO_MEMORY ? (size_t) size : 0;
+        info.lazy = 0;
+        info.index = 0;
+        if (test_reopen_read(filename, vol_id, dset_id, type_id, &info, 1) < 0) {
+            printf("  read through %s storage does not match\n", names[io]);
+            ret = -1;
+        }
+    }
+
+    free(bytes);
+
+    return ret;
+}
+
+/* Read the whole image as stored, as float and as big-endian double through
+ * an event set, with the decoding left to the pool threads (four, cache off),
+ * and once more synchronously meanwhile, and compare each with a synchronous
+ * read through dset_id */
+static int test_async_read(const char *filename, hid_t vol_id, hid_t dset_id, hid_t type_id)
+{
+    hid_t mem_type_ids[3] = {type_id, H5T_NATIVE_FLOAT, H5T_IEEE_F64BE};
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, async_dset_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID, es_id = H5I_INVALID_HID;
+    unsigned char *expected[3] = {NULL, NULL, NULL}, *actual[3] = {NULL, NULL, NULL};
+    unsigned char *concurrent = NULL;
+    geotiff_info_t info;
+    size_t nbytes[3], ninprogress = 1;
+    hbool_t failed = 1;
+    hssize_t npoints;
+    int i, ret = -1;
+
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((npoints = H5Sget_simple_extent_npoints(space_id)) <= 0)
+        goto done;
+
+    info.threads = 4;
+    info.cache_mb = 0;
+    info.gap_kb = GEOTIFF_DEFAULT_GAP_KB;
+    info.io = GEOTIFF_IO_PREAD;
+    info.readahead_kb = 0;
+    info.buffer = NULL;
+    info.buffer_size = 0;
+    info.lazy = 0;
+    info.index = 0;
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((async_dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((es_id = H5EScreate()) < 0)
+        goto done;
+
+    for (i = 0; i < 3; i++) {
+        nbytes[i] = (size_t) npoints * H5Tget_size(mem_type_ids[i]);
+        expected[i] = (unsigned char *) malloc(nbytes[i]);
+        actual[i] = (unsigned char *) calloc(1, nbytes[i]);
+        if (!expected[i] || !actual[i])
+            goto done;
+        if (H5Dread(dset_id, mem_type_ids[i], H5S_ALL, H5S_ALL, H5P_DEFAULT, expected[i]) < 0)
+            goto done;
+    }
+
+    /* All three are in flight at once; the last needs H5Tconvert(), so it
+     * completes before H5Dread_async() returns */
+    for (i = 0; i < 3; i++)
+        if (H5Dread_async(async_dset_id, mem_type_ids[i], H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                          actual[i], es_id) < 0)
+            goto done;
+
+    /* The same file is read synchronously while the pool threads decode */
+    if (!(concurrent = (unsigned char *) malloc(nbytes[0])))
+        goto done;
+    if (H5Dread(async_dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, concurrent) < 0)
+        goto done;
+
+    if (H5ESwait(es_id, H5ES_WAIT_FOREVER, &ninprogress, &failed) < 0 || ninprogress != 0 ||
+        failed)
+        goto done;
+    for (i = 0; i < 3; i++)
+        if (memcmp(expected[i], actual[i], nbytes[i]) != 0)
+            goto done;
+    if (memcmp(expected[0], concurrent, nbytes[0]) != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    /* Buffers may only be freed once no read is writing to them */
+    if (es_id >= 0) {
+        H5ESwait(es_id, H5ES_WAIT_FOREVER, &ninprogress, &failed);
+        H5ESclose(es_id);
+    }
+    for (i = 0; i < 3; i++) {
+        free(actual[i]);
+        free(expected[i]);
+    }
+    free(concurrent);
+    if (async_dset_id >= 0)
+        H5Dclose(async_dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+
+    return ret;
+}
+
+/* Read the whole image as stored and as float through two handles on it in
+ * one H5Dread_multi() call, and compare both with separate reads */
+static int test_multi_read(hid_t file_id, hid_t dset_id, hid_t type_id)
+{
+    hid_t dset_ids[2] = {dset_id, H5I_INVALID_HID};
+    hid_t mem_type_ids[2] = {type_id, H5T_NATIVE_FLOAT};
+    hid_t mem_space_ids[2] = {H5S_ALL, H5S_ALL}, file_space_ids[2] = {H5S_ALL, H5S_ALL};
+    hid_t space_id = H5I_INVALID_HID;
+    unsigned char *expected[2] = {NULL, NULL}, *actual[2] = {NULL, NULL};
+    void *bufs[2];
+    size_t nbytes[2];
+    hssize_t npoints;
+    int i, ret = -1;
+
+    if ((dset_ids[1] = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((npoints = H5Sget_simple_extent_npoints(space_id)) <= 0)
+        goto done;
+
+    for (i = 0; i < 2; i++) {
+        nbytes[i] = (size_t) npoints * H5Tget_size(mem_type_ids[i]);
+        expected[i] = (unsigned char *) malloc(nbytes[i]);
+        actual[i] = (unsigned char *) calloc(1, nbytes[i]);
+        if (!expected[i] || !actual[i])
+            goto done;
+        if (H5Dread(dset_ids[i], mem_type_ids[i], H5S_ALL, H5S_ALL, H5P_DEFAULT, expected[i]) <
+            0)
+            goto done;
+        bufs[i] = actual[i];
+    }
+
+    if (H5Dread_multi(2, dset_ids, mem_type_ids, mem_space_ids, file_space_ids, H5P_DEFAULT,
+                      bufs) < 0)
+        goto done;
+    for (i = 0; i < 2; i++)
+        if (memcmp(expected[i], actual[i], nbytes[i]) != 0)
+            goto done;
+
+    ret = 0;
+
+done:
+    for (i = 0; i < 2; i++) {
+        free(actual[i]);
+        free(expected[i]);
+    }
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_ids[1] >= 0)
+        H5Dclose(dset_ids[1]);
+
+    return ret;
+}
+
+/* Read every level of overviews.tif (written by make_fixtures.py), whose
+ * pixel (y, x) is y * 64 + x at full resolution and overview_N takes every
+ * 2^N-th pixel of that, and check there is no level past the last */
+static int test_overview_read(const char *filename, hid_t fapl_id)
+{
+    const char *names[3] = {"image", "overview_1", "overview_2"};
+    hid_t file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID, space_id = H5I_INVALID_HID;
+    hid_t dcpl_id = H5I_INVALID_HID;
+    hsize_t dims[2], chunk_dims[2];
+    uint16_t *pixels = NULL;
+    hsize_t y, x;
+    int level, ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+
+    for (level = 0; level < 3; level++) {
+        unsigned step = 1u << level;
+
+        if ((dset_id = H5Dopen2(file_id, names[level], H5P_DEFAULT)) < 0)
+            goto done;
+        if ((space_id = H5Dget_space(dset_id)) < 0 ||
+            H5Sget_simple_extent_dims(space_id, dims, NULL) != 2)
+            goto done;
+        if (dims[0] != 48 / step || dims[1] != 64 / step)
+            goto done;
+        if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0 ||
+            H5Pget_chunk(dcpl_id, 2, chunk_dims) != 2)
+            goto done;
+        if (chunk_dims[0] != 16 || chunk_dims[1] != 16)
+            goto done;
+
+        if (!(pixels = (uint16_t *) malloc((size_t) (dims[0] * dims[1]) * sizeof(uint16_t))))
+            goto done;
+        if (H5Dread(dset_id, H5T_NATIVE_UINT16, H5S_ALL, H5S_ALL, H5P_DEFAULT, pixels) < 0)
+            goto done;
+        for (y = 0; y < dims[0]; y++)
+            for (x = 0; x < dims[1]; x++)
+                if (pixels[y * dims[1] + x] != y * step * 64 + x * step)
+                    goto done;
+
+        free(pixels);
+        pixels = NULL;
+        H5Pclose(dcpl_id);
+        dcpl_id = H5I_INVALID_HID;
+        H5Sclose(space_id);
+        space_id = H5I_INVALID_HID;
+        H5Dclose(dset_id);
+        dset_id = H5I_INVALID_HID;
+    }
+
+    H5E_BEGIN_TRY
+    {
+        dset_id = H5Dopen2(file_id, "overview_3", H5P_DEFAULT);
+    }
+    H5E_END_TRY
+    if (dset_id >= 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    free(pixels);
+    if (dcpl_id >= 0)
+        H5Pclose(dcpl_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Query the tiles of overviews.tif as HDF5 chunks, and check a direct chunk
+ * read returns the tile's bytes exactly as stored in the file */
+static int test_chunk_query(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    hsize_t nchunks = 0, offset[2], coord[2] = {16, 16}, size = 0, storage_size = 0;
+    unsigned filter_mask = 1;
+    uint32_t filters = 1;
+    haddr_t addr = HADDR_UNDEF;
+    unsigned char *chunk = NULL, *stored = NULL;
+    FILE *fp = NULL;
+    int ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+        goto done;
+
+    /* 64 x 48 pixels in 16 x 16 tiles, numbered row-major */
+    if (H5Dget_num_chunks(dset_id, H5S_ALL, &nchunks) < 0 || nchunks != 12)
+        goto done;
+    if (H5Dget_chunk_info(dset_id, H5S_ALL, 5, offset, &filter_mask, &addr, &size) < 0)
+        goto done;
+    if (offset[0] != 16 || offset[1] != 16 || filter_mask != 0 || size == 0)
+        goto done;
+    if (H5Dget_chunk_storage_size(dset_id, coord, &storage_size) < 0 || storage_size != size)
+        goto done;
+
+    if (!(chunk = (unsigned char *) malloc((size_t) size)) ||
+        !(stored = (unsigned char *) malloc((size_t) size)))
+        goto done;
+#if defined(H5Dread_chunk_vers) && H5Dread_chunk_vers >= 2
+    {
+        size_t buf_size = (size_t) size;
+
+        if (H5Dread_chunk(dset_id, H5P_DEFAULT, coord, &filters, chunk, &buf_size) < 0)
+            goto done;
+    }
+#else
+    if (H5Dread_chunk(dset_id, H5P_DEFAULT, coord, &filters, chunk) < 0)
+        goto done;
+#endif
+    if (filters != 0)
+        goto done;
+
+    if (!(fp = fopen(filename, "rb")) || fseek(fp, (long) addr, SEEK_SET) != 0 ||
+        fread(stored, 1, (size_t) size, fp) != (size_t) size)
+        goto done;
+    if (memcmp(chunk, stored, (size_t) size) != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (fp)
+        fclose(fp);
+    free(stored);
+    free(chunk);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Helper function to get the read statistics of a file and of the process
+ * through the connector's optional operation */
+static int get_read_stats(hid_t file_id, geotiff_stats_t *file_stats,
+                          geotiff_stats_t *global_stats)
+{
+    geotiff_get_stats_args_t stats_args;
+    H5VL_optional_args_t vol_args;
+    int op_val;
+
+    if (H5VLfind_opt_operation(H5VL_SUBCLS_FILE, GEOTIFF_GET_STATS_OP_NAME, &op_val) < 0)
+        return -1;
+
+    stats_args.file = file_stats;
+    stats_args.global = global_stats;
+    vol_args.op_type = op_val;
+    vol_args.args = &stats_args;
+
+    return H5VLfile_optional_op(file_id, &vol_args, H5P_DEFAULT, H5ES_NONE) < 0 ? -1 : 0;
+}
+
+/* Read the whole image through a newly opened file with the chunk cache off,
+ * and check the file's read statistics account for it and are part of the
+ * process's */
+static int test_read_stats(const char *filename, hid_t vol_id, hid_t type_id)
+{
+    geotiff_info_t info = {1, 0, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_PREAD, 0, NULL, 0, 0, 0};
+    geotiff_stats_t before, after, global;
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID;
+    hssize_t npoints;
+    void *buf = NULL;
+    uint64_t decoded = 0;
+    int i, ret = -1;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "/image", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((npoints = H5Sget_simple_extent_npoints(space_id)) <= 0)
+        goto done;
+    if (!(buf = malloc((size_t) npoints * H5Tget_size(type_id))))
+        goto done;
+
+    /* Opening the file reads its header, but no pixels */
+    if (get_read_stats(file_id, &before, NULL) < 0)
+        goto done;
+    if (before.counters[GEOTIFF_COUNTER_READS] != 0 ||
+        before.counters[GEOTIFF_COUNTER_CHUNKS_DECODED] != 0 ||
+        before.counters[GEOTIFF_COUNTER_BYTES_READ] == 0)
+        goto done;
+
+    if (H5Dread(dset_id, type_id, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0)
+        goto done;
+    if (get_read_stats(file_id, &after, &global) < 0)
+        goto done;
+
+    /* One read, each chunk of which was decoded or used in place */
+    if (after.counters[GEOTIFF_COUNTER_READS] != 1 ||
+        after.counters[GEOTIFF_COUNTER_READ_NS] == 0 ||
+        after.counters[GEOTIFF_COUNTER_CACHE_HITS] != 0)
+        goto done;
+    for (i = 0; i < GEOTIFF_NCODECS; i++)
+        decoded += after.codec_chunks[i];
+    if (decoded != after.counters[GEOTIFF_COUNTER_CHUNKS_DECODED] ||
+        decoded + after.counters[GEOTIFF_COUNTER_CHUNKS_MAPPED] == 0)
+        goto done;
+    if (decoded > 0 && after.counters[GEOTIFF_COUNTER_BYTES_DECODED] == 0)
+        goto done;
+    for (i = 0; i < GEOTIFF_NCOUNTERS; i++)
+        if (global.counters[i] < after.counters[i])
+            goto done;
+
+    ret = 0;
+
+done:
+    free(buf);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+
+    return ret;
+}
+
+/* Read a window of two pages and one band of the "pages" stack of pages.tif
+ * (written by make_fixtures.py), whose sample (page, y, x, band) is
+ * (page * 50 + y * 3 + x * 5 + band * 7) % 256 */
+static int test_pages_read(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID, space_id = H5I_INVALID_HID;
+    hid_t mem_space_id = H5I_INVALID_HID, dcpl_id = H5I_INVALID_HID;
+    hsize_t dims[4], chunk_dims[4];
+    hsize_t start[4] = {1, 5, 0, 1}, count[4] = {2, 10, 30, 1};
+    unsigned char window[2][10][30];
+    hsize_t p, y, x;
+    int ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "pages", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(dset_id)) < 0 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) != 4)
+        goto done;
+    if (dims[0] != 3 || dims[1] != 20 || dims[2] != 30 || dims[3] != 3)
+        goto done;
+    if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0 || H5Pget_chunk(dcpl_id, 4, chunk_dims) != 4)
+        goto done;
+    if (chunk_dims[0] != 1 || chunk_dims[1] != 7 || chunk_dims[2] != 30 || chunk_dims[3] != 3)
+        goto done;
+
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+        goto done;
+    if ((mem_space_id = H5Screate_simple(4, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(dset_id, H5T_NATIVE_UCHAR, mem_space_id, space_id, H5P_DEFAULT, window) < 0)
+        goto done;
+    for (p = 0; p < count[0]; p++)
+        for (y = 0; y < count[1]; y++)
+            for (x = 0; x < count[2]; x++)
+                if (window[p][y][x] != ((p + 1) * 50 + (y + 5) * 3 + x * 5 + 7) % 256)
+                    goto done;
+
+    ret = 0;
+
+done:
+    if (dcpl_id >= 0)
+        H5Pclose(dcpl_id);
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Read a window of the band-sequential "pages_bsq" view of pages.tif, the
+ * [page, band, y, x] transpose of "pages" */
+static int test_pages_bsq_read(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID, space_id = H5I_INVALID_HID;
+    hid_t mem_space_id = H5I_INVALID_HID, dcpl_id = H5I_INVALID_HID;
+    hsize_t dims[4], chunk_dims[4];
+    hsize_t start[4] = {1, 0, 5, 0}, count[4] = {2, 3, 10, 30};
+    unsigned char window[2][3][10][30];
+    hsize_t p, b, y, x;
+    int ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "pages_bsq", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(dset_id)) < 0 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) != 4)
+        goto done;
+    if (dims[0] != 3 || dims[1] != 3 || dims[2] != 20 || dims[3] != 30)
+        goto done;
+    if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0 || H5Pget_chunk(dcpl_id, 4, chunk_dims) != 4)
+        goto done;
+    if (chunk_dims[0] != 1 || chunk_dims[1] != 3 || chunk_dims[2] != 7 || chunk_dims[3] != 30)
+        goto done;
+
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+        goto done;
+    if ((mem_space_id = H5Screate_simple(4, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(dset_id, H5T_NATIVE_UCHAR, mem_space_id, space_id, H5P_DEFAULT, window) < 0)
+        goto done;
+    for (p = 0; p < count[0]; p++)
+        for (b = 0; b < count[1]; b++)
+            for (y = 0; y < count[2]; y++)
+                for (x = 0; x < count[3]; x++)
+                    if (window[p][b][y][x] != ((p + 1) * 50 + (y + 5) * 3 + x * 5 + b * 7) % 256)
+                        goto done;
+
+    ret = 0;
+
+done:
+    if (dcpl_id >= 0)
+        H5Pclose(dcpl_id);
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Read a window of one band of separate.tif (written by make_fixtures.py), a
+ * band-separate image whose sample (y, x, band) is band * 1000 + y * 40 + x */
+static int test_separate_read(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID, space_id = H5I_INVALID_HID;
+    hid_t mem_space_id = H5I_INVALID_HID, dcpl_id = H5I_INVALID_HID;
+    hsize_t dims[3], chunk_dims[3];
+    hsize_t start[3] = {3, 10, 2}, count[3] = {15, 26, 1};
+    unsigned short window[15][26];
+    hsize_t y, x;
+    int ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(dset_id)) < 0 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) != 3)
+        goto done;
+    if (dims[0] != 24 || dims[1] != 40 || dims[2] != 4)
+        goto done;
+    if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0 || H5Pget_chunk(dcpl_id, 3, chunk_dims) != 3)
+        goto done;
+    if (chunk_dims[0] != 16 || chunk_dims[1] != 16 || chunk_dims[2] != 1)
+        goto done;
+
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+        goto done;
+    if ((mem_space_id = H5Screate_simple(3, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(dset_id, H5T_NATIVE_USHORT, mem_space_id, space_id, H5P_DEFAULT, window) < 0)
+        goto done;
+    for (y = 0; y < count[0]; y++)
+        for (x = 0; x < count[1]; x++)
+            if (window[y][x] != 2 * 1000 + (y + 3) * 40 + x + 10)
+                goto done;
+
+    ret = 0;
+
+done:
+    if (dcpl_id >= 0)
+        H5Pclose(dcpl_id);
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Read the GeoKeys and georeferencing tags of georef.tif (written by
+ * make_fixtures.py) as attributes of its root group, each with its own type
+ * and dataspace */
+static int test_georef_attrs(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, attr_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID, type_id = H5I_INVALID_HID, str_type_id = H5I_INVALID_HID;
+    hsize_t dims[1] = {0};
+    unsigned short model_type = 0;
+    double scale[3] = {0, 0, 0}, tiepoint[6] = {0, 0, 0, 0, 0, 0}, flattening = 0;
+    float scale_f[3] = {0, 0, 0};
+    char citation[16] = "", nodata[16] = "", name[32] = "";
+    int ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+
+    /* SHORT GeoKeys are unsigned 16-bit arrays */
+    if ((attr_id = H5Aopen(file_id, "GTModelTypeGeoKey", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Aget_space(attr_id)) < 0 || H5Sget_simple_extent_ndims(space_id) != 1 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) < 0 || dims[0] != 1)
+        goto done;
+    if (H5Aread(attr_id, H5T_NATIVE_USHORT, &model_type) < 0 || model_type != 2)
+        goto done;
+    H5Sclose(space_id);
+    space_id = H5I_INVALID_HID;
+    H5Aclose(attr_id);
+
+    /* DOUBLE GeoKeys and the model tags are double arrays, converted on read */
+    if ((attr_id = H5Aopen(file_id, "GeogInvFlatteningGeoKey", H5P_DEFAULT)) < 0 ||
+        H5Aread(attr_id, H5T_NATIVE_DOUBLE, &flattening) < 0 || flattening != 298.257223563)
+        goto done;
+    H5Aclose(attr_id);
+    if ((attr_id = H5Aopen(file_id, "ModelPixelScaleTag", H5P_DEFAULT)) < 0 ||
+        H5Aread(attr_id, H5T_NATIVE_DOUBLE, scale) < 0 || scale[0] != 0.5 || scale[1] != 0.5 ||
+        H5Aread(attr_id, H5T_NATIVE_FLOAT, scale_f) < 0 || scale_f[1] != 0.5f)
+        goto done;
+    H5Aclose(attr_id);
+    if ((attr_id = H5Aopen(file_id, "ModelTiepointTag", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Aget_space(attr_id)) < 0 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) < 0 || dims[0] != 6)
+        goto done;
+    if (H5Aread(attr_id, H5T_NATIVE_DOUBLE, tiepoint) < 0 || tiepoint[3] != -10.0 ||
+        tiepoint[4] != 60.0)
+        goto done;
+    H5Sclose(space_id);
+    space_id = H5I_INVALID_HID;
+    H5Aclose(attr_id);
+
+    /* ASCII GeoKeys and GDAL tags are scalar strings, without the '|' */
+    if ((attr_id = H5Aopen(file_id, "GTCitationGeoKey", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((type_id = H5Aget_type(attr_id)) < 0 || H5Tget_class(type_id) != H5T_STRING ||
+        H5Tget_size(type_id) != 7)
+        goto done;
+    if (H5Aread(attr_id, type_id, citation) < 0 || strcmp(citation, "WGS 84") != 0)
+        goto done;
+    H5Aclose(attr_id);
+    if ((str_type_id = H5Tcopy(H5T_C_S1)) < 0 || H5Tset_size(str_type_id, sizeof(nodata)) < 0)
+        goto done;
+    if ((attr_id = H5Aopen(file_id, "GDAL_NODATA", H5P_DEFAULT)) < 0 ||
+        H5Aread(attr_id, str_type_id, nodata) < 0 || strcmp(nodata, "-9999") != 0)
+        goto done;
+    H5Aclose(attr_id);
+    attr_id = H5I_INVALID_HID;
+
+    /* Attributes are listed in name order, and only the file's exist */
+    if (H5Aget_name_by_idx(file_id, ".", H5_INDEX_NAME, H5_ITER_INC, 0, name, sizeof(name),
+                           H5P_DEFAULT) < 0 ||
+        strcmp(name, "GDAL_METADATA") != 0)
+        goto done;
+    if (H5Aexists(file_id, "ModelTransformationTag") != 0 ||
+        H5Aexists(file_id, "GDAL_METADATA") <= 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (str_type_id >= 0)
+        H5Tclose(str_type_id);
+    if (type_id >= 0)
+        H5Tclose(type_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (attr_id >= 0)
+        H5Aclose(attr_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* What an H5Literate2() or H5Aiterate2() callback saw */
+typedef struct names_t {
+    char names[16][32]; /* Names in the order seen */
+    int count;          /* Number of names */
+    int stop_at;        /* Number of names after which to stop, or 0 */
+    int ndims_sum;      /* Sum of the ranks of the datasets, opened from the group */
+} names_t;
+
+static herr_t collect_link(hid_t group_id, const char *name, const H5L_info2_t *info,
+                           void *op_data)
+{
+    names_t *seen = (names_t *) op_data;
+    hid_t dset_id, space_id;
+
+    if (info->type != H5L_TYPE_HARD || seen->count == 16)
+        return -1;
+    snprintf(seen->names[seen->count++], sizeof(seen->names[0]), "%s", name);
+
+    /* Datasets open relative to the group the callback is handed */
+    if ((dset_id = H5Dopen2(group_id, name, H5P_DEFAULT)) < 0)
+        return -1;
+    if ((space_id = H5Dget_space(dset_id)) >= 0) {
+        seen->ndims_sum += H5Sget_simple_extent_ndims(space_id);
+        H5Sclose(space_id);
+    }
+    H5Dclose(dset_id);
+
+    return seen->count == seen->stop_at;
+}
+
+static herr_t collect_attr(hid_t __attribute__((unused)) loc_id, const char *name,
+                           const H5A_info_t __attribute__((unused)) * info, void *op_data)
+{
+    names_t *seen = (names_t *) op_data;
+
+    if (seen->count < 16)
+        snprintf(seen->names[seen->count], sizeof(seen->names[0]), "%s", name);
+    seen->count++;
+
+    return 0;
+}
+
+static herr_t count_object(hid_t __attribute__((unused)) obj_id, const char *name,
+                           const H5O_info2_t *info, void *op_data)
+{
+    int *count = (int *) op_data;
+
+    if ((strcmp(name, ".") == 0) != (info->type == H5O_TYPE_GROUP))
+        return -1;
+    (*count)++;
+
+    return 0;
+}
+
+/* Discover the datasets of overviews.tif (an image, its overviews and an
+ * 8-bit mask) and georef.tif (an image and its coordinate variables), and
+ * the attributes of the latter, without knowing their names */
+static int test_namespace(const char *overviews_file, const char *georef_file, hid_t fapl_id)
+{
+    const char *expected[4] = {"image", "mask", "overview_1", "overview_2"};
+    hid_t file_id = H5I_INVALID_HID, obj_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID, mem_space_id = H5I_INVALID_HID;
+    hsize_t idx = 0, start[2] = {0, 38}, count[2] = {1, 4};
+    H5G_info_t ginfo;
+    H5O_info2_t oinfo;
+    names_t seen;
+    uint8_t mask[4] = {0, 0, 0, 0};
+    char name[32] = "";
+    int i, nobjects = 0, ret = -1;
+
+    if ((file_id = H5Fopen(overviews_file, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+
+    /* The root group lists its datasets in name order */
+    if (H5Gget_info(file_id, &ginfo) < 0 || ginfo.nlinks != 4)
+        goto done;
+    memset(&seen, 0, sizeof(seen));
+    if (H5Literate2(file_id, H5_INDEX_NAME, H5_ITER_INC, &idx, collect_link, &seen) != 0 ||
+        seen.count != 4 || idx != 4 || seen.ndims_sum != 8)
+        goto done;
+    for (i = 0; i < 4; i++)
+        if (strcmp(seen.names[i], expected[i]) != 0)
+            goto done;
+
+    /* Iteration stops at, and resumes after, the link a callback stops at */
+    memset(&seen, 0, sizeof(seen));
+    seen.stop_at = 2;
+    idx = 1;
+    if (H5Literate2(file_id, H5_INDEX_NAME, H5_ITER_INC, &idx, collect_link, &seen) != 1 ||
+        idx != 3 || strcmp(seen.names[1], "overview_1") != 0)
+        goto done;
+    if (H5Lget_name_by_idx(file_id, ".", H5_INDEX_NAME, H5_ITER_DEC, 0, name, sizeof(name),
+                           H5P_DEFAULT) < 0 ||
+        strcmp(name, "overview_2") != 0)
+        goto done;
+
+    /* Views resolve without being listed; missing levels do not */
+    if (H5Lexists(file_id, "overview_2", H5P_DEFAULT) <= 0 ||
+        H5Lexists(file_id, "image_bsq", H5P_DEFAULT) <= 0 ||
+        H5Lexists(file_id, "overview_3", H5P_DEFAULT) != 0)
+        goto done;
+
+    /* Objects open and describe themselves generically */
+    if ((obj_id = H5Oopen(file_id, "overview_1", H5P_DEFAULT)) < 0 ||
+        H5Iget_type(obj_id) != H5I_DATASET || H5Iget_name(obj_id, name, sizeof(name)) < 0 ||
+        strcmp(name, "/overview_1") != 0)
+        goto done;
+    if (H5Oget_info_by_name3(file_id, "mask", &oinfo, H5O_INFO_ALL, H5P_DEFAULT) < 0 ||
+        oinfo.type != H5O_TYPE_DATASET || oinfo.num_attrs != 0)
+        goto done;
+    if (H5Ovisit3(file_id, H5_INDEX_NAME, H5_ITER_INC, count_object, &nobjects,
+                  H5O_INFO_BASIC) < 0 ||
+        nobjects != 5)
+        goto done;
+
+    /* The mask reads as the image it masks */
+    if ((dset_id = H5Dopen2(file_id, "/mask", H5P_DEFAULT)) < 0 ||
+        (space_id = H5Dget_space(dset_id)) < 0 ||
+        H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0 ||
+        (mem_space_id = H5Screate_simple(2, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(dset_id, H5T_NATIVE_UINT8, mem_space_id, space_id, H5P_DEFAULT, mask) < 0 ||
+        mask[0] != 255 || mask[1] != 255 || mask[2] != 0 || mask[3] != 0)
+        goto done;
+    H5Sclose(mem_space_id);
+    mem_space_id = H5I_INVALID_HID;
+    H5Sclose(space_id);
+    space_id = H5I_INVALID_HID;
+    H5Dclose(dset_id);
+    dset_id = H5I_INVALID_HID;
+    H5Oclose(obj_id);
+    obj_id = H5I_INVALID_HID;
+    H5Fclose(file_id);
+    file_id = H5I_INVALID_HID;
+
+    /* Coordinate variables are listed beside the image, and every attribute
+     * of the root group is iterated over */
+    if (!georef_file) {
+        ret = 0;
+        goto done;
+    }
+    if ((file_id = H5Fopen(georef_file, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    memset(&seen, 0, sizeof(seen));
+    if (H5Literate2(file_id, H5_INDEX_NAME, H5_ITER_INC, NULL, collect_link, &seen) != 0 ||
+        seen.count != 3 || strcmp(seen.names[1], "x") != 0 || strcmp(seen.names[2], "y") != 0)
+        goto done;
+    if (H5Oget_info3(file_id, &oinfo, H5O_INFO_NUM_ATTRS) < 0 || oinfo.num_attrs == 0)
+        goto done;
+    memset(&seen, 0, sizeof(seen));
+    if (H5Aiterate2(file_id, H5_INDEX_NAME, H5_ITER_INC, NULL, collect_attr, &seen) != 0 ||
+        (hsize_t) seen.count != oinfo.num_attrs || strcmp(seen.names[0], "GDAL_METADATA") != 0)
+        goto done;
+    if ((obj_id = H5Oopen(file_id, "x", H5P_DEFAULT)) < 0)
+        goto done;
+    memset(&seen, 0, sizeof(seen));
+    if (H5Aiterate2(obj_id, H5_INDEX_NAME, H5_ITER_INC, NULL, collect_attr, &seen) != 0 ||
+        seen.count == 0 || strcmp(seen.names[0], "CLASS") != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (obj_id >= 0)
+        H5Oclose(obj_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Read the coordinate variables of georef.tif: pixel centers of a 0.5 degree
+ * grid whose corner is at (-10, 60), computed for the selection only */
+static int test_coords_read(const char *filename, hid_t fapl_id)
+{
+    hid_t file_id = H5I_INVALID_HID, x_id = H5I_INVALID_HID, y_id = H5I_INVALID_HID;
+    hid_t space_id = H5I_INVALID_HID, mem_space_id = H5I_INVALID_HID;
+    hid_t attr_id = H5I_INVALID_HID, type_id = H5I_INVALID_HID;
+    hsize_t dims[1] = {0}, start[1] = {1}, stride[1] = {3}, count[1] = {5};
+    hsize_t points[3] = {23, 0, 7};
+    double x[32], xs[5], yp[3];
+    float yf[6];
+    char value[32] = "";
+    int i, ret = -1;
+
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+
+    /* x is one double per column, and stores nothing */
+    if ((x_id = H5Dopen2(file_id, "x", H5P_DEFAULT)) < 0)
+        goto done;
+    if ((space_id = H5Dget_space(x_id)) < 0 || H5Sget_simple_extent_ndims(space_id) != 1 ||
+        H5Sget_simple_extent_dims(space_id, dims, NULL) < 0 || dims[0] != 32)
+        goto done;
+    if (H5Dread(x_id, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT, x) < 0)
+        goto done;
+    for (i = 0; i < 32; i++)
+        if (x[i] != -10.0 + (i + 0.5) * 0.5)
+            goto done;
+    if (H5Dget_storage_size(x_id) != 0)
+        goto done;
+
+    /* Every third column from the second */
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, stride, count, NULL) < 0 ||
+        (mem_space_id = H5Screate_simple(1, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(x_id, H5T_NATIVE_DOUBLE, mem_space_id, space_id, H5P_DEFAULT, xs) < 0)
+        goto done;
+    for (i = 0; i < 5; i++)
+        if (xs[i] != x[1 + 3 * i])
+            goto done;
+    H5Sclose(mem_space_id);
+    mem_space_id = H5I_INVALID_HID;
+    H5Sclose(space_id);
+    space_id = H5I_INVALID_HID;
+
+    /* A window of y converted to float, then points of it in their order */
+    if ((y_id = H5Dopen2(file_id, "/y", H5P_DEFAULT)) < 0 || (space_id = H5Dget_space(y_id)) < 0)
+        goto done;
+    start[0] = 4;
+    count[0] = 6;
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0 ||
+        (mem_space_id = H5Screate_simple(1, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(y_id, H5T_NATIVE_FLOAT, mem_space_id, space_id, H5P_DEFAULT, yf) < 0)
+        goto done;
+    for (i = 0; i < 6; i++)
+        if (yf[i] != (float) (60.0 - (4 + i + 0.5) * 0.5))
+            goto done;
+    H5Sclose(mem_space_id);
+    count[0] = 3;
+    if (H5Sselect_elements(space_id, H5S_SELECT_SET, 3, points) < 0 ||
+        (mem_space_id = H5Screate_simple(1, count, NULL)) < 0)
+        goto done;
+    if (H5Dread(y_id, H5T_NATIVE_DOUBLE, mem_space_id, space_id, H5P_DEFAULT, yp) < 0)
+        goto done;
+    for (i = 0; i < 3; i++)
+        if (yp[i] != 60.0 - (points[i] + 0.5) * 0.5)
+            goto done;
+
+    /* Dimension scale and CF attributes, on the dataset or by its name */
+    if ((attr_id = H5Aopen(x_id, "CLASS", H5P_DEFAULT)) < 0 ||
+        (type_id = H5Aget_type(attr_id)) < 0 || H5Aread(attr_id, type_id, value) < 0 ||
+        strcmp(value, "DIMENSION_SCALE") != 0)
+        goto done;
+    H5Tclose(type_id);
+    H5Aclose(attr_id);
+    if ((attr_id = H5Aopen_by_name(file_id, "y", "units", H5P_DEFAULT, H5P_DEFAULT)) < 0 ||
+        (type_id = H5Aget_type(attr_id)) < 0 || H5Aread(attr_id, type_id, value) < 0 ||
+        strcmp(value, "degrees_north") != 0)
+        goto done;
+    if (H5Aexists(y_id, "GTModelTypeGeoKey") != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (type_id >= 0)
+        H5Tclose(type_id);
+    if (attr_id >= 0)
+        H5Aclose(attr_id);
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (y_id >= 0)
+        H5Dclose(y_id);
+    if (x_id >= 0)
+        H5Dclose(x_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+
+    return ret;
+}
+
+/* Open the file lazily and check that opening it reads nothing but the TIFF
+ * signature, that reads through it still match dset_id, and that a lazy open
+ * of bytes that are not a TIFF fails at once */
+static int test_lazy_open(const char *filename, hid_t vol_id, hid_t dset_id, hid_t type_id)
+{
+    static const char not_tiff[] = "GIF89a, not a TIFF";
+    geotiff_info_t info = {1, 0, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_PREAD, 0, NULL, 0, 1, 0};
+    geotiff_stats_t stats;
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID;
+    char name[4096];
+    int ret = -1;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    if ((file_id = H5Fopen(filename, H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+
+    /* Neither asking the file's name nor its statistics parses the headers */
+    if (H5Fget_name(file_id, name, sizeof(name)) < 0 || strcmp(name, filename) != 0)
+        goto done;
+    if (get_read_stats(file_id, &stats, NULL) < 0 ||
+        stats.counters[GEOTIFF_COUNTER_BYTES_READ] != 4)
+        goto done;
+    H5Fclose(file_id);
+    file_id = H5I_INVALID_HID;
+
+    if (test_reopen_read(filename, vol_id, dset_id, type_id, &info, 1) < 0)
+        goto done;
+
+    info.io = GEOTIFF_IO_MEMORY;
+    info.buffer = not_tiff;
+    info.buffer_size = sizeof(not_tiff);
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    H5E_BEGIN_TRY
+    {
+        file_id = H5Fopen("not_tiff.gif", H5F_ACC_RDONLY, fapl_id);
+    }
+    H5E_END_TRY
+    if (file_id >= 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+
+    return ret;
+}
+
+/* Helper function to copy a file, or append a byte to it if append is set */
+static int copy_file(const char *from, const char *to, int append)
+{
+    unsigned char buf[65536];
+    FILE *in = NULL, *out = NULL;
+    size_t n;
+    int ret = -1;
+
+    if (!(out = fopen(to, append ? "ab" : "wb")))
+        goto done;
+    if (append) {
+        if (fputc(0, out) == EOF)
+            goto done;
+    } else {
+        if (!(in = fopen(from, "rb")))
+            goto done;
+        while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+            if (fwrite(buf, 1, n, out) != n)
+                goto done;
+        if (ferror(in))
+            goto done;
+    }
+
+    ret = 0;
+
+done:
+    if (in)
+        fclose(in);
+    if (out && fclose(out) != 0)
+        ret = -1;
+
+    return ret;
+}
+
+/* Open a copy of the file with sidecar indexes on and check that the first
+ * open writes the index, that the next one reads nothing of the file and
+ * still reads what dset_id does, and that an index the file has outgrown is
+ * ignored and rewritten */
+static int test_sidecar_index(const char *filename, hid_t vol_id, hid_t dset_id, hid_t type_id)
+{
+    static const char copy[] = "sidecar_index.tif";
+    static const char sidecar[] = "sidecar_index.tif" GEOTIFF_INDEX_SUFFIX;
+    geotiff_info_t info = {1, 0, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_PREAD, 0, NULL, 0, 0, 1};
+    geotiff_stats_t stats;
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID;
+    FILE *fp;
+    int pass, ret = -1;
+
+    remove(sidecar);
+    if (copy_file(filename, copy, 0) < 0)
+        goto done;
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+
+    /* Written on the first open, read on the second; the file then grows,
+     * so the third parses it again and the fourth reads the new index */
+    for (pass = 0; pass < 4; pass++) {
+        if (pass == 2 && copy_file(NULL, copy, 1) < 0)
+            goto done;
+        if ((file_id = H5Fopen(copy, H5F_ACC_RDONLY, fapl_id)) < 0)
+            goto done;
+        if (get_read_stats(file_id, &stats, NULL) < 0 ||
+            (stats.counters[GEOTIFF_COUNTER_BYTES_READ] == 0) != (pass % 2 == 1))
+            goto done;
+        H5Fclose(file_id);
+        file_id = H5I_INVALID_HID;
+
+        if (!(fp = fopen(sidecar, "rb")))
+            goto done;
+        fclose(fp);
+    }
+
+    if (test_reopen_read(copy, vol_id, dset_id, type_id, &info, 1) < 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    remove(sidecar);
+    remove(copy);
+
+    return ret;
+}
+
+/* Size of a TIFF written by make_strip_tiff(), PackBits-compressed or not */
+static size_t strip_tiff_size(uint32_t width, uint32_t height, int packbits)
+{
+    if (!packbits)
+        return 122 + (size_t) height * width;
+    return 122 + (size_t) height * ((width + 127) / 128) * 2;
+}
+
+/* Value of pixel (x, y) of a TIFF written by make_strip_tiff() */
+static unsigned char strip_pixel(unsigned char value, uint32_t x, uint32_t y)
+{
+    return (unsigned char) (value + y + x / 128);
+}
+
+/* Helper function to write an 8-bit TIFF of one strip, PackBits-compressed or
+ * not, into buf (strip_tiff_size() bytes), whose rows are runs of 128 pixels:
+ * value plus the row plus the run */
+static void make_strip_tiff(unsigned char *buf, uint32_t width, uint32_t height,
+                            unsigned char value, int packbits)
+{
+    /* Tag, type (3 SHORT, 4 LONG) and value of each directory entry */
+    const uint32_t entries[9][3] = {
+        {256, 3, width},  {257, 3, height}, {258, 3, 8},
+        {259, 3, packbits ? 32773 : 1},     {262, 3, 1},
+        {273, 4, 122},    {277, 3, 1},      {278, 3, height},
+        {279, 4, (uint32_t) (strip_tiff_size(width, height, packbits) - 122)}};
+    unsigned char *p = buf;
+    uint32_t x, y, n;
+    int i;
+
+    memset(buf, 0, 122);
+    memcpy(p, "II*\0\x08\0\0\0", 8);
+    p += 8;
+    *p = 9;
+    p += 2;
+    for (i = 0; i < 9; i++, p += 12) {
+        p[0] = (unsigned char) (entries[i][0] & 0xff);
+        p[1] = (unsigned char) (entries[i][0] >> 8);
+        p[2] = (unsigned char) entries[i][1];
+        p[4] = 1;
+        p[8] = (unsigned char) (entries[i][2] & 0xff);
+        p[9] = (unsigned char) ((entries[i][2] >> 8) & 0xff);
+        p[10] = (unsigned char) ((entries[i][2] >> 16) & 0xff);
+        p[11] = (unsigned char) (entries[i][2] >> 24);
+    }
+    p += 4;
+
+    /* A run of n bytes is 257 - n and the byte, a single byte 0 and the byte */
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += n) {
+            n = width - x < 128 ? width - x : 128;
+            if (!packbits) {
+                memset(p, strip_pixel(value, x, y), n);
+                p += n;
+                continue;
+            }
+            *p++ = (unsigned char) (n > 1 ? 257 - n : 0);
+            *p++ = strip_pixel(value, x, y);
+        }
+    }
+}
+
+/* Read an image stored as one strip too large to decode whole, which is
+ * streamed in bands of scanlines, or if uncompressed mapped in the same bands:
+ * check that it is chunked by band within the limits of HDF5 chunks, and that
+ * a full read, a window across the band boundary and the same window again
+ * with several threads asked for match the pixels written */
+static int test_scanline_strip(hid_t vol_id, int packbits)
+{
+    /* One more row of 8 KiB than fits in a band, so the last band is short */
+    const uint32_t width = 8192, height = (uint32_t) (GEOTIFF_MAX_CHUNK_BYTES / 8192) + 8;
+    size_t size = strip_tiff_size(width, height, packbits);
+    unsigned char *bytes = NULL, *pixels = NULL;
+    geotiff_info_t info = {4, 256, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_MEMORY, 0, NULL, 0, 0, 0};
+    geotiff_stats_t stats;
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    hid_t dcpl_id = H5I_INVALID_HID, space_id = H5I_INVALID_HID, mem_space_id = H5I_INVALID_HID;
+    hsize_t chunk_dims[2], start[2] = {height - 20, 1000}, count[2] = {20, 300};
+    uint32_t x, y;
+    int pass, ret = -1;
+
+    if (!(bytes = (unsigned char *) malloc(size)) ||
+        !(pixels = (unsigned char *) malloc((size_t) width * height)))
+        goto done;
+    make_strip_tiff(bytes, width, height, 3, packbits);
+    info.buffer = bytes;
+    info.buffer_size = size;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    if ((file_id = H5Fopen("one_strip.tif", H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+        goto done;
+
+    if ((dcpl_id = H5Dget_create_plist(dset_id)) < 0 || H5Pget_chunk(dcpl_id, 2, chunk_dims) != 2)
+        goto done;
+    if (chunk_dims[0] != GEOTIFF_MAX_CHUNK_BYTES / width || chunk_dims[1] != width)
+        goto done;
+
+    /* And within what H5Pset_chunk() accepts: under 2^32 elements and along
+     * each dimension */
+    if (chunk_dims[0] >= ((hsize_t) 1 << 32) || chunk_dims[1] >= ((hsize_t) 1 << 32) ||
+        chunk_dims[0] * chunk_dims[1] > 0xffffffff)
+        goto done;
+
+    if (H5Dread(dset_id, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, pixels) < 0)
+        goto done;
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            if (pixels[(size_t) y * width + x] != strip_pixel(3, x, y))
+                goto done;
+
+    /* Uncompressed bands come straight from the file, the others are decoded */
+    if (get_read_stats(file_id, &stats, NULL) < 0 ||
+        (stats.counters[GEOTIFF_COUNTER_CHUNKS_MAPPED] == 0) != packbits ||
+        (stats.counters[GEOTIFF_COUNTER_CHUNKS_DECODED] == 0) == packbits)
+        goto done;
+
+    if ((space_id = H5Dget_space(dset_id)) < 0)
+        goto done;
+    if ((mem_space_id = H5Screate_simple(2, count, NULL)) < 0)
+        goto done;
+    if (H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL, count, NULL) < 0)
+        goto done;
+    for (pass = 0; pass < 2; pass++) {
+        memset(pixels, 0, (size_t) (count[0] * count[1]));
+        if (H5Dread(dset_id, H5T_NATIVE_UCHAR, mem_space_id, space_id, H5P_DEFAULT, pixels) < 0)
+            goto done;
+        for (y = 0; y < count[0]; y++)
+            for (x = 0; x < count[1]; x++)
+                if (pixels[y * count[1] + x] !=
+                    strip_pixel(3, (uint32_t) start[1] + x, (uint32_t) start[0] + y))
+                    goto done;
+    }
+
+    ret = 0;
+
+done:
+    if (mem_space_id >= 0)
+        H5Sclose(mem_space_id);
+    if (space_id >= 0)
+        H5Sclose(space_id);
+    if (dcpl_id >= 0)
+        H5Pclose(dcpl_id);
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    free(pixels);
+    free(bytes);
+
+    return ret;
+}
+
+/* Open two different files in memory of the same size, one after the other
+ * at the same address and under the same name, and check that the second
+ * read gets its own pixels rather than tiles cached from the first */
+static int test_memory_reuse(hid_t vol_id)
+{
+    unsigned char bytes[138], pixels[64];
+    geotiff_info_t info = {1, 16, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_MEMORY, 0, bytes,
+                           sizeof(bytes), 0, 0};
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    int value, i, ret = -1;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+
+    for (value = 1; value <= 2; value++) {
+        make_strip_tiff(bytes, 8, 8, (unsigned char) value, 1);
+        if ((file_id = H5Fopen("reused.tif", H5F_ACC_RDONLY, fapl_id)) < 0)
+            goto done;
+        if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+            goto done;
+        if (H5Dread(dset_id, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, pixels) < 0)
+            goto done;
+        for (i = 0; i < 64; i++)
+            if (pixels[i] != strip_pixel((unsigned char) value, 0, (uint32_t) i / 8))
+                goto done;
+        H5Dclose(dset_id);
+        dset_id = H5I_INVALID_HID;
+        H5Fclose(file_id);
+        file_id = H5I_INVALID_HID;
+    }
+
+    ret = 0;
+
+done:
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+
+    return ret;
+}
+
+/* Read a file in memory whose only strip is cut short, so that it fails to
+ * decode, and check that the read fails without counting a decode */
+static int test_failed_decode(hid_t vol_id)
+{
+    unsigned char bytes[138], pixels[64];
+    geotiff_info_t info = {1, 0, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_MEMORY, 0, bytes,
+                           sizeof(bytes), 0, 0};
+    geotiff_stats_t stats;
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    herr_t status;
+    int ret = -1;
+
+    /* StripByteCounts: one run of the eight the strip needs */
+    make_strip_tiff(bytes, 8, 8, 1, 1);
+    bytes[10 + 8 * 12 + 8] = 2;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+    if ((file_id = H5Fopen("truncated.tif", H5F_ACC_RDONLY, fapl_id)) < 0)
+        goto done;
+    if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+        goto done;
+    H5E_BEGIN_TRY
+    {
+        status = H5Dread(dset_id, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, pixels);
+    }
+    H5E_END_TRY
+    if (status >= 0)
+        goto done;
+
+    if (get_read_stats(file_id, &stats, NULL) < 0 ||
+        stats.counters[GEOTIFF_COUNTER_CHUNKS_DECODED] != 0 ||
+        stats.counters[GEOTIFF_COUNTER_BYTES_DECODED] != 0)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+
+    return ret;
+}
+
+/* Write a file, read it, then rewrite it in place with other pixels of the
+ * same size (most likely within the same second) and check that the second
+ * read gets them rather than tiles cached from the first */
+static int test_rewrite_in_place(hid_t vol_id)
+{
+    static const char name[] = "rewritten.tif";
+    unsigned char bytes[138], pixels[64];
+    geotiff_info_t info = {1, 16, GEOTIFF_DEFAULT_GAP_KB, GEOTIFF_IO_PREAD, 0, NULL, 0, 0, 0};
+    hid_t fapl_id = H5I_INVALID_HID, file_id = H5I_INVALID_HID, dset_id = H5I_INVALID_HID;
+    FILE *fp;
+    int value, i, ret = -1;
+
+    if ((fapl_id = H5Pcreate(H5P_FILE_ACCESS)) < 0)
+        goto done;
+    if (H5Pset_vol(fapl_id, vol_id, &info) < 0)
+        goto done;
+
+    for (value = 1; value <= 2; value++) {
+        /* The second write keeps the file's inode */
+        make_strip_tiff(bytes, 8, 8, (unsigned char) value, 1);
+        if (!(fp = fopen(name, value == 1 ? "wb" : "r+b")))
+            goto done;
+        if (fwrite(bytes, 1, sizeof(bytes), fp) != sizeof(bytes)) {
+            fclose(fp);
+            goto done;
+        }
+        if (fclose(fp) != 0)
+            goto done;
+
+        if ((file_id = H5Fopen(name, H5F_ACC_RDONLY, fapl_id)) < 0)
+            goto done;
+        if ((dset_id = H5Dopen2(file_id, "image", H5P_DEFAULT)) < 0)
+            goto done;
+        if (H5Dread(dset_id, H5T_NATIVE_UCHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, pixels) < 0)
+            goto done;
+        for (i = 0; i < 64; i++)
+            if (pixels[i] != strip_pixel((unsigned char) value, 0, (uint32_t) i / 8))
+                goto done;
+        H5Dclose(dset_id);
+        dset_id = H5I_INVALID_HID;
+        H5Fclose(file_id);
+        file_id = H5I_INVALID_HID;
+    }
+
+    ret = 0;
+
+done:
+    if (dset_id >= 0)
+        H5Dclose(dset_id);
+    if (file_id >= 0)
+        H5Fclose(file_id);
+    if (fapl_id >= 0)
+        H5Pclose(fapl_id);
+    remove(name);
+
+    return ret;
+}
+
+/* Parse a connector info string setting every knob, check the result and
+ * turn it back into a string, and check that bad values are rejected */
+static int test_info_string(hid_t vol_id)
+{
+    geotiff_info_t *info = NULL, *bad = NULL;
+    char *str = NULL;
+    int ret = -1;
+
+    if (H5VLconnector_str_to_info(
+            "threads=8;cache_mb=512;gap_kb=32;io=mmap;readahead_kb=1024;lazy=1;index=1",
+            vol_id, (void **) &info) < 0 ||
+        !info)
+        goto done;
+    if (info->threads != 8 || info->cache_mb != 512 || info->gap_kb != 32 ||
+        info->io != GEOTIFF_IO_MMAP || info->readahead_kb != 1024 || !info->lazy ||
+        !info->index)
+        goto done;
+
+    if (H5VLconnector_info_to_str(info, vol_id, &str) < 0 || !str)
+        goto done;
+    if (strcmp(str,
+               "threads=8;cache_mb=512;gap_kb=32;io=mmap;readahead_kb=1024;lazy=1;index=1") != 0)
+        goto done;
+
+    H5E_BEGIN_TRY
+    {
+        if (H5VLconnector_str_to_info("io=tape", vol_id, (void **) &bad) < 0 || !bad)
+            if (H5VLconnector_str_to_info("readahead_kb=-1", vol_id, (void **) &bad) < 0 || !bad)
+                if (H5VLconnector_str_to_info("lazy=yes", vol_id, (void **) &bad) < 0 || !bad)
+                    H5VLconnector_str_to_info("index=2", vol_id, (void **) &bad);
+    }
+    H5E_END_TRY
+    if (bad)
+        goto done;
+
+    ret = 0;
+
+done:
+    if (bad)
+        H5VLfree_connector_info(vol_id, bad);
+    if (info)
+        H5VLfree_connector_info(vol_id, info);
+    if (str)
+        H5free_memory(str);
+
+    return ret;
+}
 
 int main(int argc, char **argv)
 {
     hid_t fapl_id, file_id, vol_id;
-    hid_t dset_id, space_id, type_id;
-    hsize_t dims[3];
+    hid_t dset_id, space_id, type_id, dcpl_id;
+    hsize_t dims[3], chunk_dims[3];
+    geotiff_info_t threaded_info, cached_info;
     herr_t ret;
+    int nerrors = 0;
 
-    if (argc != 2) {
-        printf("Usage: %s <geotiff_file>\n", argv[0]);
+    if (argc < 2 || argc > 6) {
+        printf("Usage: %s <geotiff_file> [overviews_file [pages_file [separate_file "
+               "[georef_file]]]]\n",
+               argv[0]);
         return 1;
     }
 
@@ -30,6 +1674,57 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    /* Every performance knob can be set from the connector info string */
+    if (test_info_string(vol_id) < 0) {
+        printf("Connector info string is not parsed as expected\n");
+        nerrors++;
+    } else {
+        printf("Connector info string parsed\n");
+    }
+
+    /* A buffer reused for another file is not served from the chunk cache */
+    if (test_memory_reuse(vol_id) < 0) {
+        printf("Reused memory buffer reads tiles of the file it held before\n");
+        nerrors++;
+    } else {
+        printf("Reused memory buffer reads its own pixels\n");
+    }
+
+    /* Nor is a file rewritten in place, even within the same second (where
+     * stat() has sub-second times) */
+#ifndef _WIN32
+    if (test_rewrite_in_place(vol_id) < 0) {
+        printf("File rewritten in place reads tiles cached before\n");
+        nerrors++;
+    } else {
+        printf("File rewritten in place reads its new pixels\n");
+    }
+#endif
+
+    /* A strip too large to decode whole is streamed in bands of scanlines */
+    if (test_scanline_strip(vol_id, 1) < 0) {
+        printf("Oversized strip is not banded or its bands do not match\n");
+        nerrors++;
+    } else {
+        printf("Oversized strip reads in bands of scanlines\n");
+    }
+
+    /* An uncompressed one is mapped in the same bands, within the strip */
+    if (test_scanline_strip(vol_id, 0) < 0) {
+        printf("Oversized uncompressed strip is not mapped in bands or they do not match\n");
+        nerrors++;
+    } else {
+        printf("Oversized uncompressed strip is mapped in bands of scanlines\n");
+    }
+
+    /* A chunk that fails to decode is not counted as decoded */
+    if (test_failed_decode(vol_id) < 0) {
+        printf("Failed decode is not reported or is counted as a decode\n");
+        nerrors++;
+    } else {
+        printf("Failed decode is reported and not counted\n");
+    }
+
     /* Create file access property list */
     fapl_id = H5Pcreate(H5P_FILE_ACCESS);
     if (fapl_id < 0) {
@@ -84,19 +1779,210 @@ int main(int argc, char **argv)
             H5T_class_t type_class = H5Tget_class(type_id);
             size_t type_size = H5Tget_size(type_id);
             printf("Image datatype: class=%d, size=%zu bytes\n", type_class, type_size);
+
+            /* A window read must match the same pixels of a full read */
+            if (test_window_read(dset_id, type_id) < 0) {
+                printf("Window read does not match full read\n");
+                nerrors++;
+            } else {
+                printf("Window read matches full read\n");
+            }
+
+            /* Native memory types are converted in the connector, others by HDF5 */
+            if (test_converted_read(dset_id, type_id, H5T_NATIVE_FLOAT) < 0 ||
+                test_converted_read(dset_id, type_id, H5T_NATIVE_INT16) < 0 ||
+                test_converted_read(dset_id, type_id, H5T_IEEE_F64BE) < 0) {
+                printf("Converted read does not match H5Tconvert\n");
+                nerrors++;
+            } else {
+                printf("Converted reads match H5Tconvert\n");
+            }
+
+            /* Datasets read together share one decode pass */
+            if (test_multi_read(file_id, dset_id, type_id) < 0) {
+                printf("Multi-dataset read does not match single reads\n");
+                nerrors++;
+            } else {
+                printf("Multi-dataset read matches single reads\n");
+            }
+
+            /* Reads decoded on several threads (with the chunk cache off, so
+             * they really decode, and with tiles up to 1 MiB apart read
+             * together) must match the serial read */
+            threaded_info.threads = 4;
+            threaded_info.cache_mb = 0;
+            threaded_info.gap_kb = 1024;
+            threaded_info.io = GEOTIFF_IO_PREAD;
+            threaded_info.readahead_kb = 0;
+            threaded_info.buffer = NULL;
+            threaded_info.buffer_size = 0;
+            threaded_info.lazy = 0;
+            threaded_info.index = 0;
+            if (test_reopen_read(argv[1], vol_id, dset_id, type_id, &threaded_info, 1) < 0) {
+                printf("Threaded read does not match serial read\n");
+                nerrors++;
+            } else {
+                printf("Threaded read matches serial read\n");
+            }
+
+            /* Reads issued through an event set decode in the background */
+            if (test_async_read(argv[1], vol_id, dset_id, type_id) < 0) {
+                printf("Asynchronous reads do not match synchronous reads\n");
+                nerrors++;
+            } else {
+                printf("Asynchronous reads match synchronous reads\n");
+            }
+
+            /* A second read of the reopened file is served from the chunk cache */
+            cached_info.threads = 1;
+            cached_info.cache_mb = 64;
+            cached_info.gap_kb = 0;
+            cached_info.io = GEOTIFF_IO_PREAD;
+            cached_info.readahead_kb = 0;
+            cached_info.buffer = NULL;
+            cached_info.buffer_size = 0;
+            cached_info.lazy = 0;
+            cached_info.index = 0;
+            if (test_reopen_read(argv[1], vol_id, dset_id, type_id, &cached_info, 2) < 0) {
+                printf("Cached read does not match uncached read\n");
+                nerrors++;
+            } else {
+                printf("Cached read matches uncached read\n");
+            }
+
+            /* Every storage backend reads the same pixels */
+            if (test_storage_read(argv[1], vol_id, dset_id, type_id) < 0) {
+                printf("Storage backend reads do not match\n");
+                nerrors++;
+            } else {
+                printf("Storage backend reads match\n");
+            }
+
+            /* Each file counts how its reads were served */
+            if (test_read_stats(argv[1], vol_id, type_id) < 0) {
+                printf("Read statistics do not account for a read\n");
+                nerrors++;
+            } else {
+                printf("Read statistics account for a read\n");
+            }
+            if (test_lazy_open(argv[1], vol_id, dset_id, type_id) < 0) {
+                printf("Lazily opened file does not defer parsing or does not match\n");
+                nerrors++;
+            } else {
+                printf("Lazily opened file parses on first use\n");
+            }
+#ifndef _WIN32
+            if (test_sidecar_index(argv[1], vol_id, dset_id, type_id) < 0) {
+                printf("Sidecar index is not written, not used or not refreshed\n");
+                nerrors++;
+            } else {
+                printf("Sidecar index serves the headers\n");
+            }
+#endif
             H5Tclose(type_id);
         }
 
+        /* Get chunk layout (one chunk per TIFF tile or strip) */
+        dcpl_id = H5Dget_create_plist(dset_id);
+        if (dcpl_id >= 0) {
+            int chunk_ndims = H5Pget_chunk(dcpl_id, 3, chunk_dims);
+            if (chunk_ndims > 0) {
+                printf("Chunk dimensions: ");
+                for (int i = 0; i < chunk_ndims; i++) {
+                    printf("%lu%s", (unsigned long) chunk_dims[i],
+                           (i < chunk_ndims - 1) ? " x " : "");
+                }
+                printf("\n");
+            } else {
+                printf("Image dataset has no chunk layout\n");
+                nerrors++;
+            }
+            H5Pclose(dcpl_id);
+        }
+
         H5Dclose(dset_id);
     } else {
         printf("Failed to open image dataset\n");
     }
 
+    /* Reduced-resolution directories are datasets of their own */
+    if (argc > 2) {
+        if (test_overview_read(argv[2], fapl_id) < 0) {
+            printf("Overview read does not match the full-resolution image\n");
+            nerrors++;
+        } else {
+            printf("Overview reads match the full-resolution image\n");
+        }
+        if (test_chunk_query(argv[2], fapl_id) < 0) {
+            printf("Chunk queries do not match the stored tiles\n");
+            nerrors++;
+        } else {
+            printf("Chunk queries match the stored tiles\n");
+        }
+    }
+
+    /* The pages of a multi-page file are one [page, y, x, band] dataset */
+    if (argc > 3) {
+        if (test_pages_read(argv[3], fapl_id) < 0) {
+            printf("Page stack read does not match the pages\n");
+            nerrors++;
+        } else {
+            printf("Page stack read matches the pages\n");
+        }
+        if (test_pages_bsq_read(argv[3], fapl_id) < 0) {
+            printf("Band-sequential read does not match the pages\n");
+            nerrors++;
+        } else {
+            printf("Band-sequential read matches the pages\n");
+        }
+    }
+
+    /* Band-separate images read like interleaved ones */
+    if (argc > 4) {
+        if (test_separate_read(argv[4], fapl_id) < 0) {
+            printf("Band-separate read does not match the band\n");
+            nerrors++;
+        } else {
+            printf("Band-separate read matches the band\n");
+        }
+    }
+
+    /* Datasets and attributes are discovered without knowing their names */
+    if (argc > 2) {
+        if (test_namespace(argv[2], argc > 5 ? argv[5] : NULL, fapl_id) < 0) {
+            printf("Namespace iteration does not list the datasets\n");
+            nerrors++;
+        } else {
+            printf("Namespace iteration lists the datasets\n");
+        }
+    }
+
+    /* GeoKeys and georeferencing tags are attributes of the root group */
+    if (argc > 5) {
+        if (test_georef_attrs(argv[5], fapl_id) < 0) {
+            printf("Georeferencing attributes do not match the tags\n");
+            nerrors++;
+        } else {
+            printf("Georeferencing attributes match the tags\n");
+        }
+        if (test_coords_read(argv[5], fapl_id) < 0) {
+            printf("Coordinate variables do not match the geotransform\n");
+            nerrors++;
+        } else {
+            printf("Coordinate variables match the geotransform\n");
+        }
+    }
+
     /* Clean up */
     H5Fclose(file_id);
     H5Pclose(fapl_id);
     H5VLunregister_connector(vol_id);
 
+    if (nerrors) {
+        printf("Test failed with %d error(s)\n", nerrors);
+        return 1;
+    }
+
     printf("Test completed successfully\n");
     return 0;
 }
\ No newline at end of file